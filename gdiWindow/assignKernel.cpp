@@ -0,0 +1,424 @@
+// assignKernel.cpp
+// Authored by Alex Shows
+// Released under the MIT License (http://opensource.org/licenses/mit-license.php)
+//
+// Implementation of the CAssignKernel class
+// The nearest-centroid kernel behind CKMeans::assign_data()
+//
+// NOTE: This file must be compiled without floating point contraction
+//		(-ffp-contract=off on GCC/Clang, the default on MSVC), otherwise the
+//		compiler may fuse dx*dx + dy*dy into an FMA on one path but not on
+//		another and the paths would no longer agree bit for bit
+
+#include "assignKernel.h"
+#include <limits>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define AK_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define AK_TARGET_AVX2
+#define AK_TARGET_AVX512
+#if _MSC_VER >= 1910 // AVX-512 intrinsics first shipped with Visual Studio 2017
+#define AK_HAVE_AVX512
+#endif
+#else
+#define AK_TARGET_AVX2 __attribute__((target("avx2")))
+#define AK_TARGET_AVX512 __attribute__((target("avx512f")))
+#define AK_HAVE_AVX512
+#endif
+#endif
+
+// Scalar reference path, one point and one cluster at a time
+static int assign_scalar(const int *x, const int *y, int *label, const int count,
+						 const float *cx, const float *cy, const int numClusters,
+						 long long *sumX, long long *sumY, long long *sumCount, double *sumDist)
+{
+	int changed = 0;
+
+	for(int i=0; i < count; i++)
+	{
+		const float px = (float)x[i];
+		const float py = (float)y[i];
+		float best = std::numeric_limits<float>::infinity();
+		int bestIdx = 0;
+
+		for(int j=0; j < numClusters; j++)
+		{
+			float dx = px - cx[j];
+			float dy = py - cy[j];
+			float d = dx*dx + dy*dy;
+
+			if(d < best)
+			{
+				best = d;
+				bestIdx = j;
+			}
+		} // end FOR each cluster
+
+		if(label[i] != bestIdx)
+			changed++;
+		label[i] = bestIdx;
+
+		if(sumX)
+		{
+			sumX[bestIdx] += x[i];
+			sumY[bestIdx] += y[i];
+			sumCount[bestIdx]++;
+			*sumDist += best;
+		}
+	} // end FOR each data point
+
+	return changed;
+}
+
+// Number of bits set in a lane mask
+static inline int count_bits(unsigned int mask)
+{
+	int bits = 0;
+	for(; mask; mask &= mask - 1)
+		bits++;
+	return bits;
+}
+
+// Add a group of points, whose winning labels and distances were just computed in
+// vector registers and spilled to memory, to the sums of their clusters
+// The distances are added one lane at a time, in point order, so the inertia matches
+// the scalar path exactly
+static inline void accumulate_lanes(const int *x, const int *y, const int *lanes, const float *dists, const int numLanes,
+									long long *sumX, long long *sumY, long long *sumCount, double *sumDist)
+{
+	for(int k=0; k < numLanes; k++)
+	{
+		sumX[lanes[k]] += x[k];
+		sumY[lanes[k]] += y[k];
+		sumCount[lanes[k]]++;
+		*sumDist += dists[k];
+	}
+}
+
+#ifdef AK_X86
+// AVX2 path, 8 points per instruction, any remainder goes through the scalar path
+AK_TARGET_AVX2
+static int assign_avx2(const int *x, const int *y, int *label, const int count,
+					   const float *cx, const float *cy, const int numClusters,
+					   long long *sumX, long long *sumY, long long *sumCount, double *sumDist)
+{
+	const __m256 inf = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+	int changed = 0;
+	int i = 0;
+
+	for(; i + 8 <= count; i += 8)
+	{
+		__m256 px = _mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i*)(x + i)));
+		__m256 py = _mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i*)(y + i)));
+		__m256 best = inf;
+		__m256i bestIdx = _mm256_setzero_si256();
+
+		for(int j=0; j < numClusters; j++)
+		{
+			__m256 dx = _mm256_sub_ps(px, _mm256_set1_ps(cx[j]));
+			__m256 dy = _mm256_sub_ps(py, _mm256_set1_ps(cy[j]));
+			__m256 d = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+			__m256 closer = _mm256_cmp_ps(d, best, _CMP_LT_OQ);
+
+			best = _mm256_blendv_ps(best, d, closer);
+			bestIdx = _mm256_blendv_epi8(bestIdx, _mm256_set1_epi32(j), _mm256_castps_si256(closer));
+		} // end FOR each cluster
+
+		// Count the lanes whose label differs from the one already stored
+		__m256i oldIdx = _mm256_loadu_si256((const __m256i*)(label + i));
+		int same = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(oldIdx, bestIdx)));
+		changed += 8 - count_bits((unsigned int)same);
+
+		_mm256_storeu_si256((__m256i*)(label + i), bestIdx);
+
+		if(sumX)
+		{
+			float dists[8];
+			_mm256_storeu_ps(dists, best);
+			accumulate_lanes(x + i, y + i, label + i, dists, 8, sumX, sumY, sumCount, sumDist);
+		}
+	} // end FOR each group of 8 data points
+
+	return changed + assign_scalar(x + i, y + i, label + i, count - i, cx, cy, numClusters, sumX, sumY, sumCount, sumDist);
+}
+#endif
+
+#ifdef AK_HAVE_AVX512
+// AVX-512 path, 16 points per instruction, any remainder goes through the scalar path
+AK_TARGET_AVX512
+static int assign_avx512(const int *x, const int *y, int *label, const int count,
+						 const float *cx, const float *cy, const int numClusters,
+						 long long *sumX, long long *sumY, long long *sumCount, double *sumDist)
+{
+	const __m512 inf = _mm512_set1_ps(std::numeric_limits<float>::infinity());
+	int changed = 0;
+	int i = 0;
+
+	for(; i + 16 <= count; i += 16)
+	{
+		__m512 px = _mm512_cvtepi32_ps(_mm512_loadu_si512((const void*)(x + i)));
+		__m512 py = _mm512_cvtepi32_ps(_mm512_loadu_si512((const void*)(y + i)));
+		__m512 best = inf;
+		__m512i bestIdx = _mm512_setzero_si512();
+
+		for(int j=0; j < numClusters; j++)
+		{
+			__m512 dx = _mm512_sub_ps(px, _mm512_set1_ps(cx[j]));
+			__m512 dy = _mm512_sub_ps(py, _mm512_set1_ps(cy[j]));
+			__m512 d = _mm512_add_ps(_mm512_mul_ps(dx, dx), _mm512_mul_ps(dy, dy));
+			__mmask16 closer = _mm512_cmp_ps_mask(d, best, _CMP_LT_OQ);
+
+			best = _mm512_mask_mov_ps(best, closer, d);
+			bestIdx = _mm512_mask_mov_epi32(bestIdx, closer, _mm512_set1_epi32(j));
+		} // end FOR each cluster
+
+		// Count the lanes whose label differs from the one already stored
+		__m512i oldIdx = _mm512_loadu_si512((const void*)(label + i));
+		changed += count_bits((unsigned int)_mm512_cmpneq_epi32_mask(oldIdx, bestIdx));
+
+		_mm512_storeu_si512((void*)(label + i), bestIdx);
+
+		if(sumX)
+		{
+			float dists[16];
+			_mm512_storeu_ps(dists, best);
+			accumulate_lanes(x + i, y + i, label + i, dists, 16, sumX, sumY, sumCount, sumDist);
+		}
+	} // end FOR each group of 16 data points
+
+	return changed + assign_scalar(x + i, y + i, label + i, count - i, cx, cy, numClusters, sumX, sumY, sumCount, sumDist);
+}
+#endif
+
+// Scalar reference path of nearest_two(), tracking the runner-up alongside the winner
+// with the same float operations and tie breaking as the assignment kernel
+static void nearest_two_scalar(const float *x, const float *y, const int count,
+							   const float *cx, const float *cy, const int numClusters,
+							   int *label, float *best, float *second)
+{
+	for(int i=0; i < count; i++)
+	{
+		float bestD = std::numeric_limits<float>::infinity();
+		float secondD = std::numeric_limits<float>::infinity();
+		int bestIdx = 0;
+
+		for(int j=0; j < numClusters; j++)
+		{
+			float dx = x[i] - cx[j];
+			float dy = y[i] - cy[j];
+			float d = dx*dx + dy*dy;
+
+			if(d < bestD)
+			{
+				secondD = bestD;
+				bestD = d;
+				bestIdx = j;
+			}
+			else if(d < secondD)
+				secondD = d;
+		} // end FOR each cluster
+
+		label[i] = bestIdx;
+		best[i] = bestD;
+		second[i] = secondD;
+	} // end FOR each data point
+}
+
+// In the vector paths the runner-up is min(second, max(best, d)) computed before best
+// is updated, which gives the same value as the branches of the scalar path
+
+#ifdef AK_X86
+AK_TARGET_AVX2
+static void nearest_two_avx2(const float *x, const float *y, const int count,
+							 const float *cx, const float *cy, const int numClusters,
+							 int *label, float *best, float *second)
+{
+	const __m256 inf = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+	int i = 0;
+
+	for(; i + 8 <= count; i += 8)
+	{
+		__m256 px = _mm256_loadu_ps(x + i);
+		__m256 py = _mm256_loadu_ps(y + i);
+		__m256 bestD = inf;
+		__m256 secondD = inf;
+		__m256i bestIdx = _mm256_setzero_si256();
+
+		for(int j=0; j < numClusters; j++)
+		{
+			__m256 dx = _mm256_sub_ps(px, _mm256_set1_ps(cx[j]));
+			__m256 dy = _mm256_sub_ps(py, _mm256_set1_ps(cy[j]));
+			__m256 d = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+			__m256 closer = _mm256_cmp_ps(d, bestD, _CMP_LT_OQ);
+
+			secondD = _mm256_min_ps(secondD, _mm256_max_ps(bestD, d));
+			bestD = _mm256_blendv_ps(bestD, d, closer);
+			bestIdx = _mm256_blendv_epi8(bestIdx, _mm256_set1_epi32(j), _mm256_castps_si256(closer));
+		} // end FOR each cluster
+
+		_mm256_storeu_si256((__m256i*)(label + i), bestIdx);
+		_mm256_storeu_ps(best + i, bestD);
+		_mm256_storeu_ps(second + i, secondD);
+	} // end FOR each group of 8 data points
+
+	nearest_two_scalar(x + i, y + i, count - i, cx, cy, numClusters, label + i, best + i, second + i);
+}
+#endif
+
+#ifdef AK_HAVE_AVX512
+AK_TARGET_AVX512
+static void nearest_two_avx512(const float *x, const float *y, const int count,
+							   const float *cx, const float *cy, const int numClusters,
+							   int *label, float *best, float *second)
+{
+	const __m512 inf = _mm512_set1_ps(std::numeric_limits<float>::infinity());
+	int i = 0;
+
+	for(; i + 16 <= count; i += 16)
+	{
+		__m512 px = _mm512_loadu_ps(x + i);
+		__m512 py = _mm512_loadu_ps(y + i);
+		__m512 bestD = inf;
+		__m512 secondD = inf;
+		__m512i bestIdx = _mm512_setzero_si512();
+
+		for(int j=0; j < numClusters; j++)
+		{
+			__m512 dx = _mm512_sub_ps(px, _mm512_set1_ps(cx[j]));
+			__m512 dy = _mm512_sub_ps(py, _mm512_set1_ps(cy[j]));
+			__m512 d = _mm512_add_ps(_mm512_mul_ps(dx, dx), _mm512_mul_ps(dy, dy));
+			__mmask16 closer = _mm512_cmp_ps_mask(d, bestD, _CMP_LT_OQ);
+
+			secondD = _mm512_min_ps(secondD, _mm512_max_ps(bestD, d));
+			bestD = _mm512_mask_mov_ps(bestD, closer, d);
+			bestIdx = _mm512_mask_mov_epi32(bestIdx, closer, _mm512_set1_epi32(j));
+		} // end FOR each cluster
+
+		_mm512_storeu_si512((void*)(label + i), bestIdx);
+		_mm512_storeu_ps(best + i, bestD);
+		_mm512_storeu_ps(second + i, secondD);
+	} // end FOR each group of 16 data points
+
+	nearest_two_scalar(x + i, y + i, count - i, cx, cy, numClusters, label + i, best + i, second + i);
+}
+#endif
+
+CAssignKernel::CAssignKernel()
+{
+	set_path(AK_PATH_AUTO);
+}
+
+CAssignKernel::~CAssignKernel()
+{
+}
+
+// Check whether the CPU (and OS) can run a given path
+bool CAssignKernel::path_supported(const int path)
+{
+	switch(path)
+	{
+	case AK_PATH_SCALAR:
+		return true;
+#ifdef AK_X86
+#if defined(_MSC_VER)
+	case AK_PATH_AVX2:
+	case AK_PATH_AVX512:
+		{
+			int info[4];
+			__cpuid(info, 0);
+			if(info[0] < 7)
+				return false;
+
+			// OSXSAVE and AVX, then check the OS saves the YMM (and ZMM) state
+			__cpuid(info, 1);
+			if((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0)
+				return false;
+
+			unsigned long long xcr0 = _xgetbv(0);
+			if((xcr0 & 0x6) != 0x6)
+				return false;
+
+			__cpuidex(info, 7, 0);
+			if(path == AK_PATH_AVX2)
+				return (info[1] & (1 << 5)) != 0;
+#ifdef AK_HAVE_AVX512
+			return (xcr0 & 0xe0) == 0xe0 && (info[1] & (1 << 16)) != 0;
+#else
+			return false;
+#endif
+		}
+#else
+	case AK_PATH_AVX2:
+		return __builtin_cpu_supports("avx2") != 0;
+	case AK_PATH_AVX512:
+		return __builtin_cpu_supports("avx512f") != 0;
+#endif
+#endif
+	default:
+		return false;
+	}
+}
+
+// Pick the widest path this CPU supports
+int CAssignKernel::detect_path()
+{
+	if(path_supported(AK_PATH_AVX512))
+		return AK_PATH_AVX512;
+	if(path_supported(AK_PATH_AVX2))
+		return AK_PATH_AVX2;
+
+	return AK_PATH_SCALAR;
+}
+
+const char* CAssignKernel::path_name(const int path)
+{
+	switch(path)
+	{
+	case AK_PATH_SCALAR:
+		return "scalar";
+	case AK_PATH_AVX2:
+		return "avx2";
+	case AK_PATH_AVX512:
+		return "avx512";
+	default:
+		return "unknown";
+	}
+}
+
+// Select the path used by assign(), AK_PATH_AUTO picks the best one available
+// Returns the path selected on success, -1 if the CPU can't run the path requested
+int CAssignKernel::set_path(const int newPath)
+{
+	int selected = (newPath == AK_PATH_AUTO) ? detect_path() : newPath;
+
+	if(!path_supported(selected))
+		return -1;
+
+	switch(selected)
+	{
+#ifdef AK_X86
+	case AK_PATH_AVX2:
+		kernel = &assign_avx2;
+		nearestTwo = &nearest_two_avx2;
+		break;
+#endif
+#ifdef AK_HAVE_AVX512
+	case AK_PATH_AVX512:
+		kernel = &assign_avx512;
+		nearestTwo = &nearest_two_avx512;
+		break;
+#endif
+	default:
+		selected = AK_PATH_SCALAR;
+		kernel = &assign_scalar;
+		nearestTwo = &nearest_two_scalar;
+		break;
+	}
+
+	path = selected;
+
+	return path;
+}
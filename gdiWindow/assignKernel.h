@@ -0,0 +1,63 @@
+// assignKernel.h
+// Authored by Alex Shows
+// Released under the MIT License (http://opensource.org/licenses/mit-license.php)
+//
+// Header declaring the CAssignKernel class
+//
+// The nearest-centroid kernel behind CKMeans::assign_data(). Points are compared
+// to the centroids by squared distance (no sqrt) and only the index of the
+// winning centroid is written to the label column. The kernel returns how many
+// labels changed and, when given sum arrays, adds each point to the sums of its
+// winning cluster (and its squared distance to the inertia) in the same pass, so
+// a Lloyd iteration streams the points once.
+//
+// A second kernel, nearest_two(), finds the closest and second closest centroid
+// of points already gathered into float arrays; it serves the bounded (Hamerly)
+// assignment, which only rescans the points its bounds could not settle.
+//
+// There is a scalar reference path plus AVX2 (8 points per instruction) and
+// AVX-512 (16 points per instruction) paths. The best path the CPU supports is
+// picked at runtime. Every path performs the same float operations in the same
+// order and breaks ties toward the lower cluster index, so the labels written
+// are bit-identical whichever path runs.
+
+#pragma once
+
+#include <stddef.h>
+
+#define AK_PATH_SCALAR 0
+#define AK_PATH_AVX2 1
+#define AK_PATH_AVX512 2
+#define AK_PATH_AUTO -1
+
+typedef int (*AssignKernelFn)(const int *x, const int *y, int *label, const int count,
+							  const float *cx, const float *cy, const int numClusters,
+							  long long *sumX, long long *sumY, long long *sumCount, double *sumDist);
+
+typedef void (*NearestTwoFn)(const float *x, const float *y, const int count,
+							 const float *cx, const float *cy, const int numClusters,
+							 int *label, float *best, float *second);
+
+class CAssignKernel
+{
+public:
+	CAssignKernel();
+	~CAssignKernel();
+	int set_path(const int path = AK_PATH_AUTO);
+	int get_path(){ return path;};
+	int assign(const int *x, const int *y, int *label, const int count,
+			   const float *cx, const float *cy, const int numClusters,
+			   long long *sumX = NULL, long long *sumY = NULL, long long *sumCount = NULL, double *sumDist = NULL)
+		{ return kernel(x, y, label, count, cx, cy, numClusters, sumX, sumY, sumCount, sumDist);};
+	void nearest_two(const float *x, const float *y, const int count,
+					 const float *cx, const float *cy, const int numClusters,
+					 int *label, float *best, float *second)
+		{ nearestTwo(x, y, count, cx, cy, numClusters, label, best, second);};
+	static int detect_path();
+	static bool path_supported(const int path);
+	static const char* path_name(const int path);
+private:
+	int path; // AK_PATH_* currently in use
+	AssignKernelFn kernel; // Implementation of that path
+	NearestTwoFn nearestTwo; // Implementation of nearest_two() for that path
+};
@@ -0,0 +1,338 @@
+// clusterSeeder.cpp
+// Authored by Alex Shows
+// Released under the MIT License (http://opensource.org/licenses/mit-license.php)
+//
+// Implementation of the CClusterSeeder class
+// Picks starting cluster positions (k-means++ and k-means||) from the data points
+
+#include "clusterSeeder.h"
+#include "counterRng.h"
+#include "instrument.h"
+#include <limits>
+
+// Streams of CCounterRng used for each kind of draw
+#define CS_STREAM_FIRST 0 // First center, and fallbacks when every point is already a center
+#define CS_STREAM_PLUSPLUS 1 // k-means++ draws, counter is the center number
+#define CS_STREAM_WEIGHTED 2 // Weighted k-means++ over the k-means|| candidates
+#define CS_STREAM_ROUND 16 // k-means|| sampling, one stream per round, counter is the point index
+
+CClusterSeeder::CClusterSeeder(CThreadPool &pool, CAssignKernel &kernel) : threadPool(pool), assignKernel(kernel)
+{
+	pPoints = NULL;
+	numChunks = 0;
+}
+
+CClusterSeeder::~CClusterSeeder()
+{
+}
+
+// Squared distance between two points of the store
+static inline float squared_distance(const int *x, const int *y, const int a, const int b)
+{
+	float dx = (float)(x[a] - x[b]);
+	float dy = (float)(y[a] - y[b]);
+
+	return dx*dx + dy*dy;
+}
+
+// Choose the first point and measure every point against it
+void CClusterSeeder::start(CPointStore &points, const int first)
+{
+	pPoints = &points;
+	numChunks = CThreadPool::chunk_count(points.get_count(), CS_MIN_CHUNK_POINTS, CS_MAX_CHUNKS);
+
+	chosen.clear();
+	chosen.push_back(first);
+	minDist.resize(points.get_count());
+	nearest.resize(points.get_count());
+	chunkCost.assign(numChunks, 0.0);
+
+	threadPool.run(numChunks, [this, first](int chunk)
+	{
+		const int begin = CThreadPool::chunk_begin(pPoints->get_count(), chunk, numChunks);
+		const int end = CThreadPool::chunk_begin(pPoints->get_count(), chunk + 1, numChunks);
+		const int *x = pPoints->get_x();
+		const int *y = pPoints->get_y();
+		double cost = 0.0;
+
+		for(int i=begin; i < end; i++)
+		{
+			minDist[i] = squared_distance(x, y, i, first);
+			nearest[i] = 0;
+			cost += minDist[i];
+		}
+
+		chunkCost[chunk] = cost;
+	});
+}
+
+// Measure every point against the chosen points from firstNew onward, keeping the nearest
+void CClusterSeeder::add_centers(const int firstNew)
+{
+	const int numNew = (int)chosen.size() - firstNew;
+	const int *x = pPoints->get_x();
+	const int *y = pPoints->get_y();
+
+	// Every point reads its x and y and reads and writes its nearest distance and center
+	KI_COUNT("seed.distances", (long long)pPoints->get_count() * numNew);
+	KI_COUNT("seed.bytes", (long long)pPoints->get_count() * 16);
+
+	newX.resize(numNew);
+	newY.resize(numNew);
+	for(int c=0; c < numNew; c++)
+	{
+		newX[c] = (float)x[chosen[firstNew + c]];
+		newY[c] = (float)y[chosen[firstNew + c]];
+	}
+
+	threadPool.run(numChunks, [this, firstNew, numNew, x, y](int chunk)
+	{
+		const int begin = CThreadPool::chunk_begin(pPoints->get_count(), chunk, numChunks);
+		const int end = CThreadPool::chunk_begin(pPoints->get_count(), chunk + 1, numChunks);
+		float blockX[CS_BLOCK_POINTS], blockY[CS_BLOCK_POINTS], best[CS_BLOCK_POINTS], second[CS_BLOCK_POINTS];
+		int label[CS_BLOCK_POINTS];
+		double cost = 0.0;
+
+		for(int blockStart=begin; blockStart < end; blockStart += CS_BLOCK_POINTS)
+		{
+			const int count = (end - blockStart < CS_BLOCK_POINTS) ? end - blockStart : CS_BLOCK_POINTS;
+
+			for(int j=0; j < count; j++)
+			{
+				blockX[j] = (float)x[blockStart + j];
+				blockY[j] = (float)y[blockStart + j];
+			}
+
+			assignKernel.nearest_two(blockX, blockY, count, &newX[0], &newY[0], numNew, label, best, second);
+
+			for(int j=0; j < count; j++)
+			{
+				const int i = blockStart + j;
+				if(best[j] < minDist[i])
+				{
+					minDist[i] = best[j];
+					nearest[i] = firstNew + label[j];
+				}
+
+				cost += minDist[i];
+			}
+		} // end FOR each block of points
+
+		chunkCost[chunk] = cost;
+	});
+}
+
+// Find the point at which the running sum of minDist, in point order, passes r
+// Returns the point index, or -1 if every point is already at a chosen point
+int CClusterSeeder::sample_proportional(const double r)
+{
+	const int numPoints = pPoints->get_count();
+	double before = 0.0;
+	int lastPositive = -1;
+
+	for(int chunk=0; chunk < numChunks; chunk++)
+	{
+		// Skip whole chunks using the per chunk sums
+		if(before + chunkCost[chunk] <= r && chunk + 1 < numChunks)
+		{
+			before += chunkCost[chunk];
+			continue;
+		}
+
+		const int begin = CThreadPool::chunk_begin(numPoints, chunk, numChunks);
+		const int end = CThreadPool::chunk_begin(numPoints, chunk + 1, numChunks);
+
+		for(int i=begin; i < end; i++)
+		{
+			if(minDist[i] <= 0.0f)
+				continue;
+
+			lastPositive = i;
+			before += minDist[i];
+			if(before > r)
+				return i;
+		}
+	} // end FOR each chunk
+
+	// Rounding left r just past the total; the last candidate is the right answer
+	return lastPositive;
+}
+
+// k-means++: pick numClusters point indices into centers
+// Returns the number of centers picked
+int CClusterSeeder::seed_plusplus(CPointStore &points, const int numClusters, const unsigned long long seed, vector<int> &centers)
+{
+	KI_SCOPE("seed_plusplus");
+
+	const int numPoints = points.get_count();
+
+	centers.clear();
+	if(numPoints < 1 || numClusters < 1)
+		return 0;
+
+	start(points, (int)CCounterRng::below(seed, CS_STREAM_FIRST, 0, numPoints));
+
+	for(int t=(int)chosen.size(); t < numClusters; t++)
+	{
+		double total = 0.0;
+		for(int c=0; c < numChunks; c++)
+			total += chunkCost[c];
+
+		int idx = sample_proportional(CCounterRng::uniform(seed, CS_STREAM_PLUSPLUS, t) * total);
+
+		// Every point sits on a center already, so any point will do
+		if(idx < 0)
+			idx = (int)CCounterRng::below(seed, CS_STREAM_FIRST, t, numPoints);
+
+		chosen.push_back(idx);
+		add_centers((int)chosen.size() - 1);
+	} // end FOR each center
+
+	centers.assign(chosen.begin(), chosen.end());
+
+	return (int)centers.size();
+}
+
+// k-means||: pick numClusters point indices into centers
+// Returns the number of centers picked
+int CClusterSeeder::seed_parallel(CPointStore &points, const int numClusters, const unsigned long long seed, vector<int> &centers,
+								  const int rounds, const double oversampling)
+{
+	KI_SCOPE("seed_parallel");
+
+	const int numPoints = points.get_count();
+
+	centers.clear();
+	if(numPoints < 1 || numClusters < 1)
+		return 0;
+
+	start(points, (int)CCounterRng::below(seed, CS_STREAM_FIRST, 0, numPoints));
+
+	const double sampleRate = oversampling * numClusters;
+	chunkPicks.resize(numChunks);
+
+	for(int round=0; round < rounds; round++)
+	{
+		double psi = 0.0;
+		for(int c=0; c < numChunks; c++)
+			psi += chunkCost[c];
+
+		if(psi <= 0.0)
+			break;
+
+		// Every point is sampled independently with probability sampleRate * minDist / psi
+		threadPool.run(numChunks, [&, round, psi](int chunk)
+		{
+			const int begin = CThreadPool::chunk_begin(numPoints, chunk, numChunks);
+			const int end = CThreadPool::chunk_begin(numPoints, chunk + 1, numChunks);
+			vector<int> &picks = chunkPicks[chunk];
+
+			picks.clear();
+			for(int i=begin; i < end; i++)
+			{
+				if(CCounterRng::uniform(seed, CS_STREAM_ROUND + round, i) * psi < sampleRate * minDist[i])
+					picks.push_back(i);
+			}
+		});
+
+		// Gather the picks in chunk order so the candidates don't depend on the thread count
+		const int firstNew = (int)chosen.size();
+		for(int c=0; c < numChunks; c++)
+			chosen.insert(chosen.end(), chunkPicks[c].begin(), chunkPicks[c].end());
+
+		if((int)chosen.size() > firstNew)
+			add_centers(firstNew);
+	} // end FOR each round
+
+	const int numCandidates = (int)chosen.size();
+
+	// Too few candidates; keep them all and top up with k-means++ over the full data
+	if(numCandidates <= numClusters)
+	{
+		for(int t=numCandidates; t < numClusters; t++)
+		{
+			double total = 0.0;
+			for(int c=0; c < numChunks; c++)
+				total += chunkCost[c];
+
+			int idx = sample_proportional(CCounterRng::uniform(seed, CS_STREAM_PLUSPLUS, t) * total);
+			if(idx < 0)
+				idx = (int)CCounterRng::below(seed, CS_STREAM_FIRST, t, numPoints);
+
+			chosen.push_back(idx);
+			add_centers((int)chosen.size() - 1);
+		}
+
+		centers.assign(chosen.begin(), chosen.end());
+		return (int)centers.size();
+	}
+
+	// Weight each candidate by the number of points it is closest to
+	partialWeight.assign((size_t)numChunks * numCandidates, 0);
+	threadPool.run(numChunks, [&](int chunk)
+	{
+		const int begin = CThreadPool::chunk_begin(numPoints, chunk, numChunks);
+		const int end = CThreadPool::chunk_begin(numPoints, chunk + 1, numChunks);
+		long long *weight = &partialWeight[(size_t)chunk * numCandidates];
+
+		for(int i=begin; i < end; i++)
+			weight[nearest[i]]++;
+	});
+
+	weight.assign(numCandidates, 0.0);
+	for(int c=0; c < numChunks; c++)
+		for(int k=0; k < numCandidates; k++)
+			weight[k] += (double)partialWeight[(size_t)c * numCandidates + k];
+
+	// Weighted k-means++ over the candidates
+	const int *x = points.get_x();
+	const int *y = points.get_y();
+	candDist.assign(numCandidates, numeric_limits<double>::infinity());
+	picked.clear();
+
+	for(int t=0; t < numClusters; t++)
+	{
+		double total = 0.0;
+		for(int k=0; k < numCandidates; k++)
+			total += (t ? candDist[k] : 1.0) * weight[k];
+
+		double r = CCounterRng::uniform(seed, CS_STREAM_WEIGHTED, t) * total;
+		int pick = -1;
+		int lastPositive = -1;
+		double before = 0.0;
+
+		for(int k=0; k < numCandidates && pick < 0; k++)
+		{
+			double w = (t ? candDist[k] : 1.0) * weight[k];
+			if(w <= 0.0)
+				continue;
+
+			lastPositive = k;
+			before += w;
+			if(before > r)
+				pick = k;
+		}
+
+		if(pick < 0)
+			pick = lastPositive;
+		// Every candidate is taken or carries no weight, take the next unused one
+		for(int k=0; pick < 0 && k < numCandidates; k++)
+			if(candDist[k] > 0.0)
+				pick = k;
+		if(pick < 0)
+			pick = t % numCandidates;
+
+		picked.push_back(chosen[pick]);
+
+		for(int k=0; k < numCandidates; k++)
+		{
+			double d = (double)squared_distance(x, y, chosen[k], chosen[pick]);
+			if(d < candDist[k])
+				candDist[k] = d;
+		}
+	} // end FOR each center
+
+	centers.assign(picked.begin(), picked.end());
+
+	return (int)centers.size();
+}
@@ -0,0 +1,69 @@
+// clusterSeeder.h
+// Authored by Alex Shows
+// Released under the MIT License (http://opensource.org/licenses/mit-license.php)
+//
+// Header declaring the CClusterSeeder class
+//
+// Picks starting cluster positions from the data points:
+//
+//	k-means++	Each new center is a point drawn with probability proportional to its
+//				squared distance from the centers chosen so far. K passes over the data,
+//				each of them split across the thread pool
+//	k-means||	(Bahmani et al.) A few rounds in which every point is sampled independently,
+//				with probability proportional to its squared distance, oversampling about
+//				2K candidates per round. The candidates are weighted by how many points
+//				they are closest to and reduced to K centers with a weighted k-means++
+//
+// All randomness comes from CCounterRng keyed by the point index, and the data is split
+// into chunks independent of the thread count, so the centers picked for a given seed are
+// the same on any number of threads
+//
+// The per point and per candidate buffers are members, sized on demand and kept between
+// calls, so a seeder that lives as long as its engine picks centers again and again
+// without allocating once the buffers have grown to the data
+
+#pragma once
+
+#include "pointStore.h"
+#include "threadPool.h"
+#include "assignKernel.h"
+#include <vector>
+using namespace std;
+
+#define CS_MIN_CHUNK_POINTS 16384 // Chunks are never smaller than this, unless there are fewer points
+#define CS_MAX_CHUNKS 256 // Upper bound on the chunks a pass splits the points into
+#define CS_PARALLEL_ROUNDS 5 // Sampling rounds of k-means||
+#define CS_OVERSAMPLING 2.0 // Candidates sampled per round of k-means||, as a multiple of K
+#define CS_BLOCK_POINTS 256 // Points converted to float and handed to the kernel at a time
+
+class CClusterSeeder
+{
+public:
+	CClusterSeeder(CThreadPool &pool, CAssignKernel &kernel);
+	~CClusterSeeder();
+	int seed_plusplus(CPointStore &points, const int numClusters, const unsigned long long seed, vector<int> &centers);
+	int seed_parallel(CPointStore &points, const int numClusters, const unsigned long long seed, vector<int> &centers,
+					  const int rounds = CS_PARALLEL_ROUNDS, const double oversampling = CS_OVERSAMPLING);
+private:
+	// Not copyable, holds references to the pool and kernel
+	CClusterSeeder(const CClusterSeeder&);
+	CClusterSeeder& operator=(const CClusterSeeder&);
+	void start(CPointStore &points, const int first);
+	void add_centers(const int firstNew);
+	int sample_proportional(const double r);
+	CThreadPool &threadPool; // Workers for the passes over the points
+	CAssignKernel &assignKernel; // Finds the nearest of the newly chosen points
+	CPointStore *pPoints; // Points being seeded
+	int numChunks; // Chunks the points are split into
+	vector<int> chosen; // Point indices picked so far (centers, or k-means|| candidates)
+	vector<float> minDist; // Per point squared distance to the nearest chosen point
+	vector<int> nearest; // Per point index into chosen of the nearest chosen point
+	vector<double> chunkCost; // Per chunk sum of minDist
+	vector<float> newX; // x of the chosen points being added, as floats for the kernel
+	vector<float> newY; // y of the chosen points being added, as floats for the kernel
+	vector< vector<int> > chunkPicks; // Per chunk, points k-means|| sampled in the current round
+	vector<long long> partialWeight; // Per chunk, per candidate number of points closest to it
+	vector<double> weight; // Per candidate number of points closest to it
+	vector<double> candDist; // Per candidate squared distance to the nearest center picked
+	vector<int> picked; // Candidates picked as centers by the weighted k-means++
+};
@@ -0,0 +1,45 @@
+// counterRng.h
+// Authored by Alex Shows
+// Released under the MIT License (http://opensource.org/licenses/mit-license.php)
+//
+// Header declaring and implementing the CCounterRng class
+//
+// A counter-based random number generator. The number drawn for a given
+// (seed, stream, counter) is a pure function of those three values, so parallel
+// code can draw the n-th number of any stream without sharing any state, and
+// gets the same numbers whatever the number of threads or the order they run in
+
+#pragma once
+
+class CCounterRng
+{
+public:
+	// 64 random bits for the counter-th draw of a stream
+	static unsigned long long bits(const unsigned long long seed, const unsigned long long stream, const unsigned long long counter)
+	{
+		// Two rounds of the SplitMix64 finalizer over a Weyl sequence of the inputs
+		unsigned long long z = seed * 0x9E3779B97F4A7C15ULL + stream * 0xD1B54A32D192ED03ULL + counter;
+		z = mix(z + 0x9E3779B97F4A7C15ULL);
+		return mix(z ^ (counter * 0xBF58476D1CE4E5B9ULL));
+	};
+
+	// Uniform double in [0, 1) for the counter-th draw of a stream
+	static double uniform(const unsigned long long seed, const unsigned long long stream, const unsigned long long counter)
+	{
+		return (double)(bits(seed, stream, counter) >> 11) * (1.0 / 9007199254740992.0);
+	};
+
+	// Uniform integer in [0, range) for the counter-th draw of a stream
+	static unsigned long long below(const unsigned long long seed, const unsigned long long stream, const unsigned long long counter,
+									const unsigned long long range)
+	{
+		return range ? (unsigned long long)(uniform(seed, stream, counter) * (double)range) % range : 0;
+	};
+private:
+	static unsigned long long mix(unsigned long long z)
+	{
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+		return z ^ (z >> 31);
+	};
+};
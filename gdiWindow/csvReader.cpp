@@ -0,0 +1,417 @@
+// csvReader.cpp
+// Authored by Alex Shows
+// Released under the MIT License (http://opensource.org/licenses/mit-license.php)
+//
+// Implementation of the CCsvReader class
+// Parallel, chunked loading of delimited text files into a CPointStore
+
+#include "csvReader.h"
+#include "dataPoint.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+
+// Index of each attribute in columns[] and the values parse_row() fills in
+#define CR_X 0
+#define CR_Y 1
+#define CR_R 2
+#define CR_G 3
+#define CR_B 4
+#define CR_ATTRIBUTES 5
+
+// Lowest and highest value of each attribute a row may hold
+static const double crLowest[CR_ATTRIBUTES] = { CDP_X_LOWER_BOUND, CDP_Y_LOWER_BOUND, CDP_COLOR_LOWER_BOUND, CDP_COLOR_LOWER_BOUND, CDP_COLOR_LOWER_BOUND };
+static const double crHighest[CR_ATTRIBUTES] = { CDP_X_UPPER_BOUND, CDP_Y_UPPER_BOUND, CDP_COLOR_UPPER_BOUND, CDP_COLOR_UPPER_BOUND, CDP_COLOR_UPPER_BOUND };
+
+CCsvReader::CCsvReader()
+{
+	columns[CR_X] = 0;
+	columns[CR_Y] = 1;
+	columns[CR_R] = columns[CR_G] = columns[CR_B] = CR_NO_COLUMN;
+	lastColumn = 1;
+	delimiter = ',';
+	rowsRead = rejectedRows = 0;
+	headerSkipped = false;
+}
+
+CCsvReader::~CCsvReader()
+{
+}
+
+// Choose the (zero based) file columns holding x and y, and optionally the color.
+// The color is only read if all three of its columns are given
+// Returns 0 on success, -1 otherwise
+int CCsvReader::set_columns(const int xCol, const int yCol, const int rCol, const int gCol, const int bCol)
+{
+	if(xCol < 0 || yCol < 0)
+		return -1;
+
+	const bool withColor = rCol >= 0 && gCol >= 0 && bCol >= 0;
+
+	columns[CR_X] = xCol;
+	columns[CR_Y] = yCol;
+	columns[CR_R] = withColor ? rCol : CR_NO_COLUMN;
+	columns[CR_G] = withColor ? gCol : CR_NO_COLUMN;
+	columns[CR_B] = withColor ? bCol : CR_NO_COLUMN;
+
+	lastColumn = 0;
+	for(int a=0; a < CR_ATTRIBUTES; a++)
+		if(columns[a] > lastColumn)
+			lastColumn = columns[a];
+
+	return 0;
+}
+
+// Parse the number in [begin, end), allowing surrounding blanks and quotes
+// Returns true and sets value on success, false if the field isn't a number
+static bool parse_number(const char *begin, const char *end, double &value)
+{
+	static const double powersOfTen[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+										  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+	while(begin < end && (*begin == ' ' || *begin == '\t'))
+		begin++;
+	while(end > begin && (end[-1] == ' ' || end[-1] == '\t'))
+		end--;
+	if(end - begin >= 2 && *begin == '"' && end[-1] == '"')
+	{
+		begin++;
+		end--;
+	}
+
+	const char *p = begin;
+	bool negative = false;
+	if(p < end && (*p == '-' || *p == '+'))
+		negative = (*p++ == '-');
+
+	unsigned long long mantissa = 0;
+	int exponent = 0;
+	int digits = 0;
+
+	for(; p < end && *p >= '0' && *p <= '9'; p++, digits++)
+	{
+		// Beyond 18 digits only the magnitude matters
+		if(mantissa < 100000000000000000ULL)
+			mantissa = mantissa * 10 + (*p - '0');
+		else
+			exponent++;
+	}
+
+	if(p < end && *p == '.')
+	{
+		for(p++; p < end && *p >= '0' && *p <= '9'; p++, digits++)
+		{
+			if(mantissa < 100000000000000000ULL)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+				exponent--;
+			}
+		}
+	}
+
+	if(!digits)
+		return false;
+
+	if(p < end && (*p == 'e' || *p == 'E'))
+	{
+		bool negativeExponent = false;
+		int explicitExponent = 0;
+
+		p++;
+		if(p < end && (*p == '-' || *p == '+'))
+			negativeExponent = (*p++ == '-');
+		if(p == end || *p < '0' || *p > '9')
+			return false;
+		for(; p < end && *p >= '0' && *p <= '9'; p++)
+			if(explicitExponent < 10000)
+				explicitExponent = explicitExponent * 10 + (*p - '0');
+
+		exponent += negativeExponent ? -explicitExponent : explicitExponent;
+	}
+
+	if(p != end)
+		return false;
+
+	// Zero stays zero whatever the exponent, rather than 0 * inf
+	double v = (double)mantissa;
+	if(!mantissa)
+		exponent = 0;
+	if(exponent >= 0)
+		v *= exponent <= 22 ? powersOfTen[exponent] : pow(10.0, exponent);
+	else
+		v /= -exponent <= 22 ? powersOfTen[-exponent] : pow(10.0, -exponent);
+
+	value = negative ? -v : v;
+
+	return true;
+}
+
+// Parse the fields of one line needed for the attributes into values
+// Returns 0 on success, -1 if a field is missing or not a number, -2 if a number is out
+// of range (so a first line of numbers isn't mistaken for a header)
+int CCsvReader::parse_row(const char *line, const char *lineEnd, int *values)
+{
+	const char *field = line;
+
+	for(int col=0; col <= lastColumn; col++)
+	{
+		if(field > lineEnd)
+			return -1;
+
+		const char *fieldEnd = (const char*)memchr(field, delimiter, lineEnd - field);
+		if(!fieldEnd)
+			fieldEnd = lineEnd;
+
+		for(int a=0; a < CR_ATTRIBUTES; a++)
+		{
+			if(columns[a] != col)
+				continue;
+
+			double v;
+			if(!parse_number(field, fieldEnd, v))
+				return -1;
+
+			// Coordinates have to round into the range the clusters can move in (see
+			// CDataPoint), colors into a byte; written so NaN fails too
+			if(!(v >= crLowest[a] - 0.5 && v < crHighest[a] + 0.5))
+				return -2;
+
+			values[a] = (int)floor(v + 0.5);
+		} // end FOR each attribute
+
+		field = fieldEnd + 1;
+	} // end FOR each column
+
+	return 0;
+}
+
+// Parse every line of text (which ends at a line boundary) and append the rows to store
+// Returns 0 on success, -1 if the store can't hold the rows
+int CCsvReader::parse_block(const char *text, const size_t bytes, const bool firstBlock, CPointStore &store, CThreadPool &pool)
+{
+	const int numChunks = CThreadPool::chunk_count((int)bytes, CR_MIN_CHUNK_BYTES, CR_MAX_CHUNKS);
+
+	// Move each chunk's nominal start forward to the beginning of a line
+	chunkStart.resize(numChunks + 1);
+	chunkStart[0] = 0;
+	for(int c=1; c < numChunks; c++)
+	{
+		size_t start = (size_t)CThreadPool::chunk_begin((int)bytes, c, numChunks);
+		if(start < chunkStart[c - 1])
+			start = chunkStart[c - 1];
+		if(start > 0 && start < bytes && text[start - 1] != '\n')
+		{
+			const char *newline = (const char*)memchr(text + start, '\n', bytes - start);
+			start = newline ? (size_t)(newline - text) + 1 : bytes;
+		}
+		chunkStart[c] = start;
+	}
+	chunkStart[numChunks] = bytes;
+
+	// First pass, count the lines of each chunk
+	chunkLines.assign(numChunks, 0);
+	pool.run(numChunks, [this, text](int chunk)
+	{
+		const char *p = text + chunkStart[chunk];
+		const char *end = text + chunkStart[chunk + 1];
+		int lines = 0;
+
+		while(p < end)
+		{
+			const char *newline = (const char*)memchr(p, '\n', end - p);
+			lines++;
+			p = newline ? newline + 1 : end;
+		}
+
+		chunkLines[chunk] = lines;
+	});
+
+	const int base = store.get_count();
+	long long totalLines = 0;
+	for(int c=0; c < numChunks; c++)
+		totalLines += chunkLines[c];
+
+	if(base + totalLines > INT_MAX)
+		return -1;
+
+	// Grow geometrically, the blocks would otherwise copy the columns over and over
+	const int needed = base + (int)totalLines;
+	if(needed > store.get_capacity())
+	{
+		long long grown = 2LL * store.get_capacity();
+		if(store.reserve(grown > needed && grown <= INT_MAX ? (int)grown : needed) < 0)
+			return -1;
+	}
+	if(store.resize(needed) < 0)
+		return -1;
+
+	// Second pass, parse each chunk's lines into the rows starting where its lines start
+	chunkRows.assign(numChunks, 0);
+	chunkRejected.assign(numChunks, 0);
+	pool.run(numChunks, [this, text, firstBlock, base, &store](int chunk)
+	{
+		int row = base;
+		for(int c=0; c < chunk; c++)
+			row += chunkLines[c];
+
+		int *x = store.get_x();
+		int *y = store.get_y();
+		int *label = store.get_label();
+		unsigned char *size = store.get_size();
+		unsigned char *r = store.get_r();
+		unsigned char *g = store.get_g();
+		unsigned char *b = store.get_b();
+		const char *p = text + chunkStart[chunk];
+		const char *end = text + chunkStart[chunk + 1];
+		int rows = 0;
+		int rejected = 0;
+
+		while(p < end)
+		{
+			const char *newline = (const char*)memchr(p, '\n', end - p);
+			const char *lineEnd = newline ? newline : end;
+			const bool firstLine = firstBlock && !chunk && p == text;
+			int values[CR_ATTRIBUTES] = { 0, 0, 0, 0, 0 };
+			int parsed = 0;
+
+			if(lineEnd > p && lineEnd[-1] == '\r')
+				lineEnd--;
+
+			const char *q = p;
+			while(q < lineEnd && (*q == ' ' || *q == '\t'))
+				q++;
+
+			if(q == lineEnd)
+			{
+				// Blank line, neither a row nor a rejection
+			}
+			else if(!(parsed = parse_row(p, lineEnd, values)))
+			{
+				const int i = row + rows;
+				x[i] = values[CR_X];
+				y[i] = values[CR_Y];
+				label[i] = CPS_UNASSIGNED;
+				size[i] = 3;
+				r[i] = (unsigned char)values[CR_R];
+				g[i] = (unsigned char)values[CR_G];
+				b[i] = (unsigned char)values[CR_B];
+				rows++;
+			}
+			else if(firstLine && parsed == -1)
+				headerSkipped = true;
+			else
+				rejected++;
+
+			p = newline ? newline + 1 : end;
+		} // end WHILE lines left in the chunk
+
+		chunkRows[chunk] = rows;
+		chunkRejected[chunk] = rejected;
+	});
+
+	// Close the gaps left by blank and rejected lines, in chunk order
+	int write = base + chunkRows[0];
+	int read = base + chunkLines[0];
+	rejectedRows += chunkRejected[0];
+	for(int c=1; c < numChunks; c++)
+	{
+		const int rows = chunkRows[c];
+		if(rows && read != write)
+		{
+			memmove(store.get_x() + write, store.get_x() + read, sizeof(int) * rows);
+			memmove(store.get_y() + write, store.get_y() + read, sizeof(int) * rows);
+			memmove(store.get_label() + write, store.get_label() + read, sizeof(int) * rows);
+			memmove(store.get_size() + write, store.get_size() + read, rows);
+			memmove(store.get_r() + write, store.get_r() + read, rows);
+			memmove(store.get_g() + write, store.get_g() + read, rows);
+			memmove(store.get_b() + write, store.get_b() + read, rows);
+		}
+
+		write += rows;
+		read += chunkLines[c];
+		rejectedRows += chunkRejected[c];
+	} // end FOR each chunk
+
+	return store.resize(write) < 0 ? -1 : 0;
+}
+
+// Replace the contents of store with the rows of the file at path, parsing on pool
+// Returns the number of rows loaded, -1 on error (unreadable file, out of memory, or
+// more rows than a store holds)
+int CCsvReader::read(const char *path, CPointStore &store, CThreadPool &pool)
+{
+	rowsRead = rejectedRows = 0;
+	headerSkipped = false;
+
+	FILE *fp = fopen(path, "rb");
+	if(!fp)
+		return -1;
+
+	store.clear();
+
+	if(buffer.size() < CR_BLOCK_BYTES)
+		buffer.resize(CR_BLOCK_BYTES);
+	size_t carry = 0; // Bytes of an unfinished line kept from the previous block
+	bool firstBlock = true;
+	int result = 0;
+
+	for(;;)
+	{
+		const size_t wanted = buffer.size() - carry;
+		const size_t got = fread(&buffer[carry], 1, wanted, fp);
+		const size_t avail = carry + got;
+		const bool atEnd = got < wanted;
+
+		if(atEnd && ferror(fp))
+		{
+			result = -1;
+			break;
+		}
+
+		if(!avail)
+			break;
+
+		// Parse up to the last complete line, or everything at the end of the file
+		size_t end = avail;
+		if(!atEnd)
+		{
+			while(end > 0 && buffer[end - 1] != '\n')
+				end--;
+
+			// A line longer than the buffer, make room for it and read on
+			if(!end)
+			{
+				carry = avail;
+				buffer.resize(buffer.size() * 2);
+				continue;
+			}
+		}
+
+		if(parse_block(&buffer[0], end, firstBlock, store, pool) < 0)
+		{
+			result = -1;
+			break;
+		}
+		firstBlock = false;
+
+		carry = avail - end;
+		if(carry)
+			memmove(&buffer[0], &buffer[end], carry);
+
+		if(atEnd)
+			break;
+	} // end FOR each block
+
+	fclose(fp);
+
+	if(result < 0)
+	{
+		store.clear();
+		return -1;
+	}
+
+	rowsRead = store.get_count();
+
+	return (int)rowsRead;
+}
@@ -0,0 +1,61 @@
+// csvReader.h
+// Authored by Alex Shows
+// Released under the MIT License (http://opensource.org/licenses/mit-license.php)
+//
+// Header declaring the CCsvReader class
+//
+// Loads the points of a CSV (or other delimited text) file straight into the
+// columns of a CPointStore. The file is read a block at a time, each block is cut
+// into chunks at line boundaries, and the chunks are parsed in parallel on a thread
+// pool in two passes: the first counts the lines of every chunk so each knows where
+// its rows go, the second parses the numbers in place (no per-field allocation, no
+// CDataPoint per row) and writes them directly into the store
+//
+// A row is rejected, and counted, if a column it needs is missing or isn't a number
+// in range. The range of x and y is the one CDataPoint keeps the clusters in
+// (CDP_X_LOWER_BOUND to CDP_X_UPPER_BOUND, likewise for y), as points outside it
+// could never be reached by a cluster; blank lines are skipped and a first line that doesn't parse is taken to
+// be a header. Numbers may have a sign, a fraction and an exponent, and may be quoted;
+// coordinates are rounded to the nearest integer
+
+#pragma once
+
+#include "pointStore.h"
+#include "threadPool.h"
+#include <vector>
+using namespace std;
+
+#define CR_BLOCK_BYTES (16 << 20) // Bytes read from the file at a time
+#define CR_MIN_CHUNK_BYTES (256 << 10) // Chunks are never smaller than this, unless the block is
+#define CR_MAX_CHUNKS 256 // Upper bound on the chunks a block is split into
+#define CR_NO_COLUMN -1 // Column index of an attribute not in the file
+
+class CCsvReader
+{
+public:
+	CCsvReader();
+	~CCsvReader();
+	int set_columns(const int xCol, const int yCol, const int rCol = CR_NO_COLUMN, const int gCol = CR_NO_COLUMN, const int bCol = CR_NO_COLUMN);
+	void set_delimiter(const char delim){ delimiter = delim;};
+	int read(const char *path, CPointStore &store, CThreadPool &pool);
+	long long get_rows_read(){ return rowsRead;};
+	long long get_rejected_rows(){ return rejectedRows;};
+	bool get_header_skipped(){ return headerSkipped;};
+private:
+	// Not copyable, the block buffer is kept from one read() to the next
+	CCsvReader(const CCsvReader&);
+	CCsvReader& operator=(const CCsvReader&);
+	int parse_block(const char *text, const size_t bytes, const bool firstBlock, CPointStore &store, CThreadPool &pool);
+	int parse_row(const char *line, const char *lineEnd, int *values);
+	int columns[5]; // File column of x, y, r, g and b, CR_NO_COLUMN if absent
+	int lastColumn; // Highest column index needed
+	char delimiter; // Field separator, ',' by default
+	long long rowsRead; // Rows loaded by the last read()
+	long long rejectedRows; // Rows rejected by the last read()
+	bool headerSkipped; // Whether the last read() skipped a header line
+	vector<size_t> chunkStart; // Per chunk offset of its first line within the block
+	vector<int> chunkLines; // Per chunk number of lines
+	vector<int> chunkRows; // Per chunk rows parsed
+	vector<int> chunkRejected; // Per chunk rows rejected
+	vector<char> buffer; // Block of the file being parsed, kept from one read() to the next
+};
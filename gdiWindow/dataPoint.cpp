@@ -47,12 +47,12 @@ CDataPoint::~CDataPoint()
 // Returns the value assigned on success, -1 otherwise
 int CDataPoint::set_clusterIndex(int idx)
 {
-	if(idx)
+	if(idx >= 0)
 		clusterIndex = idx;
 	else
 		return -1;
 
-	return x;
+	return clusterIndex;
 }
 
 // Check bounds and assign the value if param is within bounds
@@ -6,6 +6,8 @@
 // 
 // Encapsulates interesting information for a particular observation
 
+#pragma once
+
 #define CDP_X_LOWER_BOUND 0
 #define CDP_X_UPPER_BOUND 500
 #define CDP_Y_LOWER_BOUND 0
@@ -0,0 +1,251 @@
+// densityMap.cpp
+// Authored by Alex Shows
+// Released under the MIT License (http://opensource.org/licenses/mit-license.php)
+//
+// Implementation of the CDensityMap class
+// Bins points into a per pixel density grid and draws it as a heatmap
+
+#include "densityMap.h"
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+
+#define DM_ALPHA_TABLE 4096 // Counts below this have their opacity looked up
+
+CDensityMap::CDensityMap()
+{
+	width = height = 0;
+	maxCount = 0;
+}
+
+CDensityMap::~CDensityMap()
+{
+}
+
+// Set the size of the map, which covers pixels [0, w) x [0, h) of the point coordinates
+// Returns 0 on success, -1 otherwise
+int CDensityMap::resize(const int w, const int h)
+{
+	if(w < 1 || h < 1)
+		return -1;
+
+	width = w;
+	height = h;
+	count.assign((size_t)w * h, 0);
+	sumR.assign(count.size(), 0);
+	sumG.assign(count.size(), 0);
+	sumB.assign(count.size(), 0);
+	partial.clear();
+	maxCount = 0;
+
+	return 0;
+}
+
+// Add the points [begin, end) to bins. A point lands on the center of the circle it
+// would be drawn as
+void CDensityMap::bin_chunk(CPointStore &points, const int begin, const int end, CDensityBin *bins)
+{
+	const int numClusters = (int)clusterColor.size();
+	const int *x = points.get_x();
+	const int *y = points.get_y();
+	const int *label = points.get_label();
+	const unsigned char *size = points.get_size();
+	const unsigned char *r = points.get_r();
+	const unsigned char *g = points.get_g();
+	const unsigned char *b = points.get_b();
+
+	for(int i=begin; i < end; i++)
+	{
+		const int half = size[i] / 2;
+		const unsigned int px = (unsigned int)(x[i] + half + half);
+		const unsigned int py = (unsigned int)(y[i] + half + half);
+
+		// Negative coordinates wrap around and fail the test as well
+		if(px >= (unsigned int)width || py >= (unsigned int)height)
+			continue;
+
+		CDensityBin &bin = bins[(size_t)py * width + px];
+		const int l = label[i];
+
+		bin.count++;
+		if(l >= 0 && l < numClusters)
+		{
+			const uint32_t color = clusterColor[l];
+			bin.r += color & 0xFF;
+			bin.g += (color >> 8) & 0xFF;
+			bin.b += color >> 16;
+		}
+		else
+		{
+			bin.r += r[i];
+			bin.g += g[i];
+			bin.b += b[i];
+		}
+	} // end FOR each data point of the chunk
+}
+
+// Bin every point, on pool if passed. Chunks run a pool's worth at a time, each into
+// its own bins, which are then added to the map
+void CDensityMap::bin(CPointStore &points, vector<CDataPoint> &clusters, CThreadPool *pool)
+{
+	const int numPoints = points.get_count();
+	const int numClusters = (int)clusters.size();
+	const size_t numPixels = count.size();
+	const size_t gridBytes = numPixels * sizeof(CDensityBin);
+	int maxParallel = pool ? pool->get_thread_count() : 1;
+
+	// Fewer chunks run at once on a large map, rather than a grid per thread
+	if(maxParallel > 1 && (size_t)maxParallel * gridBytes > DM_MAX_PARTIAL_BYTES)
+		maxParallel = gridBytes < DM_MAX_PARTIAL_BYTES ? (int)(DM_MAX_PARTIAL_BYTES / gridBytes) : 1;
+
+	if(count.empty())
+		return;
+
+	clusterColor.resize(numClusters);
+	for(int j=0; j < numClusters; j++)
+		clusterColor[j] = (uint32_t)clusters[j].get_b() << 16 | (uint32_t)clusters[j].get_g() << 8 | (uint32_t)clusters[j].get_r();
+
+	memset(&count[0], 0, numPixels * sizeof(uint32_t));
+	memset(&sumR[0], 0, numPixels * sizeof(uint64_t));
+	memset(&sumG[0], 0, numPixels * sizeof(uint64_t));
+	memset(&sumB[0], 0, numPixels * sizeof(uint64_t));
+	maxCount = 0;
+
+	int numChunks = CThreadPool::chunk_count(numPoints, DM_MIN_CHUNK_POINTS, maxParallel);
+	if(numPoints / numChunks >= DM_MAX_CHUNK_POINTS)
+		numChunks = numPoints / DM_MAX_CHUNK_POINTS + 1;
+
+	const int wave = numChunks < maxParallel ? numChunks : maxParallel;
+	partial.resize(wave);
+	for(int t=0; t < wave; t++)
+		partial[t].resize(numPixels);
+
+	for(int first=0; first < numChunks; first += wave)
+	{
+		const int numTasks = numChunks - first < wave ? numChunks - first : wave;
+
+		auto bin_task = [this, &points, first, numChunks](int t)
+		{
+			const int chunk = first + t;
+			CDensityBin *bins = &partial[t][0];
+
+			memset(bins, 0, count.size() * sizeof(CDensityBin));
+			bin_chunk(points, CThreadPool::chunk_begin(points.get_count(), chunk, numChunks),
+					  CThreadPool::chunk_begin(points.get_count(), chunk + 1, numChunks), bins);
+		};
+
+		if(pool && numTasks > 1)
+			pool->run(numTasks, bin_task);
+		else
+		{
+			for(int t=0; t < numTasks; t++)
+				bin_task(t);
+		}
+
+		// Add the chunks' bins in order
+		for(int t=0; t < numTasks; t++)
+		{
+			const CDensityBin *bins = &partial[t][0];
+			for(size_t p=0; p < numPixels; p++)
+			{
+				if(!bins[p].count)
+					continue;
+
+				count[p] += bins[p].count;
+				sumR[p] += bins[p].r;
+				sumG[p] += bins[p].g;
+				sumB[p] += bins[p].b;
+			}
+		} // end FOR each chunk of the wave
+	} // end FOR each wave of chunks
+
+	for(size_t p=0; p < numPixels; p++)
+	{
+		if(count[p] > maxCount)
+			maxCount = count[p];
+	}
+
+	build_alpha();
+}
+
+// Look up the opacity of the small counts, which is where nearly every pixel falls
+void CDensityMap::build_alpha()
+{
+	const uint32_t tableSize = maxCount + 1 < DM_ALPHA_TABLE ? maxCount + 1 : DM_ALPHA_TABLE;
+	const double scale = maxCount > 1 ? (255 - DM_MIN_ALPHA) / log((double)maxCount) : 0.0;
+
+	alphaOf.resize(tableSize);
+	for(uint32_t c=1; c < tableSize; c++)
+		alphaOf[c] = (unsigned char)(DM_MIN_ALPHA + log((double)c) * scale + 0.5);
+}
+
+// Color (packed as bgr asks) and opacity of a pixel
+// Returns false if no point landed on it
+bool CDensityMap::shade(const size_t pixel, uint32_t &color, int &alpha, const bool bgr)
+{
+	const uint32_t c = count[pixel];
+	if(!c)
+		return false;
+
+	if(c < alphaOf.size())
+		alpha = alphaOf[c];
+	else
+		alpha = (int)(DM_MIN_ALPHA + log((double)c) * (255 - DM_MIN_ALPHA) / log((double)maxCount) + 0.5);
+
+	const uint32_t r = (uint32_t)((sumR[pixel] + c/2) / c);
+	const uint32_t g = (uint32_t)((sumG[pixel] + c/2) / c);
+	const uint32_t b = (uint32_t)((sumB[pixel] + c/2) / c);
+	color = bgr ? (r << 16 | g << 8 | b) : (b << 16 | g << 8 | r);
+
+	return true;
+}
+
+// Blend the map over the pixels [left, right) x [top, bottom) of an opaque frame, where
+// dst is the frame pixel under the map's top left and stride the frame's row length.
+// Channels are R, G, B, A in memory order, or B, G, R, A if bgr is set
+void CDensityMap::composite(uint32_t *dst, const int stride, const int left, const int top, const int right, const int bottom,
+							const bool bgr)
+{
+	const int x0 = left > 0 ? left : 0;
+	const int y0 = top > 0 ? top : 0;
+	const int x1 = right < width ? right : width;
+	const int y1 = bottom < height ? bottom : height;
+
+	for(int py=y0; py < y1; py++)
+	{
+		uint32_t *row = dst + (ptrdiff_t)py * stride;
+
+		for(int px=x0; px < x1; px++)
+		{
+			uint32_t color;
+			int alpha;
+			if(!shade((size_t)py * width + px, color, alpha, bgr))
+				continue;
+
+			// Red and blue blended in one multiply, green in another
+			const uint32_t a = (uint32_t)(alpha + (alpha >> 7));
+			const uint32_t inv = 256 - a;
+			const uint32_t d = row[px];
+			const uint32_t rb = (((d & 0x00FF00FF) * inv + (color & 0x00FF00FF) * a) >> 8) & 0x00FF00FF;
+			const uint32_t gg = (((d & 0x0000FF00) * inv + (color & 0x0000FF00) * a) >> 8) & 0x0000FF00;
+			row[px] = 0xFF000000u | rb | gg;
+		}
+	} // end FOR each row
+}
+
+// Write the whole map as non-premultiplied color with alpha, fully transparent where
+// no point landed, for handing to an API that does the blending
+void CDensityMap::colorize(uint32_t *dst, const int stride, const bool bgr)
+{
+	for(int py=0; py < height; py++)
+	{
+		uint32_t *row = dst + (ptrdiff_t)py * stride;
+
+		for(int px=0; px < width; px++)
+		{
+			uint32_t color;
+			int alpha;
+			row[px] = shade((size_t)py * width + px, color, alpha, bgr) ? (uint32_t)alpha << 24 | color : 0;
+		}
+	} // end FOR each row
+}
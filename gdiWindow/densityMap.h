@@ -0,0 +1,74 @@
+// densityMap.h
+// Authored by Alex Shows
+// Released under the MIT License (http://opensource.org/licenses/mit-license.php)
+//
+// Header declaring the CDensityMap class
+//
+// Level of detail for large data sets. Past a hundred thousand or so points, drawing
+// every point as translucent circles is slow and ends up as solid color anyway, so
+// instead the points are binned, in one pass, into a per pixel grid that counts the
+// points landing on each pixel and sums the colors they would be drawn in (their
+// cluster's, or their own if unassigned). The grid is then composited as a heatmap:
+// each pixel takes the mean color of its points, more opaque the more points it has
+// on a log scale. Drawing the map costs the same for any number of points
+//
+// Binning is split into chunks of points run on a thread pool, each chunk summing
+// into a grid of its own; the grids are added up in chunk order, so the map doesn't
+// depend on the threads. No more chunks run at once than have grids fitting in
+// DM_MAX_PARTIAL_BYTES, so a large map bins on fewer threads instead of taking (and
+// clearing) a full grid for every thread
+
+#pragma once
+
+#include "pointStore.h"
+#include "dataPoint.h"
+#include "threadPool.h"
+#include <stdint.h>
+#include <vector>
+using namespace std;
+
+#define DM_DEFAULT_LOD_POINTS 100000 // Renderers switch to the density map above this many points
+#define DM_MIN_CHUNK_POINTS 65536 // Chunks are never smaller than this, unless there are fewer points
+#define DM_MAX_CHUNK_POINTS (1 << 24) // Chunks are never larger, so a chunk's color sums fit 32 bits
+#define DM_MIN_ALPHA 64 // Opacity of a pixel with a single point
+#define DM_MAX_PARTIAL_BYTES (32 << 20) // Most memory the grids of the chunks run at once may take, unless one grid is larger
+
+// Points binned into one pixel by one chunk
+struct CDensityBin
+{
+	uint32_t count;
+	uint32_t r;
+	uint32_t g;
+	uint32_t b;
+};
+
+class CDensityMap
+{
+public:
+	CDensityMap();
+	~CDensityMap();
+	int resize(const int w, const int h);
+	int get_width(){ return width;};
+	int get_height(){ return height;};
+	uint32_t get_max_count(){ return maxCount;};
+	void bin(CPointStore &points, vector<CDataPoint> &clusters, CThreadPool *pool = NULL);
+	void composite(uint32_t *dst, const int stride, const int left, const int top, const int right, const int bottom, const bool bgr = false);
+	void colorize(uint32_t *dst, const int stride, const bool bgr = false);
+private:
+	// Not copyable, the grids are frame sized and reused from frame to frame
+	CDensityMap(const CDensityMap&);
+	CDensityMap& operator=(const CDensityMap&);
+	void bin_chunk(CPointStore &points, const int begin, const int end, CDensityBin *bins);
+	void build_alpha();
+	bool shade(const size_t pixel, uint32_t &color, int &alpha, const bool bgr);
+	int width; // Map width in pixels
+	int height; // Map height in pixels
+	uint32_t maxCount; // Most points binned into one pixel
+	vector<uint32_t> count; // Per pixel number of points
+	vector<uint64_t> sumR; // Per pixel sums of the colors of the points
+	vector<uint64_t> sumG;
+	vector<uint64_t> sumB;
+	vector<vector<CDensityBin> > partial; // Per chunk bins of the chunks being run
+	vector<uint32_t> clusterColor; // Colors of the clusters, which assigned points take on
+	vector<unsigned char> alphaOf; // Opacity by count, up to a cap; larger counts are computed
+};
@@ -0,0 +1,209 @@
+// dirtyGrid.cpp
+// Authored by Alex Shows
+// Released under the MIT License (http://opensource.org/licenses/mit-license.php)
+//
+// Implementation of the CDirtyGrid class
+// Tracks the cells of a retained frame that need redrawing
+
+#include "dirtyGrid.h"
+
+CDirtyGrid::CDirtyGrid(const int growth, const int size)
+{
+	pointGrowth = growth;
+	clusterSize = size;
+	width = height = columns = rows = dirtyCells = 0;
+	synced = false;
+}
+
+CDirtyGrid::~CDirtyGrid()
+{
+}
+
+// Cover a frame of w x h pixels, with every cell dirty
+void CDirtyGrid::resize(const int w, const int h)
+{
+	width = w > 0 ? w : 0;
+	height = h > 0 ? h : 0;
+	columns = (width + DG_CELL_SIZE - 1) / DG_CELL_SIZE;
+	rows = (height + DG_CELL_SIZE - 1) / DG_CELL_SIZE;
+	cells.assign((size_t)columns * rows, 0);
+	mark_all();
+}
+
+// Mark the whole frame dirty, e.g. when the points themselves have been replaced. The
+// next track() takes a fresh snapshot rather than comparing against the old one
+void CDirtyGrid::mark_all()
+{
+	cells.assign(cells.size(), 1);
+	dirtyCells = (int)cells.size();
+	synced = false;
+}
+
+// Mark the cells overlapping pixels [left, right) x [top, bottom)
+void CDirtyGrid::mark_rect(const int left, const int top, const int right, const int bottom)
+{
+	const int c0 = left > 0 ? left / DG_CELL_SIZE : 0;
+	const int r0 = top > 0 ? top / DG_CELL_SIZE : 0;
+	const int c1 = right < width ? (right + DG_CELL_SIZE - 1) / DG_CELL_SIZE : columns;
+	const int r1 = bottom < height ? (bottom + DG_CELL_SIZE - 1) / DG_CELL_SIZE : rows;
+
+	for(int r=r0; r < r1; r++)
+	{
+		for(int c=c0; c < c1; c++)
+		{
+			unsigned char &cell = cells[(size_t)r * columns + c];
+			if(!cell)
+			{
+				cell = 1;
+				dirtyCells++;
+			}
+		}
+	}
+}
+
+// Forget the marks, once the dirty cells have been redrawn
+void CDirtyGrid::clear()
+{
+	cells.assign(cells.size(), 0);
+	dirtyCells = 0;
+}
+
+// Pixels a point can draw into, with a pixel to spare on each side
+void CDirtyGrid::point_rect(const int x, const int y, const int size, const int xOffset, const int yOffset, CPixelRect &rect)
+{
+	const int boxX = x + size/2 + xOffset;
+	const int boxY = y + size/2 + yOffset;
+
+	rect.left = boxX - pointGrowth/2 - 1;
+	rect.top = boxY - pointGrowth/2 - 1;
+	rect.right = boxX + size + pointGrowth/2 + 2;
+	rect.bottom = boxY + size + pointGrowth/2 + 2;
+}
+
+// Pixels a cluster can draw into, with a pixel to spare on each side
+void CDirtyGrid::cluster_rect(CDataPoint &cluster, const int xOffset, const int yOffset, CPixelRect &rect)
+{
+	rect.left = cluster.get_x() + clusterSize/2 + xOffset - 1;
+	rect.top = cluster.get_y() + clusterSize/2 + yOffset - 1;
+	rect.right = rect.left + clusterSize + 3;
+	rect.bottom = rect.top + clusterSize + 3;
+}
+
+// Mark the cells under whatever changed since the last call, and remember the current
+// labels and clusters for the next. xOffset and yOffset place the points in the frame
+// Returns the number of dirty cells
+int CDirtyGrid::track(CPointStore &points, vector<CDataPoint> &clusters, const int xOffset, const int yOffset)
+{
+	const int numPoints = points.get_count();
+	const int numClusters = (int)clusters.size();
+	const int *x = points.get_x();
+	const int *y = points.get_y();
+	const int *label = points.get_label();
+	const unsigned char *size = points.get_size();
+	CPixelRect rect;
+
+	if(!synced || numPoints != (int)lastLabel.size() || numClusters != (int)lastClusters.size())
+		mark_all();
+	else
+	{
+		// A recolored cluster changes the color of all its points
+		vector<unsigned char> recolored(numClusters, 0);
+		bool anyRecolored = false;
+
+		for(int j=0; j < numClusters; j++)
+		{
+			CDataPoint &now = clusters[j];
+			CDataPoint &then = lastClusters[j];
+
+			if(now.get_r() != then.get_r() || now.get_g() != then.get_g() || now.get_b() != then.get_b())
+				recolored[j] = 1;
+			anyRecolored |= recolored[j] != 0;
+
+			if(recolored[j] || now.get_x() != then.get_x() || now.get_y() != then.get_y())
+			{
+				cluster_rect(then, xOffset, yOffset, rect);
+				mark_rect(rect.left, rect.top, rect.right, rect.bottom);
+				cluster_rect(now, xOffset, yOffset, rect);
+				mark_rect(rect.left, rect.top, rect.right, rect.bottom);
+			}
+		} // end FOR each cluster
+
+		for(int i=0; i < numPoints; i++)
+		{
+			const int l = label[i];
+			if(l == lastLabel[i] && !(anyRecolored && l >= 0 && l < numClusters && recolored[l]))
+				continue;
+
+			point_rect(x[i], y[i], size[i], xOffset, yOffset, rect);
+			mark_rect(rect.left, rect.top, rect.right, rect.bottom);
+		} // end FOR each data point
+	}
+
+	lastLabel.assign(label, label + numPoints);
+	lastClusters = clusters;
+	synced = true;
+
+	return dirtyCells;
+}
+
+// Whether any cell overlapping pixels [left, right) x [top, bottom) is dirty
+bool CDirtyGrid::touches(const int left, const int top, const int right, const int bottom)
+{
+	if(right <= 0 || bottom <= 0 || left >= width || top >= height)
+		return false;
+
+	const int c0 = left > 0 ? left / DG_CELL_SIZE : 0;
+	const int r0 = top > 0 ? top / DG_CELL_SIZE : 0;
+	const int c1 = right < width ? (right + DG_CELL_SIZE - 1) / DG_CELL_SIZE : columns;
+	const int r1 = bottom < height ? (bottom + DG_CELL_SIZE - 1) / DG_CELL_SIZE : rows;
+
+	for(int r=r0; r < r1; r++)
+	{
+		for(int c=c0; c < c1; c++)
+		{
+			if(cells[(size_t)r * columns + c])
+				return true;
+		}
+	}
+
+	return false;
+}
+
+// Whether a point of size at x, y draws into any dirty cell
+bool CDirtyGrid::touches_point(const int x, const int y, const int size, const int xOffset, const int yOffset)
+{
+	CPixelRect rect;
+	point_rect(x, y, size, xOffset, yOffset, rect);
+
+	return touches(rect.left, rect.top, rect.right, rect.bottom);
+}
+
+// The dirty cells as rectangles of pixels, one per run of dirty cells along a row of
+// cells. The rectangles don't overlap, so they can be redrawn in parallel
+void CDirtyGrid::get_rects(vector<CPixelRect> &rects)
+{
+	rects.clear();
+
+	for(int r=0; r < rows; r++)
+	{
+		for(int c=0; c < columns; )
+		{
+			if(!cells[(size_t)r * columns + c])
+			{
+				c++;
+				continue;
+			}
+
+			const int start = c;
+			while(c < columns && cells[(size_t)r * columns + c])
+				c++;
+
+			CPixelRect rect;
+			rect.left = start * DG_CELL_SIZE;
+			rect.top = r * DG_CELL_SIZE;
+			rect.right = c * DG_CELL_SIZE < width ? c * DG_CELL_SIZE : width;
+			rect.bottom = (r + 1) * DG_CELL_SIZE < height ? (r + 1) * DG_CELL_SIZE : height;
+			rects.push_back(rect);
+		}
+	} // end FOR each row of cells
+}
@@ -0,0 +1,64 @@
+// dirtyGrid.h
+// Authored by Alex Shows
+// Released under the MIT License (http://opensource.org/licenses/mit-license.php)
+//
+// Header declaring the CDirtyGrid class
+//
+// Tracks which parts of a retained frame need redrawing. The frame is divided into
+// square cells; track() compares the points and clusters against what was drawn
+// last time and marks the cells under every point whose label changed and every
+// cluster that moved or changed color (and under the points of a recolored cluster).
+// A renderer then restores only the dirty cells and redraws just the shapes that
+// touch them, clipped to them. Pixels are a function of the shapes covering them,
+// drawn in order, so a cell redrawn this way ends up exactly as a full redraw would
+
+#pragma once
+
+#include "pointStore.h"
+#include "dataPoint.h"
+#include <vector>
+using namespace std;
+
+#define DG_CELL_SIZE 32 // Width and height of a cell in pixels
+
+// A rectangle of pixels, right and bottom exclusive
+struct CPixelRect
+{
+	int left;
+	int top;
+	int right;
+	int bottom;
+};
+
+class CDirtyGrid
+{
+public:
+	CDirtyGrid(const int pointGrowth, const int clusterSize);
+	~CDirtyGrid();
+	void resize(const int w, const int h);
+	void mark_all();
+	void mark_rect(const int left, const int top, const int right, const int bottom);
+	void clear();
+	int track(CPointStore &points, vector<CDataPoint> &clusters, const int xOffset, const int yOffset);
+	bool is_empty(){ return dirtyCells == 0;};
+	int get_dirty_cells(){ return dirtyCells;};
+	int get_width(){ return width;};
+	int get_height(){ return height;};
+	bool touches(const int left, const int top, const int right, const int bottom);
+	bool touches_point(const int x, const int y, const int size, const int xOffset, const int yOffset);
+	void get_rects(vector<CPixelRect> &rects);
+private:
+	void point_rect(const int x, const int y, const int size, const int xOffset, const int yOffset, CPixelRect &rect);
+	void cluster_rect(CDataPoint &cluster, const int xOffset, const int yOffset, CPixelRect &rect);
+	int width; // Frame width in pixels
+	int height; // Frame height in pixels
+	int columns; // Cells across the frame
+	int rows; // Cells down the frame
+	int pointGrowth; // A point's drawing is this much wider than its size (its halo)
+	int clusterSize; // Width and height of a cluster's drawing
+	int dirtyCells; // Number of cells marked
+	bool synced; // Whether the snapshot below matches what was last drawn
+	vector<unsigned char> cells; // Per cell, non-zero if it needs redrawing, row by row
+	vector<int> lastLabel; // Labels of the points as last drawn
+	vector<CDataPoint> lastClusters; // Clusters as last drawn
+};
@@ -0,0 +1,365 @@
+// featureKMeans.cpp
+// Authored by Alex Shows
+// Released under the MIT License (http://opensource.org/licenses/mit-license.php)
+//
+// Implementation of the CFeatureKMeans class
+// K-Means Clustering of D-dimensional feature vectors
+
+#include "featureKMeans.h"
+#include "counterRng.h"
+#include "instrument.h"
+#include <math.h>
+#include <chrono>
+
+// Streams of CCounterRng used for seeding
+#define FKM_STREAM_FIRST 0 // Random seeding and the first k-means++ center, counter is the cluster
+#define FKM_STREAM_PLUSPLUS 1 // k-means++ draws, counter is the cluster
+#define FKM_SCRATCH_GAP 16 // Floats (a cache line) left between the scratch distances of neighbouring chunks
+
+CFeatureKMeans::CFeatureKMeans()
+{
+	numClusters = 0;
+	paddedClusters = 0;
+	specialized = true;
+	kernel = NULL;
+}
+
+CFeatureKMeans::~CFeatureKMeans()
+{
+}
+
+// Make numClusters clusters at the origin and unassign every row
+// Returns the number of clusters on success, -1 otherwise
+int CFeatureKMeans::create_clusters(const int clusterCount)
+{
+	if(clusterCount < 1)
+		return -1;
+
+	numClusters = clusterCount;
+	centroids.assign((size_t)numClusters * features.get_dims(), 0.0);
+	labels.assign(features.get_count(), CPS_UNASSIGNED);
+
+	return numClusters;
+}
+
+// Place the clusters at rows picked uniformly (KM_SEED_RANDOM) or by k-means++
+// (KM_SEED_PLUSPLUS). The picks are a pure function of seed, whatever the thread count
+// Returns the number of clusters placed, -1 if the method isn't supported
+int CFeatureKMeans::seed_clusters(const int method, const unsigned long long seed)
+{
+	const int numRows = features.get_count();
+	const int dims = features.get_dims();
+
+	if(method != KM_SEED_RANDOM && method != KM_SEED_PLUSPLUS)
+		return -1;
+	if(!numRows || !numClusters || centroids.size() != (size_t)numClusters * dims)
+		return 0;
+
+	KI_SCOPE("feature_seed_clusters");
+
+	if(method == KM_SEED_RANDOM)
+	{
+		for(int j=0; j < numClusters; j++)
+		{
+			const float *row = features.get_row((int)CCounterRng::below(seed, FKM_STREAM_FIRST, j, numRows));
+			for(int d=0; d < dims; d++)
+				centroids[(size_t)j * dims + d] = row[d];
+		}
+
+		return numClusters;
+	}
+
+	// k-means++: each center is a row drawn with probability proportional to its squared
+	// distance from the nearest center so far
+	const int numChunks = CThreadPool::chunk_count(numRows, KM_MIN_CHUNK_POINTS, KM_MAX_CHUNKS);
+	minDist.assign(numRows, 3.0e38f);
+	chunkCost.assign(numChunks, 0.0);
+	int pick = (int)CCounterRng::below(seed, FKM_STREAM_FIRST, 0, numRows);
+
+	for(int t=0; t < numClusters; t++)
+	{
+		const float *center = features.get_row(pick);
+		for(int d=0; d < dims; d++)
+			centroids[(size_t)t * dims + d] = center[d];
+
+		if(t + 1 == numClusters)
+			break;
+
+		threadPool.run(numChunks, [&](int chunk)
+		{
+			const int begin = CThreadPool::chunk_begin(numRows, chunk, numChunks);
+			const int end = CThreadPool::chunk_begin(numRows, chunk + 1, numChunks);
+			double cost = 0.0;
+
+			for(int i=begin; i < end; i++)
+			{
+				const float *row = features.get_row(i);
+				float dist = 0.0f;
+				for(int d=0; d < dims; d++)
+				{
+					const float diff = row[d] - center[d];
+					dist += diff * diff;
+				}
+
+				if(dist < minDist[i])
+					minDist[i] = dist;
+				cost += minDist[i];
+			}
+
+			chunkCost[chunk] = cost;
+		});
+
+		double total = 0.0;
+		for(int c=0; c < numChunks; c++)
+			total += chunkCost[c];
+
+		// Walk the chunks, then the rows of the chunk holding the draw
+		double r = CCounterRng::uniform(seed, FKM_STREAM_PLUSPLUS, t) * total;
+		int chunk = 0;
+		while(chunk < numChunks - 1 && r >= chunkCost[chunk])
+			r -= chunkCost[chunk++];
+
+		const int end = CThreadPool::chunk_begin(numRows, chunk + 1, numChunks);
+		pick = -1;
+		for(int i=CThreadPool::chunk_begin(numRows, chunk, numChunks); i < end && pick < 0; i++)
+		{
+			if(minDist[i] <= 0.0f)
+				continue;
+			if(r < minDist[i])
+				pick = i;
+			else
+				r -= minDist[i];
+		}
+
+		// Rounding left r just past the chunk, or every row sits on a center already
+		if(pick < 0)
+			pick = (int)CCounterRng::below(seed, FKM_STREAM_FIRST, t + 1, numRows);
+	} // end FOR each center
+
+	return numClusters;
+}
+
+// Transpose the centroids into the float layout the kernel reads, padding the clusters
+// to a multiple of FK_BLOCK with ones too far away to ever be the nearest
+void CFeatureKMeans::load_centroids()
+{
+	const int dims = features.get_dims();
+
+	paddedClusters = (numClusters + FK_BLOCK - 1) / FK_BLOCK * FK_BLOCK;
+	centroidT.assign((size_t)dims * paddedClusters, FK_FAR_AWAY);
+
+	for(int j=0; j < numClusters; j++)
+		for(int d=0; d < dims; d++)
+			centroidT[(size_t)d * paddedClusters + j] = (float)centroids[(size_t)j * dims + d];
+
+	kernel = feature_kernel(dims, specialized);
+}
+
+// Size and clear the per chunk partial sums for numChunks chunks, and size their
+// scratch distances
+void CFeatureKMeans::prepare_partials(const int numChunks)
+{
+	scratch.resize((size_t)numChunks * (paddedClusters + FKM_SCRATCH_GAP));
+	partialSum.assign((size_t)numChunks * numClusters * features.get_dims(), 0.0);
+	partialCount.assign((size_t)numChunks * numClusters, 0);
+	partialChanged.assign(numChunks, 0);
+	partialDist.assign(numChunks, 0.0);
+}
+
+// Label the rows of one chunk and accumulate them into the chunk's partial sums
+void CFeatureKMeans::assign_chunk(const int chunk, const int numChunks)
+{
+	const int numRows = features.get_count();
+	const int dims = features.get_dims();
+	const int begin = CThreadPool::chunk_begin(numRows, chunk, numChunks);
+	const int end = CThreadPool::chunk_begin(numRows, chunk + 1, numChunks);
+
+	KI_SCOPE("feature_assign_chunk");
+
+	partialChanged[chunk] = kernel(features.get_row(begin), end - begin, dims, &centroidT[0], paddedClusters,
+								   &labels[begin], &partialSum[(size_t)chunk * numClusters * dims],
+								   &partialCount[(size_t)chunk * numClusters], &partialDist[chunk],
+								   &scratch[(size_t)chunk * (paddedClusters + FKM_SCRATCH_GAP)]);
+}
+
+// Run one Lloyd iteration across the thread pool: assign every row to its nearest
+// centroid, then move every cluster to the mean of its rows. A cluster left without
+// rows stays where it is
+// Fills in stats, if passed, and returns the number of rows whose label changed
+int CFeatureKMeans::iterate(CIterationStats *stats)
+{
+	const int numRows = features.get_count();
+	const int dims = features.get_dims();
+	if(!numClusters || !numRows || centroids.size() != (size_t)numClusters * dims)
+		return 0;
+	if((int)labels.size() != numRows)
+		labels.assign(numRows, CPS_UNASSIGNED);
+
+	KI_SCOPE("feature_iterate");
+
+	chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+
+	load_centroids();
+
+	const int numChunks = CThreadPool::chunk_count(numRows, KM_MIN_CHUNK_POINTS, KM_MAX_CHUNKS);
+	prepare_partials(numChunks);
+	threadPool.run(numChunks, [this, numChunks](int chunk){ assign_chunk(chunk, numChunks); });
+
+	chrono::high_resolution_clock::time_point assigned = chrono::high_resolution_clock::now();
+
+	// Reduce the partials in chunk order and move the clusters
+	double maxShift = 0.0;
+	int emptyClusters = 0;
+	for(int j=0; j < numClusters; j++)
+	{
+		long long pointCount = 0;
+		for(int c=0; c < numChunks; c++)
+			pointCount += partialCount[(size_t)c * numClusters + j];
+
+		if(!pointCount)
+		{
+			emptyClusters++;
+			continue;
+		}
+
+		double shift = 0.0;
+		for(int d=0; d < dims; d++)
+		{
+			double sum = 0.0;
+			for(int c=0; c < numChunks; c++)
+				sum += partialSum[((size_t)c * numClusters + j) * dims + d];
+
+			double &centroid = centroids[(size_t)j * dims + d];
+			const double mean = sum / (double)pointCount;
+			shift += (mean - centroid) * (mean - centroid);
+			centroid = mean;
+		}
+
+		shift = sqrt(shift);
+		if(shift > maxShift)
+			maxShift = shift;
+	} // end FOR each cluster
+
+	int changed = 0;
+	double inertia = 0.0;
+	for(int c=0; c < numChunks; c++)
+	{
+		changed += partialChanged[c];
+		inertia += partialDist[c];
+	}
+
+	// Every row reads its features and reads and writes its label
+	KI_COUNT("feature_iterate.distances", (long long)numRows * numClusters);
+	KI_COUNT("feature_iterate.reassigned", changed);
+	KI_COUNT("feature_iterate.empty_clusters", emptyClusters);
+	KI_COUNT("feature_iterate.bytes", (long long)numRows * (dims * sizeof(float) + sizeof(int)));
+
+	if(stats)
+	{
+		chrono::high_resolution_clock::time_point updated = chrono::high_resolution_clock::now();
+
+		stats->labelChanges = changed;
+		stats->inertia = inertia;
+		stats->centroidShift = maxShift;
+		stats->distanceEvals = (long long)numRows * numClusters;
+		stats->pruneRate = 0.0;
+		stats->assignMs = chrono::duration<double, milli>(assigned - start).count();
+		stats->updateMs = chrono::duration<double, milli>(updated - assigned).count();
+	}
+
+	return changed;
+}
+
+// Iterate until no label changes, no cluster moves further than tolerance, or maxIterations
+// have run, whichever comes first
+// Appends one entry per iteration to stats, if passed, and returns the number of iterations run
+int CFeatureKMeans::run_until_converged(const int maxIterations, const double tolerance, vector<CIterationStats> *stats)
+{
+	int iter = 0;
+
+	while(iter < maxIterations)
+	{
+		CIterationStats iterStats;
+		iterStats.iteration = iter;
+
+		int changed = iterate(&iterStats);
+		iter++;
+
+		if(stats)
+			stats->push_back(iterStats);
+
+		if(!changed || iterStats.centroidShift <= tolerance)
+			break;
+	} // end WHILE not converged
+
+	return iter;
+}
+
+// Project the rows and clusters onto dimensions dimX and dimY, scaled to fill the plot,
+// as points labelled like the rows and clusters in distinct colors
+// Returns the number of points on success, -1 otherwise
+int CFeatureKMeans::project(CPointStore &points, vector<CDataPoint> &clusters, const int dimX, const int dimY)
+{
+	const int numRows = features.get_count();
+	const int dims = features.get_dims();
+
+	if(dimX < 0 || dimX >= dims || dimY < 0 || dimY >= dims)
+		return -1;
+
+	points.clear();
+	if(points.resize(numRows) != numRows)
+		return -1;
+
+	float lowX = 0.0f, highX = 0.0f, lowY = 0.0f, highY = 0.0f;
+	for(int i=0; i < numRows; i++)
+	{
+		const float *row = features.get_row(i);
+		if(!i || row[dimX] < lowX) lowX = row[dimX];
+		if(!i || row[dimX] > highX) highX = row[dimX];
+		if(!i || row[dimY] < lowY) lowY = row[dimY];
+		if(!i || row[dimY] > highY) highY = row[dimY];
+	}
+
+	const double scaleX = highX > lowX ? (CDP_X_UPPER_BOUND - 1) / (double)(highX - lowX) : 0.0;
+	const double scaleY = highY > lowY ? (CDP_Y_UPPER_BOUND - 1) / (double)(highY - lowY) : 0.0;
+
+	int *x = points.get_x();
+	int *y = points.get_y();
+	int *label = points.get_label();
+	unsigned char *size = points.get_size();
+	unsigned char *r = points.get_r();
+	unsigned char *g = points.get_g();
+	unsigned char *b = points.get_b();
+
+	for(int i=0; i < numRows; i++)
+	{
+		const float *row = features.get_row(i);
+		x[i] = (int)((row[dimX] - lowX) * scaleX + 0.5);
+		y[i] = (int)((row[dimY] - lowY) * scaleY + 0.5);
+		label[i] = i < (int)labels.size() ? labels[i] : CPS_UNASSIGNED;
+		size[i] = 3;
+		r[i] = g[i] = b[i] = 128;
+	} // end FOR each row
+
+	// Red, green, blue and yellow first like CKMeans, then colors drawn from the cluster number
+	static const int firstColors[4][3] = { { 255, 0, 0 }, { 0, 150, 0 }, { 0, 0, 255 }, { 200, 200, 0 } };
+	clusters.clear();
+	for(int j=0; j < numClusters; j++)
+	{
+		const double *centroid = get_centroid(j);
+		const int cx = (int)((centroid[dimX] - lowX) * scaleX + 0.5);
+		const int cy = (int)((centroid[dimY] - lowY) * scaleY + 0.5);
+
+		if(j < 4)
+			clusters.push_back(CDataPoint(cx, cy, 10, firstColors[j][0], firstColors[j][1], firstColors[j][2]));
+		else
+		{
+			clusters.push_back(CDataPoint(cx, cy, 10,
+										  (int)CCounterRng::below(j, 0, 0, CDP_COLOR_UPPER_BOUND - 100),
+										  (int)CCounterRng::below(j, 0, 1, CDP_COLOR_UPPER_BOUND - 100),
+										  (int)CCounterRng::below(j, 0, 2, CDP_COLOR_UPPER_BOUND - 100)));
+		}
+	} // end FOR each cluster
+
+	return numRows;
+}
@@ -0,0 +1,71 @@
+// featureKMeans.h
+// Authored by Alex Shows
+// Released under the MIT License (http://opensource.org/licenses/mit-license.php)
+//
+// Header declaring the CFeatureKMeans class
+//
+// K-Means Clustering (Lloyd's Algorithm) of D-dimensional feature vectors. The
+// counterpart of CKMeans for data with more than an x and a y: the points are rows
+// of a CFeatureMatrix, the centroids are kept in double, and each iteration is one
+// chunked, threaded pass of the feature_assign<D>() kernel with the partial sums
+// reduced in chunk order, so results don't depend on the number of threads. The
+// kernel is specialized at compile time for 2, 3, 4, 8 and 16 dimensions
+//
+// project() maps two of the dimensions onto a CPointStore and clusters, so the
+// rasterizer can draw the result as a 2D projection (kmeans_cli -d with -r). The
+// window doesn't show feature data yet: its worker and snapshots are built around a
+// CKMeans, and still cluster only 2D points
+
+#pragma once
+
+#include "kMeans.h"
+#include "featureMatrix.h"
+#include "featureKernel.h"
+#include <vector>
+using namespace std;
+
+class CFeatureKMeans
+{
+public:
+	CFeatureKMeans();
+	~CFeatureKMeans();
+	CFeatureMatrix& get_features(){ return features;};
+	int create_clusters(const int numClusters);
+	int seed_clusters(const int method, const unsigned long long seed);
+	int iterate(CIterationStats *stats = NULL);
+	int run_until_converged(const int maxIterations = KM_DEFAULT_MAX_ITERATIONS,
+							const double tolerance = KM_DEFAULT_TOLERANCE,
+							vector<CIterationStats> *stats = NULL);
+	int project(CPointStore &points, vector<CDataPoint> &clusters, const int dimX = 0, const int dimY = 1);
+	void set_specialized(const bool useSpecialized){ specialized = useSpecialized;};
+	bool get_specialized(){ return specialized;};
+	int set_thread_count(const int numThreads = 0){ return threadPool.set_thread_count(numThreads);};
+	int get_thread_count(){ return threadPool.get_thread_count();};
+	int get_dims(){ return features.get_dims();};
+	int get_num_clusters(){ return numClusters;};
+	double* get_centroid(const int idx){ return &centroids[(size_t)idx * features.get_dims()];};
+	int* get_labels(){ return labels.empty() ? NULL : &labels[0];};
+private:
+	// Not copyable, the thread pool is owned
+	CFeatureKMeans(const CFeatureKMeans&);
+	CFeatureKMeans& operator=(const CFeatureKMeans&);
+	void load_centroids();
+	void prepare_partials(const int numChunks);
+	void assign_chunk(const int chunk, const int numChunks);
+	CFeatureMatrix features; // Points to cluster, one row each
+	int numClusters; // Number of clusters
+	vector<double> centroids; // numClusters x dims cluster positions, row by row
+	vector<float> centroidT; // Cluster positions transposed and padded for the kernel
+	int paddedClusters; // numClusters rounded up to a multiple of FK_BLOCK
+	vector<int> labels; // Per row, the cluster it is assigned to
+	bool specialized; // Whether the compile time specializations of the kernel are used
+	FeatureAssignFn kernel; // Kernel of the current pass
+	CThreadPool threadPool; // Workers for iterate() and seeding, single threaded by default
+	vector<double> partialSum; // Per chunk, per cluster sum of every feature
+	vector<long long> partialCount; // Per chunk, per cluster number of points
+	vector<int> partialChanged; // Per chunk number of labels changed
+	vector<double> partialDist; // Per chunk sum of squared distances to the assigned clusters
+	vector<float> scratch; // Per chunk distances from a row to every cluster, for the kernel
+	vector<float> minDist; // Per row squared distance to the nearest center so far, for k-means++
+	vector<double> chunkCost; // Per chunk sum of minDist, for k-means++
+};
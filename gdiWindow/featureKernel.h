@@ -0,0 +1,130 @@
+// featureKernel.h
+// Authored by Alex Shows
+// Released under the MIT License (http://opensource.org/licenses/mit-license.php)
+//
+// Header declaring and implementing the D-dimensional nearest-centroid kernel
+//
+// feature_assign<D>() labels rows of D features with their nearest centroid and
+// accumulates them into per-cluster sums, like CAssignKernel does for 2D points. The
+// centroids are transposed (dimension by dimension) and padded to a multiple of
+// FK_BLOCK clusters, so the loop over the clusters vectorizes with one cluster per
+// lane. D is a template parameter for the common small sizes: the loop over the
+// dimensions then unrolls into straight line code inside the vectorized loop, where
+// with a runtime D (D = 0) it stays a loop of its own, around three times slower at
+// small D. feature_kernel() picks the specialization for a dimensionality, falling
+// back to the runtime one
+
+#pragma once
+
+#include <math.h>
+
+#define FK_BLOCK 8 // The clusters are padded to a multiple of this many
+#define FK_FAR_AWAY HUGE_VALF // Coordinate of the padding clusters: infinitely far from any row, so never the nearest
+
+// Labels count rows (stride dims) against the centroids transposed in centroidT (dims
+// rows of paddedClusters, the padding at FK_FAR_AWAY), and adds each row into sum
+// (one row of dims per cluster), pointCount and sumDist. scratch holds paddedClusters
+// distances
+// Returns the number of labels that changed
+typedef int (*FeatureAssignFn)(const float *rows, const int count, const int dims,
+							   const float *centroidT, const int paddedClusters,
+							   int *label, double *sum, long long *pointCount, double *sumDist, float *scratch);
+
+template <int D>
+int feature_assign(const float *rows, const int count, const int runtimeDims,
+				   const float *centroidT, const int paddedClusters,
+				   int *label, double *sum, long long *pointCount, double *sumDist, float * __restrict scratch)
+{
+	const int dims = D ? D : runtimeDims;
+	int changed = 0;
+	double dist = 0.0;
+
+	for(int i=0; i < count; i++)
+	{
+		const float *row = rows + (size_t)i * dims;
+
+		// With D known the point is copied where the compiler can see it won't change,
+		// the loop over the dimensions unrolls away, and the loop over the clusters
+		// vectorizes, each lane computing one cluster's whole distance
+		float local[D ? D : 1];
+		const float *point = row;
+		if(D)
+		{
+			for(int d=0; d < D; d++)
+				local[d] = row[d];
+			point = local;
+		}
+
+		for(int k=0; k < paddedClusters; k++)
+		{
+			float acc = 0.0f;
+			for(int d=0; d < dims; d++)
+			{
+				const float t = point[d] - centroidT[(size_t)d * paddedClusters + k];
+				acc += t * t;
+			}
+			scratch[k] = acc;
+		} // end FOR each cluster
+
+		// FK_BLOCK running minimums side by side, so they don't wait on each other; the
+		// first cluster at the smallest distance wins ties. A padding cluster is at an
+		// infinite distance, which a real cluster (however far) can at worst tie, so the
+		// winner is always a real cluster
+		float lane[FK_BLOCK];
+		for(int j=0; j < FK_BLOCK; j++)
+			lane[j] = scratch[j];
+		for(int k=FK_BLOCK; k < paddedClusters; k += FK_BLOCK)
+		{
+			for(int j=0; j < FK_BLOCK; j++)
+				lane[j] = scratch[k + j] < lane[j] ? scratch[k + j] : lane[j];
+		}
+
+		float nearest = lane[0];
+		for(int j=1; j < FK_BLOCK; j++)
+			nearest = lane[j] < nearest ? lane[j] : nearest;
+
+		// A NaN feature (written through CFeatureMatrix::get_row(), as loading rejects
+		// them) matches no distance, so the search stops at the padding and takes cluster 0
+		int best = 0;
+		while(best < paddedClusters && scratch[best] != nearest)
+			best++;
+		if(best == paddedClusters)
+			best = 0;
+
+		if(label[i] != best)
+		{
+			label[i] = best;
+			changed++;
+		}
+
+		double *clusterSum = sum + (size_t)best * dims;
+		for(int d=0; d < dims; d++)
+			clusterSum[d] += row[d];
+		pointCount[best]++;
+		dist += nearest;
+	} // end FOR each row
+
+	*sumDist += dist;
+
+	return changed;
+}
+
+// The kernel for rows of dims features: a compile time specialization for 2, 3, 4, 8
+// and 16 dimensions, the runtime one otherwise or if specialized is false
+inline FeatureAssignFn feature_kernel(const int dims, const bool specialized = true)
+{
+	if(specialized)
+	{
+		switch(dims)
+		{
+		case 2: return feature_assign<2>;
+		case 3: return feature_assign<3>;
+		case 4: return feature_assign<4>;
+		case 8: return feature_assign<8>;
+		case 16: return feature_assign<16>;
+		default: break;
+		}
+	}
+
+	return feature_assign<0>;
+}
@@ -0,0 +1,125 @@
+// featureMatrix.cpp
+// Authored by Alex Shows
+// Released under the MIT License (http://opensource.org/licenses/mit-license.php)
+//
+// Implementation of the CFeatureMatrix class
+// A row-major matrix of D-dimensional feature vectors
+
+#include "featureMatrix.h"
+#include "counterRng.h"
+#include <string.h>
+#include <math.h>
+
+// Streams of CCounterRng used by generate()
+#define FM_STREAM_CENTER 0 // Blob centers, counter is blob * dims + dimension
+#define FM_STREAM_BLOB 1 // Blob of each row, counter is the row
+#define FM_STREAM_NOISE 2 // Offsets from the blob center, counter is row * dims + dimension
+
+CFeatureMatrix::CFeatureMatrix()
+{
+	count = 0;
+	dims = 0;
+}
+
+CFeatureMatrix::~CFeatureMatrix()
+{
+}
+
+// Size the matrix to numRows rows of numDims features; the features are left zeroed
+// Returns the number of rows on success, -1 otherwise
+int CFeatureMatrix::resize(const int numRows, const int numDims)
+{
+	if(numRows < 0 || numDims < 1)
+		return -1;
+
+	data.assign((size_t)numRows * numDims, 0.0f);
+	count = numRows;
+	dims = numDims;
+
+	return count;
+}
+
+// Whether none of the count features at values is NaN or infinite
+static bool all_finite(const float *values, const size_t count)
+{
+	for(size_t i=0; i < count; i++)
+	{
+		if(!isfinite(values[i]))
+			return false;
+	}
+
+	return true;
+}
+
+// Copy numRows rows of numDims features, stored row after row
+// Returns the number of rows on success, -1 otherwise (including for a NaN or infinite
+// feature, which no centroid can be nearest to)
+int CFeatureMatrix::load_rows(const float *rows, const int numRows, const int numDims)
+{
+	if(!rows || numRows < 0 || numDims < 1 || !all_finite(rows, (size_t)numRows * numDims))
+		return -1;
+	if(resize(numRows, numDims) < 0)
+		return -1;
+
+	if(count)
+		memcpy(&data[0], rows, sizeof(float) * data.size());
+
+	return count;
+}
+
+// Gather numRows rows from numDims columns, columns[d] holding feature d of every row
+// Returns the number of rows on success, -1 otherwise (including for a NaN or infinite
+// feature)
+int CFeatureMatrix::load_columns(const float * const *columns, const int numRows, const int numDims)
+{
+	if(!columns || numRows < 0 || numDims < 1)
+		return -1;
+
+	for(int d=0; d < numDims; d++)
+	{
+		if(!columns[d] || !all_finite(columns[d], numRows))
+			return -1;
+	}
+
+	if(resize(numRows, numDims) < 0)
+		return -1;
+
+	for(int i=0; i < count; i++)
+	{
+		float *row = get_row(i);
+		for(int d=0; d < dims; d++)
+			row[d] = columns[d][i];
+	} // end FOR each row
+
+	return count;
+}
+
+// Fill numRows rows of numDims features with numBlobs Gaussian blobs, each row drawn from
+// a blob picked at random. Every number is a pure function of the seed and its position
+// Returns the number of rows on success, -1 otherwise
+int CFeatureMatrix::generate(const int numRows, const int numDims, const int numBlobs, const unsigned long long seed)
+{
+	if(numBlobs < 1 || resize(numRows, numDims) < 0)
+		return -1;
+
+	vector<double> centers((size_t)numBlobs * dims);
+	for(size_t c=0; c < centers.size(); c++)
+		centers[c] = CCounterRng::uniform(seed, FM_STREAM_CENTER, c) * FM_RANGE;
+
+	for(int i=0; i < count; i++)
+	{
+		const double *center = &centers[CCounterRng::below(seed, FM_STREAM_BLOB, i, numBlobs) * dims];
+		float *row = get_row(i);
+
+		// Box-Muller, one normal per dimension from two uniforms
+		for(int d=0; d < dims; d++)
+		{
+			const unsigned long long counter = ((unsigned long long)i * dims + d) * 2;
+			const double u = 1.0 - CCounterRng::uniform(seed, FM_STREAM_NOISE, counter);
+			const double v = CCounterRng::uniform(seed, FM_STREAM_NOISE, counter + 1);
+			row[d] = (float)(center[d] + FM_BLOB_SPREAD * sqrt(-2.0 * log(u)) * cos(6.283185307179586 * v));
+		}
+	} // end FOR each row
+
+	return count;
+}
@@ -0,0 +1,41 @@
+// featureMatrix.h
+// Authored by Alex Shows
+// Released under the MIT License (http://opensource.org/licenses/mit-license.php)
+//
+// Header declaring the CFeatureMatrix class
+//
+// A dense matrix of D-dimensional feature vectors, one row per observation, stored
+// row-major in float so a point's features are contiguous for the assignment kernel.
+// Rows can be copied in from row-major data or gathered from one column per feature,
+// or generated as Gaussian blobs for tests and benchmarks
+
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+using namespace std;
+
+#define FM_RANGE 1000.0 // Blob centers are drawn uniformly from [0, FM_RANGE) in every dimension
+#define FM_BLOB_SPREAD 40.0 // Standard deviation of a blob in every dimension
+
+class CFeatureMatrix
+{
+public:
+	CFeatureMatrix();
+	~CFeatureMatrix();
+	int resize(const int numRows, const int numDims);
+	int load_rows(const float *rows, const int numRows, const int numDims);
+	int load_columns(const float * const *columns, const int numRows, const int numDims);
+	int generate(const int numRows, const int numDims, const int numBlobs, const unsigned long long seed);
+	int get_count(){ return count;};
+	int get_dims(){ return dims;};
+	float* get_row(const int idx){ return &data[(size_t)idx * dims];};
+	float* get_data(){ return data.empty() ? NULL : &data[0];};
+private:
+	// Not copyable, so a matrix of millions of rows is never copied by accident
+	CFeatureMatrix(const CFeatureMatrix&);
+	CFeatureMatrix& operator=(const CFeatureMatrix&);
+	int count; // Number of rows
+	int dims; // Features per row
+	vector<float> data; // count x dims features, row by row
+};
@@ -7,50 +7,118 @@
 // and provides its own window procedure to respond to window messages
 
 #include "gdiWindow.h"
+#include "instrument.h"
 
-CGDIWindow::CGDIWindow()
+// Regenerate the data set, seeding the engine from the clock so each
+// regeneration produces a different set of points. The clusters start
+// at points picked by k-means++
+static void generate_data(CKMeans &engine)
 {
-	initialize_data();
-	assign_data();
+	engine.set_seed((unsigned int)time(NULL));
+	engine.set_seeding(KM_SEED_PLUSPLUS);
+	engine.initialize_data(MAX_DATAPOINTS, MAX_CLUSTERS);
 }
 
-CGDIWindow::CGDIWindow(const int w, const int h)
+CGDIWindow::CGDIWindow() : worker(kMeans), dirtyGrid(GW_HALO_GROWTH, GW_CLUSTER_SIZE)
 {
+	drawnGeneration = 0;
+	drawnSequence = 0;
+	snapshotPosted = false;
+	frameMs = 0.0;
+	iterationsPerSec = 0.0;
+	rateGeneration = 0;
+	rateIterations = 0;
+	backDC = staticDC = NULL;
+	backBitmap = staticBitmap = NULL;
+	oldBackBitmap = oldStaticBitmap = NULL;
+	gridSynced = false;
+	gridMargin = 0;
+	hoverPoint = PG_NO_POINT;
+	lassoActive = false;
+	generate_data(kMeans);
+	kMeans.assign_data();
+}
+
+CGDIWindow::CGDIWindow(const int w, const int h) : worker(kMeans), dirtyGrid(GW_HALO_GROWTH, GW_CLUSTER_SIZE)
+{
+	drawnGeneration = 0;
+	drawnSequence = 0;
+	snapshotPosted = false;
+	frameMs = 0.0;
+	iterationsPerSec = 0.0;
+	rateGeneration = 0;
+	rateIterations = 0;
+	backDC = staticDC = NULL;
+	backBitmap = staticBitmap = NULL;
+	oldBackBitmap = oldStaticBitmap = NULL;
+	gridSynced = false;
+	gridMargin = 0;
+	hoverPoint = PG_NO_POINT;
+	lassoActive = false;
 	appName = "GDI Window";
 	hWnd = NULL;
 	width = w;
 	height = h;
-	initialize_data();
-	assign_data();
+	generate_data(kMeans);
+	kMeans.assign_data();
 }
 
-CGDIWindow::CGDIWindow(string name, const int w, const int h)
+CGDIWindow::CGDIWindow(string name, const int w, const int h) : worker(kMeans), dirtyGrid(GW_HALO_GROWTH, GW_CLUSTER_SIZE)
 {
+	drawnGeneration = 0;
+	drawnSequence = 0;
+	snapshotPosted = false;
+	frameMs = 0.0;
+	iterationsPerSec = 0.0;
+	rateGeneration = 0;
+	rateIterations = 0;
+	backDC = staticDC = NULL;
+	backBitmap = staticBitmap = NULL;
+	oldBackBitmap = oldStaticBitmap = NULL;
+	gridSynced = false;
+	gridMargin = 0;
+	hoverPoint = PG_NO_POINT;
+	lassoActive = false;
 	appName = name;
 	hWnd = NULL;
 	width = w;
 	height = h;
-	initialize_data();
-	assign_data();
+	generate_data(kMeans);
+	kMeans.assign_data();
 }
 
 CGDIWindow::~CGDIWindow(void)
 {
 	// Where's the best place for this? Here or after the parent's message_loop returns?
 //	GdiplusShutdown(gdiplusToken); 
+	release_buffers();
 }
 
 void CGDIWindow::create_window()
 {
 	GdiplusStartup(&gdiplusToken, &gdiplusStartupInput, NULL);
 
+	// Let the clustering engine and the density map use every core
+	kMeans.set_thread_count(0);
+	renderPool.set_thread_count(0);
+
 	CSimpleWindow::create_window();
+
+	// From here on the engine belongs to the worker thread, which asks for a repaint
+	// whenever it has a new snapshot. Only one request is left in the queue at a time,
+	// however fast the snapshots come
+	worker.start([this]{
+		if(!snapshotPosted.exchange(true))
+			PostMessage(hWnd, GW_WM_SNAPSHOT, 0, 0);
+	});
 }
 
 void CGDIWindow::message_loop()
 {
 	CSimpleWindow::message_loop();
 
+	worker.stop();
+
 	GdiplusShutdown(gdiplusToken);
 }
 
@@ -63,24 +131,49 @@ LRESULT CALLBACK CGDIWindow::windowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPA
 	{
 	case WM_PAINT:
 		hdc = BeginPaint(hWnd, &ps);
-		update_window(hdc);
+		update_window(hdc, ps.rcPaint);
 		EndPaint(hWnd, &ps);
 		break;
+	case WM_SIZE:
+		// The buffers are recreated at the new client size on the next paint
+		if(LOWORD(lParam) > 0 && HIWORD(lParam) > 0)
+		{
+			width = LOWORD(lParam);
+			height = HIWORD(lParam);
+			release_buffers();
+		}
+		break;
 	case WM_ERASEBKGND:
 		break;
 	case WM_KEYDOWN:
 		handle_key((const char)wParam);
         break;
 	case WM_LBUTTONDOWN:
-		assign_data();
-		compute_centroids();
-		InvalidateRect(hWnd, NULL, NULL);
+		// Dragging with shift held draws a lasso around the points to select
+		if(wParam & MK_SHIFT)
+			handle_mouse(uMsg, (short)LOWORD(lParam), (short)HIWORD(lParam));
+		else
+			worker.post_iterate();
+		break;
+	case WM_MOUSEMOVE:
+	case WM_LBUTTONUP:
+		handle_mouse(uMsg, (short)LOWORD(lParam), (short)HIWORD(lParam));
 		break;
 	case WM_RBUTTONDOWN:
 		initialize_data();
 		//assign_data();
 		//compute_centroids();
-		InvalidateRect(hWnd, NULL, NULL);
+		break;
+	case GW_WM_SNAPSHOT:
+		// In auto-run the frame timer paces the repaints instead
+		snapshotPosted = false;
+		if(!worker.get_auto_run())
+			InvalidateRect(hWnd, NULL, NULL);
+		break;
+	case WM_TIMER:
+		// Repaint at most once a tick, and only if there's something new to show
+		if(wParam == GW_FRAME_TIMER && worker.get_published() != drawnSequence)
+			InvalidateRect(hWnd, NULL, NULL);
 		break;
 	case WM_CREATE:
 		break;
@@ -94,333 +187,497 @@ LRESULT CALLBACK CGDIWindow::windowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPA
 	return 0;
 }
 
-void CGDIWindow::update_window(HDC hdc)
+// Bring the back buffer up to date and copy the area being painted to the window
+// The scene is drawn from the latest snapshot the worker published, never from
+// the engine itself. The back buffer survives between paints: only the cells the
+// dirty grid finds changed (points that changed labels, clusters that moved) are
+// restored from the static layer and redrawn, clipped to those cells
+void CGDIWindow::update_window(HDC hdc, const RECT &paintRect)
 {
-	if(vPoints.size() < 1)
-		return;
+	KI_SCOPE("update_window");
 
-	// Create a memory device context and compatible bitmap to draw into
-	HDC originalHDC = hdc;
-	hdc = CreateCompatibleDC(originalHDC);
-	HBITMAP hBitmap = CreateCompatibleBitmap(originalHDC, width, height);
-	SelectObject(hdc, hBitmap);
+	chrono::high_resolution_clock::time_point frameStart = chrono::high_resolution_clock::now();
 
-	Graphics graphics(hdc);
+	worker.acquire();
 
-	// Offset within the main window where the cluster of points go
-	int insetOffsetX = 50; // in pixels
-	int insetOffsetY = 50; // in pixels
-	int insetXbounds = vPoints[0].get_x_bounds() + 6; // 6 is padding for size
-	int insetYbounds = vPoints[0].get_y_bounds() + 6; // 6 is padding for size
+	CClusterSnapshot &snapshot = worker.get_snapshot();
+	CPointStore &points = snapshot.points;
+	vector<CDataPoint> &vClusters = snapshot.clusters;
 
-	// Background fill
-	SolidBrush bgFill(Color(255,255,255,255));
-	graphics.FillRectangle(&bgFill, 0, 0, width, height);
+	if(points.get_count() < 1)
+		return;
 
-	// Inset fill 
-	SolidBrush insetFill(Color(255,240,240,240));
-	graphics.FillRectangle(&insetFill, insetOffsetX, insetOffsetY, insetXbounds, insetYbounds);
+	if(!backDC && create_buffers(hdc))
+		return;
 
-	// Outline the inset region
-	Pen insetOutline(Color(255,0,0,0));
-	graphics.DrawRectangle(&insetOutline, insetOffsetX, insetOffsetY, insetXbounds, insetYbounds);
-	
-	// Heading
-	SolidBrush  brush(Color(255, 0, 0, 255));
-	FontFamily  fontFamily(L"Lucida Sans");
-	Font        font(&fontFamily, 24, FontStyleRegular, UnitPixel);
-	PointF      pointF(50.0f, 10.0f);
-	graphics.DrawString(L"K-Means Cluster Analysis", -1, &font, pointF, &brush);
+	drawnSequence = snapshot.sequence + 1;
 
-	// Draw each data point
-	for (vector<CDataPoint>::iterator it = vPoints.begin() ; it != vPoints.end(); ++it)
+	// The points of a new data set are all new, so the whole frame has to be redrawn
+	if(snapshot.generation != drawnGeneration)
 	{
-		CDataPoint &dataPoint = *it;
-		draw_point(hdc, &dataPoint, insetOffsetX, insetOffsetY);
+		dirtyGrid.mark_all();
+		drawnGeneration = snapshot.generation;
+
+		// Nor does the point grid, or anything found in it, apply any longer
+		gridSynced = false;
+		hoverPoint = PG_NO_POINT;
+		selection.clear();
 	}
 
-	// Draw each cluster center
-	for (vector<CDataPoint>::iterator cIt = vClusters.begin() ; cIt != vClusters.end(); ++cIt)
+	if(dirtyGrid.track(points, vClusters, GW_INSET_X, GW_INSET_Y))
 	{
-		CDataPoint &dataPoint = *cIt;
-		draw_cluster(hdc, &dataPoint, insetOffsetX, insetOffsetY);
+		vector<CPixelRect> rects;
+		dirtyGrid.get_rects(rects);
+
+		// Restore the background, inset and heading under the dirty cells, and clip to them
+		Region clip;
+		clip.MakeEmpty();
+		for(size_t r=0; r < rects.size(); r++)
+		{
+			const CPixelRect &rect = rects[r];
+			const int w = rect.right - rect.left;
+			const int h = rect.bottom - rect.top;
+
+			BitBlt(backDC, rect.left, rect.top, w, h, staticDC, rect.left, rect.top, SRCCOPY);
+			clip.Union(Rect(rect.left, rect.top, w, h));
+		}
+
+		Graphics graphics(backDC);
+		graphics.SetClip(&clip);
+
+		// Draw the data points a color at a time, or as a heatmap if there are too many
+		// to make out one by one, then the cluster centers
+		if(points.get_count() > DM_DEFAULT_LOD_POINTS)
+			draw_density(graphics, points, vClusters, GW_INSET_X, GW_INSET_Y);
+		else
+		{
+			batch.build(points, (int)vClusters.size());
+			mark_candidates(snapshot, rects, GW_INSET_X, GW_INSET_Y);
+			draw_points(graphics, points, vClusters, GW_INSET_X, GW_INSET_Y);
+		}
+		draw_clusters(graphics, vClusters, GW_INSET_X, GW_INSET_Y);
+
+		dirtyGrid.clear();
 	}
 
-	// Copy from the memory DC to the original
-	BitBlt(originalHDC, 0, 0, width, height, hdc, 0, 0, SRCCOPY); 
+	draw_overlay(snapshot);
+	draw_status(snapshot);
+
+	// Copy the area being painted from the back buffer to the window
+	BitBlt(hdc, paintRect.left, paintRect.top, paintRect.right - paintRect.left, paintRect.bottom - paintRect.top,
+		   backDC, paintRect.left, paintRect.top, SRCCOPY);
+
+	if(lassoActive)
+		draw_lasso(hdc);
 
-	// Clean up
-	DeleteObject(hBitmap);
-	DeleteDC(hdc);
-	ReleaseDC(hWnd, hdc);
+	frameMs = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - frameStart).count();
 }
 
-void CGDIWindow::initialize_data()
+// Draw the iteration count, iteration rate (in auto-run) and the time the last frame
+// took next to the heading, over the static layer
+void CGDIWindow::draw_overlay(CClusterSnapshot &snapshot)
 {
-	vPoints.clear();
-
-	srand((unsigned int)time(NULL));
+	const bool autoRun = worker.get_auto_run();
+	chrono::high_resolution_clock::time_point now = chrono::high_resolution_clock::now();
 
-	for(int i=0; i < MAX_DATAPOINTS; i++)
+	// The iteration rate is measured over at least GW_RATE_MS, and starts over with new data
+	if(snapshot.generation != rateGeneration || snapshot.iterations < rateIterations)
 	{
-		int modulo = i%4;
-		// Artificial steering of clusters
-		switch(modulo)
-		{
-		case 0:
-			// Upper left quadrant
-			vPoints.push_back(CDataPoint(rand()%CDP_X_UPPER_BOUND/6 + 20, 
-										rand()%CDP_Y_UPPER_BOUND/6 + 20,
-										3,
-										rand()%CDP_COLOR_UPPER_BOUND,
-										rand()%CDP_COLOR_UPPER_BOUND,
-										rand()%CDP_COLOR_UPPER_BOUND));
-			break;
-		case 1:
-			// Upper right quadrant
-			vPoints.push_back(CDataPoint(rand()%CDP_X_UPPER_BOUND/6 + 300, 
-										rand()%CDP_Y_UPPER_BOUND/6 + 20,
-										3,
-										rand()%CDP_COLOR_UPPER_BOUND,
-										rand()%CDP_COLOR_UPPER_BOUND,
-										rand()%CDP_COLOR_UPPER_BOUND));
-			break;
-		case 2:
-			// Lower left quadrant
-			vPoints.push_back(CDataPoint(rand()%CDP_X_UPPER_BOUND/6 + 20, 
-										rand()%CDP_Y_UPPER_BOUND/6 + 300,
-										3,
-										rand()%CDP_COLOR_UPPER_BOUND,
-										rand()%CDP_COLOR_UPPER_BOUND,
-										rand()%CDP_COLOR_UPPER_BOUND));
-			break;
-		case 3:
-			// Lower right quadrant
-			vPoints.push_back(CDataPoint(rand()%CDP_X_UPPER_BOUND/6 + 300, 
-										rand()%CDP_Y_UPPER_BOUND/6 + 300,
-										3,
-										rand()%CDP_COLOR_UPPER_BOUND,
-										rand()%CDP_COLOR_UPPER_BOUND,
-										rand()%CDP_COLOR_UPPER_BOUND));
-			break;
-		default:
-			vPoints.push_back(CDataPoint(rand()%CDP_X_UPPER_BOUND, 
-										rand()%CDP_Y_UPPER_BOUND,
-										3, /*rand()%6,*/
-										rand()%CDP_COLOR_UPPER_BOUND,
-										rand()%CDP_COLOR_UPPER_BOUND,
-										rand()%CDP_COLOR_UPPER_BOUND));
-			break;
-		} // end case
-	} // end for each data point
-
-	vClusters.clear();
-
-	for(int j=0; j < MAX_CLUSTERS; j++)
+		rateGeneration = snapshot.generation;
+		rateIterations = snapshot.iterations;
+		rateStart = now;
+		iterationsPerSec = 0.0;
+	}
+	else
 	{
-		// Use RGBY for the first 4 colors
-		if(j<4)
+		const double elapsedMs = chrono::duration<double, milli>(now - rateStart).count();
+		if(elapsedMs >= GW_RATE_MS)
 		{
-			int redVal, greenVal, blueVal;
-			redVal = greenVal = blueVal = 0;
+			iterationsPerSec = (snapshot.iterations - rateIterations) * 1000.0 / elapsedMs;
+			rateIterations = snapshot.iterations;
+			rateStart = now;
+		}
+	}
 
-			switch(j)
-			{
-			case 0:
-				redVal = 255;
-				break;
-			case 1:
-				greenVal = 150;
-				break;
-			case 2:
-				blueVal = 255;
-				break;
-			case 3: // Yellow
-				redVal = 200;
-				greenVal = 200;
-				break;
-			default:
-				// Should never arrive here
-				break;
-			}
-
-			vClusters.push_back(CDataPoint(rand()%CDP_X_UPPER_BOUND,
-										   rand()%CDP_Y_UPPER_BOUND,
-										   10, // No need to randomize, this is overriden elsewhere
-										   redVal,
-										   greenVal,
-										   blueVal));
-		} // end if j<4
-		else // else j >= 4, so generate a random color
-		{
-			// Load a randomized data point into the vector
-			vClusters.push_back(CDataPoint(rand()%CDP_X_UPPER_BOUND, 
-										rand()%CDP_Y_UPPER_BOUND,
-										10, // No need to randomize, this is overridden elsewhere
-										rand()%(CDP_COLOR_UPPER_BOUND-100),
-										rand()%(CDP_COLOR_UPPER_BOUND-100),
-										rand()%(CDP_COLOR_UPPER_BOUND-100)));
-		} // end else
-	} // end for each cluster
+	wchar_t text[128];
+	if(autoRun)
+		swprintf(text, 128, L"iteration %d   %.0f it/s   %.1f ms/frame%s", snapshot.iterations, iterationsPerSec, frameMs,
+				 snapshot.converged ? L"   converged" : L"");
+	else
+		swprintf(text, 128, L"iteration %d   %.1f ms/frame%s", snapshot.iterations, frameMs,
+				 snapshot.converged ? L"   converged" : L"");
+
+	BitBlt(backDC, GW_OVERLAY_X, GW_OVERLAY_Y, GW_OVERLAY_WIDTH, GW_OVERLAY_HEIGHT, staticDC, GW_OVERLAY_X, GW_OVERLAY_Y, SRCCOPY);
+
+	Graphics graphics(backDC);
+	SolidBrush  brush(Color(255, 64, 64, 64));
+	FontFamily  fontFamily(L"Lucida Sans");
+	Font        font(&fontFamily, 12, FontStyleRegular, UnitPixel);
+	PointF      pointF((REAL)GW_OVERLAY_X, (REAL)GW_OVERLAY_Y);
+	graphics.DrawString(text, -1, &font, pointF, &brush);
 }
 
-// Draw a single data point, which is a circle filled with a transparent color
-// based on the data in the CDataPoint passed
-void CGDIWindow::draw_point(HDC hdc, CDataPoint* pDP, const int xOffset, const int yOffset)
+// Describe the point under the cursor and the points the last lasso selected, right
+// of the inset, over the static layer
+void CGDIWindow::draw_status(CClusterSnapshot &snapshot)
 {
-	Graphics gfx(hdc);
+	CPointStore &points = snapshot.points;
+	wchar_t text[256];
+	int length = 0;
 
-	Pen pen(Color(pDP->get_r(), 
-				pDP->get_g(), 
-				pDP->get_b()));
-	
-	// Ellipse with same width/height so a circle of the color of the pen
-	gfx.DrawEllipse(&pen, (const int)(pDP->get_x() + (pDP->get_size()/2) + xOffset),
-						(const int)(pDP->get_y() + (pDP->get_size()/2) + yOffset),
-						(const int)(pDP->get_size()), 
-						(const int)(pDP->get_size()));
-
-	// 50% transparent but otherwise the same color
-	SolidBrush solidBrush(Color(50, pDP->get_r(),
-									pDP->get_g(),
-									pDP->get_b()));
-
-	// Fill the same region with the 50% transparent color
-	gfx.FillEllipse(&solidBrush, (const int)(pDP->get_x() + (pDP->get_size()/2) + xOffset),
-						(const int)(pDP->get_y() + (pDP->get_size()/2) + yOffset),
-						(const int)(pDP->get_size()), 
-						(const int)(pDP->get_size()));
-
-	solidBrush.SetColor(Color(30, pDP->get_r(),
-								  pDP->get_g(),
-								  pDP->get_b()));
-
-	// Fill in an outer region with a lower transparency version on the same color
-	gfx.FillEllipse(&solidBrush, (const int)(pDP->get_x() + (pDP->get_size()/2) -10 + xOffset),
-								 (const int)(pDP->get_y() + (pDP->get_size()/2) -10 + yOffset),
-								 (const int)(pDP->get_size() + 20),
-								 (const int)(pDP->get_size() + 20));
+	text[0] = 0;
+	if(hoverPoint != PG_NO_POINT && hoverPoint < points.get_count())
+	{
+		const int label = points.get_label()[hoverPoint];
+
+		length += swprintf(text, 256, L"point %d at %d, %d\n", hoverPoint, points.get_x()[hoverPoint], points.get_y()[hoverPoint]);
+		if(label == CPS_UNASSIGNED)
+			length += swprintf(text + length, 256 - length, L"unassigned\n");
+		else
+			length += swprintf(text + length, 256 - length, L"cluster %d\n", label);
+	}
+	if(!selection.empty())
+		swprintf(text + length, 256 - length, L"%d points selected", (int)selection.size());
+
+	BitBlt(backDC, GW_STATUS_X, GW_STATUS_Y, GW_STATUS_WIDTH, GW_STATUS_HEIGHT, staticDC, GW_STATUS_X, GW_STATUS_Y, SRCCOPY);
+
+	if(!text[0])
+		return;
+
+	Graphics graphics(backDC);
+	SolidBrush  brush(Color(255, 64, 64, 64));
+	FontFamily  fontFamily(L"Lucida Sans");
+	Font        font(&fontFamily, 12, FontStyleRegular, UnitPixel);
+	RectF       layout((REAL)GW_STATUS_X, (REAL)GW_STATUS_Y, (REAL)GW_STATUS_WIDTH, (REAL)GW_STATUS_HEIGHT);
+	graphics.DrawString(text, -1, &font, layout, NULL, &brush);
 }
 
-// Draw a single cluster, which is a sqaure filled with a transparent color
-// based on the data in the CDataPoint passed
-// The size parameter isn't used - rather the size of the rectangles are hard coded within
-void CGDIWindow::draw_cluster(HDC hdc, CDataPoint* pDP, const int xOffset, const int yOffset)
+// Outline the lasso being drawn straight onto the window, over the copy of the back
+// buffer, so the next paint leaves no trace of it
+void CGDIWindow::draw_lasso(HDC hdc)
 {
-	int clusterSize = 10;
+	if(lassoX.size() < 2)
+		return;
 
-	Graphics gfx(hdc);
+	vector<Point> vertices(lassoX.size());
+	for(size_t v=0; v < vertices.size(); v++)
+		vertices[v] = Point(lassoX[v] + GW_INSET_X, lassoY[v] + GW_INSET_Y);
 
-	Pen pen(Color(pDP->get_r(), 
-				  pDP->get_g(), 
-				  pDP->get_b()));
-	
-	// Rectangle marker
-	gfx.DrawRectangle(&pen, (const int)(pDP->get_x() + (clusterSize/2) + xOffset),
-						    (const int)(pDP->get_y() + (clusterSize/2) + yOffset),
-						    clusterSize, 
-						    clusterSize);
-
-	// 80% transparent but otherwise the same color
-	SolidBrush solidBrush(Color(80, pDP->get_r(),
-									pDP->get_g(),
-									pDP->get_b()));
-
-	// Fill the same region with the transparent color
-	gfx.FillRectangle(&solidBrush, (const int)(pDP->get_x() + (clusterSize/2) + xOffset),
-								   (const int)(pDP->get_y() + (clusterSize/2) + yOffset),
-								   clusterSize, 
-								   clusterSize);
+	Graphics graphics(hdc);
+	Pen pen(Color(255, 64, 64, 64));
+	pen.SetDashStyle(DashStyleDash);
+	graphics.DrawPolygon(&pen, &vertices[0], (INT)vertices.size());
 }
 
-// Assign each data point to the closest cluster and color code accordingly
-void CGDIWindow::assign_data()
+// Index the snapshot's points in the point grid, unless it already holds them. The
+// positions only change with the data set, so the labels changing from one snapshot
+// to the next needs nothing done
+void CGDIWindow::sync_grid(CClusterSnapshot &snapshot)
 {
-	// For each data point, measure the distance to each cluster and color the data point 
-	// according to the closest cluster
-	for(vector<CDataPoint>::iterator it = vPoints.begin(); it != vPoints.end(); ++it)
+	CPointStore &points = snapshot.points;
+
+	if(gridSynced && pointGrid.get_count() == points.get_count())
+		return;
+
+	pointGrid.build(points);
+
+	const unsigned char *size = points.get_size();
+	int maxSize = 0;
+	for(int i=0; i < points.get_count(); i++)
+		maxSize = size[i] > maxSize ? size[i] : maxSize;
+
+	// A point draws from size/2 - GW_HALO_GROWTH/2 to 3*size/2 + GW_HALO_GROWTH/2 past its
+	// position (see CDirtyGrid::point_rect()), plus a pixel or two to spare
+	gridMargin = maxSize * 3 / 2 + GW_HALO_GROWTH / 2 + 3;
+	gridSynced = true;
+}
+
+// Mark the points that could draw into the dirty rects, found through the point grid,
+// so draw_points() only has to test those rather than every point against the dirty grid
+void CGDIWindow::mark_candidates(CClusterSnapshot &snapshot, vector<CPixelRect> &rects, const int xOffset, const int yOffset)
+{
+	sync_grid(snapshot);
+	pointCandidate.assign(snapshot.points.get_count(), 0);
+
+	for(size_t r=0; r < rects.size(); r++)
 	{
-		float lastDistance = CDP_X_UPPER_BOUND + CDP_Y_UPPER_BOUND;
+		const CPixelRect &rect = rects[r];
 
-		for(vector<CDataPoint>::iterator cIt = vClusters.begin(); cIt != vClusters.end(); ++cIt)
+		pointGrid.query_rect(rect.left - xOffset - gridMargin, rect.top - yOffset - gridMargin,
+							 rect.right - xOffset + gridMargin, rect.bottom - yOffset + gridMargin, cellFound);
+		for(size_t f=0; f < cellFound.size(); f++)
+			pointCandidate[cellFound[f]] = 1;
+	} // end FOR each dirty rect
+}
+
+// Handle the mouse moving and the left button going down (with shift) or up; x and y
+// are in client pixels. Outside a lasso, the point nearest the cursor is looked up
+// in the point grid for draw_status() to describe. Shift and the left button start a
+// lasso, each move adds a vertex to it, and letting go selects the points inside it
+void CGDIWindow::handle_mouse(const UINT uMsg, const int x, const int y)
+{
+	CClusterSnapshot &snapshot = worker.get_snapshot();
+	const int insetX = x - GW_INSET_X;
+	const int insetY = y - GW_INSET_Y;
+
+	if(uMsg == WM_LBUTTONDOWN)
+	{
+		lassoActive = true;
+		lassoX.assign(1, insetX);
+		lassoY.assign(1, insetY);
+		SetCapture(hWnd);
+	}
+	else if(uMsg == WM_MOUSEMOVE && lassoActive)
+	{
+		if(insetX != lassoX.back() || insetY != lassoY.back())
 		{
-			float X2minusX1 = (float)(it->get_x() - (float)(cIt->get_x())); 
-			float Y2minusY1 = (float)(it->get_y() - (float)(cIt->get_y()));
+			lassoX.push_back(insetX);
+			lassoY.push_back(insetY);
+			InvalidateRect(hWnd, NULL, NULL);
+		}
+	}
+	else if(uMsg == WM_MOUSEMOVE)
+	{
+		if(snapshot.points.get_count() < 1)
+			return;
 
-			float squaredXdiff = X2minusX1*X2minusX1;
-			float squaredYdiff = Y2minusY1*Y2minusY1;
-		
-			float distance = sqrt(squaredXdiff + squaredYdiff);
+		sync_grid(snapshot);
 
-			// If this cluster is closer than the last, assign and color code to this cluster
-			if(distance < lastDistance)
-			{
-				lastDistance = distance;
-				it->set_r(cIt->get_r());
-				it->set_b(cIt->get_b());
-				it->set_g(cIt->get_g());
-				it->set_clusterIndex(cIt - vClusters.begin());
-			}
-		} // end FOR each cluster 
-	} // end FOR each data point
+		const int found = pointGrid.nearest(insetX, insetY, GW_HOVER_RADIUS);
+		if(found != hoverPoint)
+		{
+			hoverPoint = found;
+			InvalidateRect(hWnd, NULL, NULL);
+		}
+	}
+	else if(uMsg == WM_LBUTTONUP && lassoActive)
+	{
+		lassoActive = false;
+		ReleaseCapture();
+
+		sync_grid(snapshot);
+		if(pointGrid.query_polygon(&lassoX[0], &lassoY[0], (int)lassoX.size(), selection) < 0)
+			selection.clear();
+		InvalidateRect(hWnd, NULL, NULL);
+	}
 }
 
-// Update each cluster's position by computing the centroid of all data points associated with the cluster
-void CGDIWindow::compute_centroids()
+// Create the back buffer and the static layer, a bitmap of the parts of the scene
+// that never change (background, inset and heading), compatible with hdc
+// Returns 0 on success, -1 otherwise
+int CGDIWindow::create_buffers(HDC hdc)
 {
-	// For each cluster...
-	for(vector<CDataPoint>::iterator cIt = vClusters.begin(); cIt != vClusters.end(); ++cIt)
+	backDC = CreateCompatibleDC(hdc);
+	backBitmap = CreateCompatibleBitmap(hdc, width, height);
+	staticDC = CreateCompatibleDC(hdc);
+	staticBitmap = CreateCompatibleBitmap(hdc, width, height);
+
+	if(!backDC || !backBitmap || !staticDC || !staticBitmap)
 	{
-		int xAccum = 0; // x position accumulator
-		int yAccum = 0; // y position accumulator
-		int dpCount = 0; // how many data points 
-		int currentClusterIndex = cIt - vClusters.begin();
+		release_buffers();
+		return -1;
+	}
+
+	oldBackBitmap = SelectObject(backDC, backBitmap);
+	oldStaticBitmap = SelectObject(staticDC, staticBitmap);
+
+	Graphics graphics(staticDC);
+
+	int insetXbounds = CDP_X_UPPER_BOUND + 6; // 6 is padding for size
+	int insetYbounds = CDP_Y_UPPER_BOUND + 6; // 6 is padding for size
+
+	// Background fill
+	SolidBrush bgFill(Color(255,255,255,255));
+	graphics.FillRectangle(&bgFill, 0, 0, width, height);
+
+	// Inset fill 
+	SolidBrush insetFill(Color(255,240,240,240));
+	graphics.FillRectangle(&insetFill, GW_INSET_X, GW_INSET_Y, insetXbounds, insetYbounds);
 
-		// For each data point...
-		for(vector<CDataPoint>::iterator it = vPoints.begin(); it != vPoints.end(); ++it)
+	// Outline the inset region
+	Pen insetOutline(Color(255,0,0,0));
+	graphics.DrawRectangle(&insetOutline, GW_INSET_X, GW_INSET_Y, insetXbounds, insetYbounds);
+	
+	// Heading
+	SolidBrush  brush(Color(255, 0, 0, 255));
+	FontFamily  fontFamily(L"Lucida Sans");
+	Font        font(&fontFamily, 24, FontStyleRegular, UnitPixel);
+	PointF      pointF(50.0f, 10.0f);
+	graphics.DrawString(L"K-Means Cluster Analysis", -1, &font, pointF, &brush);
+
+	// Everything has to be drawn onto the new buffer
+	dirtyGrid.resize(width, height);
+
+	return 0;
+}
+
+// Release the back buffer and static layer, e.g. when the window changes size
+void CGDIWindow::release_buffers()
+{
+	if(backDC)
+	{
+		if(oldBackBitmap)
+			SelectObject(backDC, oldBackBitmap);
+		DeleteDC(backDC);
+	}
+	if(staticDC)
+	{
+		if(oldStaticBitmap)
+			SelectObject(staticDC, oldStaticBitmap);
+		DeleteDC(staticDC);
+	}
+	if(backBitmap)
+		DeleteObject(backBitmap);
+	if(staticBitmap)
+		DeleteObject(staticBitmap);
+
+	backDC = staticDC = NULL;
+	backBitmap = staticBitmap = NULL;
+	oldBackBitmap = oldStaticBitmap = NULL;
+}
+
+// Have the worker regenerate the data set
+void CGDIWindow::initialize_data()
+{
+	worker.post(generate_data, true);
+}
+
+// Draw every data point, each a circle outlined in its color and filled with
+// transparent versions of it. The points come grouped by color from the batch,
+// so one pen and two brushes serve the whole frame: they're set to a group's color
+// once, the group's outlines are submitted as a single path, then its fills
+// Only the points touching a dirty cell are drawn, and only the candidates
+// mark_candidates() found near one are tested
+// A point assigned to a cluster takes the color of that cluster
+void CGDIWindow::draw_points(Graphics &graphics, CPointStore &points, vector<CDataPoint> &vClusters, const int xOffset, const int yOffset)
+{
+	const int *x = batch.get_x();
+	const int *y = batch.get_y();
+	const unsigned char *size = batch.get_size();
+	const int *index = batch.get_index();
+	const unsigned char *r = points.get_r();
+	const unsigned char *g = points.get_g();
+	const unsigned char *b = points.get_b();
+
+	Pen pen(Color(0, 0, 0));
+	SolidBrush fillBrush(Color(50, 0, 0, 0));
+	SolidBrush haloBrush(Color(30, 0, 0, 0));
+	GraphicsPath outlines;
+	vector<int> visible;
+
+	for(int group=0; group < batch.get_num_groups(); group++)
+	{
+		const int begin = batch.group_begin(group);
+		const int end = batch.group_end(group);
+
+		if(begin == end)
+			continue;
+
+		// Unassigned points keep their own colors, so they can't share a path
+		if(group == PB_UNASSIGNED_GROUP)
 		{
-			if(it->get_clusterIndex() == currentClusterIndex)
+			for(int k=begin; k < end; k++)
 			{
-				xAccum += it->get_x();
-				yAccum += it->get_y();
-				dpCount++;
-			}
+				const int i = index[k];
+				const int s = size[k];
+				const int boxX = x[k] + s/2 + xOffset;
+				const int boxY = y[k] + s/2 + yOffset;
+
+				if(!pointCandidate[i] || !dirtyGrid.touches_point(x[k], y[k], s, xOffset, yOffset))
+					continue;
+
+				pen.SetColor(Color(r[i], g[i], b[i]));
+				fillBrush.SetColor(Color(50, r[i], g[i], b[i]));
+				haloBrush.SetColor(Color(30, r[i], g[i], b[i]));
+				graphics.DrawEllipse(&pen, boxX, boxY, s, s);
+				graphics.FillEllipse(&fillBrush, boxX, boxY, s, s);
+				graphics.FillEllipse(&haloBrush, boxX - GW_HALO_GROWTH/2, boxY - GW_HALO_GROWTH/2, s + GW_HALO_GROWTH, s + GW_HALO_GROWTH);
+			} // end FOR each unassigned point
+			continue;
+		}
 
-		} // end FOR each data point
+		CDataPoint &cluster = vClusters[CPointBatch::group_cluster(group)];
+		pen.SetColor(Color(cluster.get_r(), cluster.get_g(), cluster.get_b()));
+		fillBrush.SetColor(Color(50, cluster.get_r(), cluster.get_g(), cluster.get_b()));
+		haloBrush.SetColor(Color(30, cluster.get_r(), cluster.get_g(), cluster.get_b()));
 
-		// If there are no data points in this cluster, something went wrong, 
-		// so move the cluster center to the center of the x and y range
-		if(!dpCount)
+		visible.clear();
+		for(int k=begin; k < end; k++)
 		{
-			cIt->set_x(CDP_X_UPPER_BOUND/2);
-			cIt->set_y(CDP_Y_UPPER_BOUND/2);
+			if(pointCandidate[index[k]] && dirtyGrid.touches_point(x[k], y[k], size[k], xOffset, yOffset))
+				visible.push_back(k);
 		}
-		else
-		{
-			// Once through all data points, compute the centroid as the mean of x and y
-			float xMean = (float) xAccum / (float) dpCount;
-			if((xMean - (int)xMean) > 0.5f)
-				xMean++;
 
-			float yMean = (float) yAccum / (float) dpCount;
-			if((yMean - (int)yMean) > 0.5f)
-				yMean++;
+		if(visible.empty())
+			continue;
 
-			cIt->set_x((const int)xMean);
-			cIt->set_y((const int)yMean);
+		// Outlines are opaque, so the group's circles can be stroked as one path
+		outlines.Reset();
+		for(size_t v=0; v < visible.size(); v++)
+		{
+			const int k = visible[v];
+			const int s = size[k];
+			outlines.AddEllipse(x[k] + s/2 + xOffset, y[k] + s/2 + yOffset, s, s);
 		}
-	} // end for each cluster
+		graphics.DrawPath(&pen, &outlines);
+
+		// Fills are blended one by one so overlapping points still build up color
+		for(size_t v=0; v < visible.size(); v++)
+		{
+			const int k = visible[v];
+			const int s = size[k];
+			const int boxX = x[k] + s/2 + xOffset;
+			const int boxY = y[k] + s/2 + yOffset;
+
+			graphics.FillEllipse(&fillBrush, boxX, boxY, s, s);
+			graphics.FillEllipse(&haloBrush, boxX - GW_HALO_GROWTH/2, boxY - GW_HALO_GROWTH/2, s + GW_HALO_GROWTH, s + GW_HALO_GROWTH);
+		} // end FOR each visible point of the group
+	} // end FOR each group
 }
 
-// Without touching the data sets, or the colors of the clusters, randomize
-// the positions of the clusters
-void CGDIWindow::randomize_cluster_positions()
+// Draw the data points as a density heatmap over the inset: the points are binned
+// per pixel on the render pool, and the map is colored into an image with alpha
+// which GDI+ blends over the inset in one call
+void CGDIWindow::draw_density(Graphics &graphics, CPointStore &points, vector<CDataPoint> &vClusters, const int xOffset, const int yOffset)
 {
-	for(vector<CDataPoint>::iterator cIt = vClusters.begin(); cIt != vClusters.end(); ++cIt)
+	if(!density.get_width())
 	{
-		cIt->set_x(rand()%CDP_X_UPPER_BOUND);
-		cIt->set_y(rand()%CDP_Y_UPPER_BOUND);
-	} // end FOR each cluster
+		density.resize(CDP_X_UPPER_BOUND + 6, CDP_Y_UPPER_BOUND + 6); // 6 is padding for size
+		densityPixels.resize((size_t)density.get_width() * density.get_height());
+	}
+
+	const int w = density.get_width();
+	const int h = density.get_height();
+
+	density.bin(points, vClusters, &renderPool);
+	density.colorize(&densityPixels[0], w, true);
+
+	Bitmap image(w, h, w * 4, PixelFormat32bppARGB, (BYTE*)&densityPixels[0]);
+	graphics.DrawImage(&image, Rect(xOffset, yOffset, w, h), 0, 0, w, h, UnitPixel);
+}
+
+// Draw every cluster center, each a square outlined in its color and filled with
+// a transparent version of it, reusing one pen and brush
+void CGDIWindow::draw_clusters(Graphics &graphics, vector<CDataPoint> &vClusters, const int xOffset, const int yOffset)
+{
+	const int clusterSize = GW_CLUSTER_SIZE;
+
+	Pen pen(Color(0, 0, 0));
+	SolidBrush solidBrush(Color(80, 0, 0, 0));
+
+	for (vector<CDataPoint>::iterator cIt = vClusters.begin() ; cIt != vClusters.end(); ++cIt)
+	{
+		CDataPoint &dataPoint = *cIt;
+		const int boxX = dataPoint.get_x() + (clusterSize/2) + xOffset;
+		const int boxY = dataPoint.get_y() + (clusterSize/2) + yOffset;
+
+		pen.SetColor(Color(dataPoint.get_r(), dataPoint.get_g(), dataPoint.get_b()));
+		solidBrush.SetColor(Color(80, dataPoint.get_r(), dataPoint.get_g(), dataPoint.get_b()));
+
+		// Rectangle marker, filled with the 80 alpha color
+		graphics.DrawRectangle(&pen, boxX, boxY, clusterSize, clusterSize);
+		graphics.FillRectangle(&solidBrush, boxX, boxY, clusterSize, clusterSize);
+	}
 }
 
 // Handle a key passed from the WM_KEYDOWN message handler
@@ -429,20 +686,30 @@ void CGDIWindow::handle_key(const char key)
 	switch(key)
 	{
 	case 0x52: // r
-		randomize_cluster_positions();
-		//InvalidateRect(hWnd, NULL, NULL);
+		worker.post([](CKMeans &engine){ engine.seed_clusters(); });
 		break;
 	case 0x43: // c
-		compute_centroids();
-		//InvalidateRect(hWnd, NULL, NULL);
+		worker.post([](CKMeans &engine){ engine.compute_centroids(); });
 		break;
 	case 0x41: // a
-		assign_data();
-		//InvalidateRect(hWnd, NULL, NULL);
+		worker.post([](CKMeans &engine){ engine.assign_data(); });
 		break;
 	case 0x49: // i
 		initialize_data();
-		//InvalidateRect(hWnd, NULL, NULL);
+		break;
+	case 0x47: // g
+		// Toggle auto-run, repainting on a timer at up to GW_MAX_FPS while it's on
+		if(worker.get_auto_run())
+		{
+			worker.set_auto_run(false);
+			KillTimer(hWnd, GW_FRAME_TIMER);
+			InvalidateRect(hWnd, NULL, NULL);
+		}
+		else
+		{
+			worker.set_auto_run(true);
+			SetTimer(hWnd, GW_FRAME_TIMER, 1000 / GW_MAX_FPS, NULL);
+		}
 		break;
 	case 0x20: // space bar
 		InvalidateRect(hWnd, NULL, NULL);
@@ -11,12 +11,37 @@
 
 #define MAX_DATAPOINTS 100
 #define MAX_CLUSTERS 4
+#define GW_INSET_X 50 // Offset within the window of the inset holding the points, in pixels
+#define GW_INSET_Y 50
+#define GW_HALO_GROWTH 20 // A point's halo is this much wider than the point
+#define GW_CLUSTER_SIZE 10 // Width and height of a cluster square
+#define GW_WM_SNAPSHOT (WM_APP + 1) // Posted by the worker when it publishes a snapshot
+#define GW_FRAME_TIMER 1 // Timer pacing the repaints in auto-run
+#define GW_MAX_FPS 60 // Most repaints a second in auto-run
+#define GW_RATE_MS 500 // Shortest time the iteration rate is measured over
+#define GW_OVERLAY_X 380 // Area next to the heading holding the overlay, in pixels
+#define GW_OVERLAY_Y 18
+#define GW_OVERLAY_WIDTH 400
+#define GW_OVERLAY_HEIGHT 20
+#define GW_STATUS_X 570 // Area right of the inset describing the point under the cursor and the selection
+#define GW_STATUS_Y 50
+#define GW_STATUS_WIDTH 220
+#define GW_STATUS_HEIGHT 80
+#define GW_HOVER_RADIUS 12 // Furthest the cursor can be from a point and still be over it, in pixels
 
 #include "simpleWindow.h"
 #include "dataPoint.h"
+#include "kMeans.h"
+#include "kMeansWorker.h"
+#include "pointBatch.h"
+#include "dirtyGrid.h"
+#include "densityMap.h"
+#include "pointGrid.h"
 #include <vector>
 #include <time.h>
 #include <sstream>
+#include <atomic>
+#include <chrono>
 
 #include <objidl.h>
 #include <gdiplus.h>
@@ -32,18 +57,53 @@ public:
 	~CGDIWindow(void);
 	void create_window();
 	void message_loop();
-	void update_window(HDC hdc);
-	void draw_point(HDC hdc, CDataPoint* pDP, const int xOffset = 0, const int yOffset = 0);
-	void draw_cluster(HDC hdc, CDataPoint* pDP, const int xOffset = 0, const int yOffset = 0);
+	void update_window(HDC hdc, const RECT &paintRect);
+	void draw_points(Graphics &graphics, CPointStore &points, vector<CDataPoint> &vClusters, const int xOffset = 0, const int yOffset = 0);
+	void draw_density(Graphics &graphics, CPointStore &points, vector<CDataPoint> &vClusters, const int xOffset = 0, const int yOffset = 0);
+	void draw_clusters(Graphics &graphics, vector<CDataPoint> &vClusters, const int xOffset = 0, const int yOffset = 0);
 private:
 	GdiplusStartupInput gdiplusStartupInput;
 	ULONG_PTR gdiplusToken;
-	vector<CDataPoint> vPoints;
-	vector<CDataPoint> vClusters;
+	CKMeans kMeans; // Clustering engine which owns the data points and cluster centers
+	CKMeansWorker worker; // Runs the engine off the UI thread and publishes snapshots of it
+	unsigned int drawnGeneration; // Data set the back buffer was drawn from
+	unsigned int drawnSequence; // Snapshots published up to the one last drawn
+	atomic<bool> snapshotPosted; // Whether a GW_WM_SNAPSHOT is waiting in the queue
+	double frameMs; // Time the last repaint took
+	double iterationsPerSec; // Iteration rate over the last GW_RATE_MS or so
+	unsigned int rateGeneration; // Data set the iteration rate is being measured on
+	int rateIterations; // Iteration count at rateStart
+	chrono::high_resolution_clock::time_point rateStart; // Start of the iteration rate measurement
+	CPointBatch batch; // Data points of the frame being drawn, grouped by color
+	CDirtyGrid dirtyGrid; // Cells of the back buffer that need redrawing
+	CDensityMap density; // Data points binned per pixel, when there are too many to draw one by one
+	vector<uint32_t> densityPixels; // The density map colored for drawing, B, G, R, A in memory order
+	CThreadPool renderPool; // Workers for binning the density map
+	CPointGrid pointGrid; // Spatial index over the snapshot's points, for hit-testing and culling
+	bool gridSynced; // Whether pointGrid matches the data set of the snapshot
+	int gridMargin; // Furthest a point draws from its position, in pixels
+	vector<unsigned char> pointCandidate; // Per point, non-zero if it's near a dirty cell
+	vector<int> cellFound; // Points found by the last grid query
+	int hoverPoint; // Point under the cursor, or PG_NO_POINT
+	bool lassoActive; // Whether a lasso is being drawn
+	vector<int> lassoX; // Vertices of the lasso, in inset coordinates
+	vector<int> lassoY;
+	vector<int> selection; // Points inside the last lasso
+	HDC backDC; // Memory DC holding the back buffer, kept between paints
+	HBITMAP backBitmap; // Back buffer, the size of the client area
+	HGDIOBJ oldBackBitmap; // Bitmap the back buffer replaced in backDC
+	HDC staticDC; // Memory DC holding the static layer
+	HBITMAP staticBitmap; // Background, inset and heading, drawn once per buffer size
+	HGDIOBJ oldStaticBitmap; // Bitmap the static layer replaced in staticDC
 	LRESULT CALLBACK windowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
 	void initialize_data();
-	void assign_data();
-	void compute_centroids();
-	void randomize_cluster_positions();
 	void handle_key(const char key = 0);
+	int create_buffers(HDC hdc);
+	void release_buffers();
+	void draw_overlay(CClusterSnapshot &snapshot);
+	void draw_status(CClusterSnapshot &snapshot);
+	void draw_lasso(HDC hdc);
+	void sync_grid(CClusterSnapshot &snapshot);
+	void mark_candidates(CClusterSnapshot &snapshot, vector<CPixelRect> &rects, const int xOffset, const int yOffset);
+	void handle_mouse(const UINT uMsg, const int x, const int y);
 };
\ No newline at end of file
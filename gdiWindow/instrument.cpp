@@ -0,0 +1,203 @@
+// instrument.cpp
+// Authored by Alex Shows
+// Released under the MIT License (http://opensource.org/licenses/mit-license.php)
+//
+// Defines the CInstrument class, the recording behind the KI_ macros
+
+#include "instrument.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+CInstrument::CInstrument()
+{
+	recording = false;
+	dropped = false;
+	epoch = chrono::steady_clock::now();
+
+	// A trace can be asked for without changing the program
+	const char *path = getenv(KI_TRACE_ENV);
+	if(compiled_in() && path && *path)
+		start(path);
+}
+
+CInstrument::~CInstrument()
+{
+	stop();
+}
+
+// The recording shared by the whole process
+CInstrument& CInstrument::instance()
+{
+	static CInstrument instrument;
+	return instrument;
+}
+
+// Whether the KI_ macros were built in, i.e. whether anything will be recorded
+bool CInstrument::compiled_in()
+{
+#ifdef KMEANS_INSTRUMENT
+	return true;
+#else
+	return false;
+#endif
+}
+
+// Start recording from scratch; path, if passed, names the trace file stop() writes
+void CInstrument::start(const char *path)
+{
+	lock_guard<mutex> guard(lock);
+
+	events.clear();
+	totals.clear();
+	dropped = false;
+	tracePath = path ? path : "";
+	epoch = chrono::steady_clock::now();
+	recording = true;
+}
+
+// Stop recording, and write the trace file named to start(), if any
+// Returns 0 on success, -1 if the trace couldn't be written
+int CInstrument::stop()
+{
+	string path;
+	{
+		lock_guard<mutex> guard(lock);
+		if(!recording)
+			return 0;
+		recording = false;
+		path.swap(tracePath);
+	}
+
+	return path.empty() ? 0 : write_trace(path.c_str());
+}
+
+// Number the calling thread, in the order the threads were first seen
+// The lock must be held
+int CInstrument::thread_number()
+{
+	map<thread::id, int>::iterator it = threadNumbers.find(this_thread::get_id());
+	if(it != threadNumbers.end())
+		return it->second;
+
+	const int number = (int)threadNumbers.size() + 1;
+	threadNumbers[this_thread::get_id()] = number;
+
+	return number;
+}
+
+// Keep a span of the calling thread running from startNs to endNs
+void CInstrument::record_span(const char *name, const long long startNs, const long long endNs)
+{
+	lock_guard<mutex> guard(lock);
+	if(!recording)
+		return;
+
+	if(events.size() >= KI_MAX_EVENTS)
+	{
+		dropped = true;
+		return;
+	}
+
+	CTraceEvent event;
+	event.name = name;
+	event.phase = 'X';
+	event.thread = thread_number();
+	event.start = startNs;
+	event.duration = endNs - startNs;
+	event.value = 0;
+	events.push_back(event);
+}
+
+// Add value to the counter called name
+void CInstrument::add_counter(const char *name, const long long value)
+{
+	const long long now = now_ns();
+
+	lock_guard<mutex> guard(lock);
+	if(!recording)
+		return;
+
+	long long &total = totals[name];
+	total += value;
+
+	if(events.size() >= KI_MAX_EVENTS)
+	{
+		dropped = true;
+		return;
+	}
+
+	CTraceEvent event;
+	event.name = name;
+	event.phase = 'C';
+	event.thread = thread_number();
+	event.start = now;
+	event.duration = 0;
+	event.value = total;
+	events.push_back(event);
+}
+
+// Returns the total of the counter called name, 0 if it was never added to
+long long CInstrument::get_counter(const char *name)
+{
+	lock_guard<mutex> guard(lock);
+
+	map<string, long long>::iterator it = totals.find(name);
+
+	return it == totals.end() ? 0 : it->second;
+}
+
+// Copy the totals of every counter, by name
+void CInstrument::get_counters(map<string, long long> &counters)
+{
+	lock_guard<mutex> guard(lock);
+
+	counters = totals;
+}
+
+// Forget the events and counters recorded so far, and keep recording if it was
+void CInstrument::reset()
+{
+	lock_guard<mutex> guard(lock);
+
+	events.clear();
+	totals.clear();
+	dropped = false;
+}
+
+// Write the events recorded so far as Chrome trace-event JSON, with times in microseconds
+// Returns 0 on success, -1 otherwise
+int CInstrument::write_trace(const char *path)
+{
+	FILE *fp = fopen(path, "w");
+	if(!fp)
+		return -1;
+
+	lock_guard<mutex> guard(lock);
+
+	fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped\":%s},\"traceEvents\":[\n", dropped ? "true" : "false");
+
+	for(size_t i=0; i < events.size(); i++)
+	{
+		const CTraceEvent &e = events[i];
+		const char *separator = i + 1 < events.size() ? "," : "";
+
+		if(e.phase == 'X')
+		{
+			fprintf(fp, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}%s\n",
+					e.name, e.thread, e.start / 1000.0, e.duration / 1000.0, separator);
+		}
+		else
+		{
+			fprintf(fp, "{\"name\":\"%s\",\"ph\":\"C\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"args\":{\"value\":%lld}}%s\n",
+					e.name, e.thread, e.start / 1000.0, e.value, separator);
+		}
+	} // end FOR each event
+
+	fprintf(fp, "]}\n");
+
+	const bool failed = ferror(fp) != 0;
+	if(fclose(fp) || failed)
+		return -1;
+
+	return 0;
+}
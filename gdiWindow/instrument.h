@@ -0,0 +1,99 @@
+// instrument.h
+// Authored by Alex Shows
+// Released under the MIT License (http://opensource.org/licenses/mit-license.php)
+//
+// Header declaring the CInstrument class and the KI_ instrumentation macros
+//
+// Scoped timers and counters for the hot paths, written out as a Chrome trace-event
+// JSON file (load it in chrome://tracing or Perfetto). KI_SCOPE(name) times the rest
+// of the enclosing block as one span on the calling thread's track; KI_COUNT(name, value)
+// adds value to a named counter, which is traced as it changes and totalled
+//
+// The macros only do anything when KMEANS_INSTRUMENT is defined (cmake
+// -DKMEANS_INSTRUMENT=ON); otherwise they expand to nothing and cost nothing. When
+// built in, recording starts with start(), or at startup if the KMEANS_TRACE
+// environment variable names a trace file, which is then written when the program
+// exits. Names must be string literals, or otherwise outlive the recording
+
+#pragma once
+
+#include <vector>
+#include <map>
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+using namespace std;
+
+#define KI_MAX_EVENTS (1 << 22) // Events kept before recording stops, bounding the memory used
+#define KI_TRACE_ENV "KMEANS_TRACE" // Environment variable naming a trace file to record to
+
+// One span ('X') or counter value ('C') of the trace
+struct CTraceEvent
+{
+	const char *name;
+	char phase; // Chrome trace-event phase, 'X' for a span, 'C' for a counter
+	int thread; // Small number standing for the recording thread
+	long long start; // Nanoseconds since the recording started
+	long long duration; // Nanoseconds the span took, unused by counters
+	long long value; // Total of the counter after this event, unused by spans
+};
+
+class CInstrument
+{
+public:
+	static CInstrument& instance();
+	static bool compiled_in();
+	void start(const char *path = NULL);
+	int stop();
+	bool is_recording(){ return recording.load(memory_order_relaxed);};
+	void record_span(const char *name, const long long startNs, const long long endNs);
+	void add_counter(const char *name, const long long value);
+	long long get_counter(const char *name);
+	void get_counters(map<string, long long> &counters);
+	void reset();
+	int write_trace(const char *path);
+	long long now_ns(){ return (long long)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - epoch).count();};
+private:
+	CInstrument();
+	~CInstrument();
+	// Not copyable, there is one recording per process
+	CInstrument(const CInstrument&);
+	CInstrument& operator=(const CInstrument&);
+	int thread_number();
+	mutex lock; // Guards everything below
+	atomic<bool> recording; // Whether spans and counters are being kept
+	chrono::steady_clock::time_point epoch; // Time zero of the trace
+	string tracePath; // Written by stop(), empty for none
+	vector<CTraceEvent> events; // Spans and counter values, in the order they finished
+	map<string, long long> totals; // Per counter name, its running total
+	map<thread::id, int> threadNumbers; // Per recording thread, its track in the trace
+	bool dropped; // Whether events were dropped after KI_MAX_EVENTS
+};
+
+// Records the time from its construction to its destruction as a span
+class CInstrumentScope
+{
+public:
+	CInstrumentScope(const char *spanName) : name(spanName)
+		{ start = CInstrument::instance().is_recording() ? CInstrument::instance().now_ns() : -1;};
+	~CInstrumentScope()
+		{ if(start >= 0) CInstrument::instance().record_span(name, start, CInstrument::instance().now_ns());};
+private:
+	// Not copyable, a span is timed once
+	CInstrumentScope(const CInstrumentScope&);
+	CInstrumentScope& operator=(const CInstrumentScope&);
+	const char *name; // Name of the span
+	long long start; // Nanoseconds since the recording started, -1 if it wasn't recording
+};
+
+#ifdef KMEANS_INSTRUMENT
+#define KI_JOIN2(a, b) a##b
+#define KI_JOIN(a, b) KI_JOIN2(a, b)
+#define KI_SCOPE(name) CInstrumentScope KI_JOIN(kiScope, __LINE__)(name)
+#define KI_COUNT(name, value) do { if(CInstrument::instance().is_recording()) CInstrument::instance().add_counter(name, (long long)(value)); } while(0)
+#else
+#define KI_SCOPE(name) do {} while(0)
+#define KI_COUNT(name, value) do {} while(0)
+#endif
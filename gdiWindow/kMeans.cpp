@@ -0,0 +1,1280 @@
+// kMeans.cpp
+// Authored by Alex Shows
+// Released under the MIT License (http://opensource.org/licenses/mit-license.php)
+//
+// Implementation of the CKMeans class
+// A portable, headless K-Means Clustering (Lloyd's Algorithm) engine
+
+#include "kMeans.h"
+#include "instrument.h"
+#include <stdlib.h>
+#include <math.h>
+#include <chrono>
+#include <limits>
+#include <algorithm>
+
+CKMeans::CKMeans() : seeder(threadPool, assignKernel)
+{
+	seed = 0;
+	pointCount = KM_DEFAULT_POINTS;
+	clusterCount = KM_DEFAULT_CLUSTERS;
+	seeding = KM_SEED_RANDOM;
+	reseedCount = 0;
+	partialStride = 0;
+	assignMode = KM_MODE_LLOYD;
+	boundsValid = false;
+	farthestShiftCluster = 0;
+	firstShift = secondShift = 0.0f;
+	incrementalValid = false;
+	drift = 0.0;
+}
+
+CKMeans::CKMeans(const int numPoints, const int numClusters) : seeder(threadPool, assignKernel)
+{
+	seed = 0;
+	pointCount = numPoints;
+	clusterCount = numClusters;
+	seeding = KM_SEED_RANDOM;
+	reseedCount = 0;
+	partialStride = 0;
+	assignMode = KM_MODE_LLOYD;
+	boundsValid = false;
+	farthestShiftCluster = 0;
+	firstShift = secondShift = 0.0f;
+	incrementalValid = false;
+	drift = 0.0;
+}
+
+CKMeans::~CKMeans()
+{
+}
+
+// Generate a new data set and cluster centers using the counts passed
+void CKMeans::initialize_data(const int numPoints, const int numClusters)
+{
+	pointCount = numPoints;
+	clusterCount = numClusters;
+
+	initialize_data();
+}
+
+// Generate a new data set of pointCount points steered into four quadrant blobs,
+// and clusterCount cluster centers placed by the seeding method
+void CKMeans::initialize_data()
+{
+	KI_SCOPE("initialize_data");
+
+	boundsValid = false;
+	incrementalValid = false;
+	reseedCount = 0;
+
+	srand(seed);
+
+	// Let go of any point file the store was attached to before writing new points
+	points.clear();
+	if(points.resize(pointCount) < 0)
+		pointCount = 0;
+
+	int *x = points.get_x();
+	int *y = points.get_y();
+	int *label = points.get_label();
+	unsigned char *size = points.get_size();
+	unsigned char *r = points.get_r();
+	unsigned char *g = points.get_g();
+	unsigned char *b = points.get_b();
+
+	for(int i=0; i < pointCount; i++)
+	{
+		int modulo = i%4;
+		// Artificial steering of clusters into the four quadrants
+		int xOffset = (modulo == 1 || modulo == 3) ? 300 : 20;
+		int yOffset = (modulo == 2 || modulo == 3) ? 300 : 20;
+
+		x[i] = rand()%CDP_X_UPPER_BOUND/6 + xOffset;
+		y[i] = rand()%CDP_Y_UPPER_BOUND/6 + yOffset;
+		label[i] = CPS_UNASSIGNED;
+		size[i] = 3;
+		r[i] = (unsigned char)(rand()%CDP_COLOR_UPPER_BOUND);
+		g[i] = (unsigned char)(rand()%CDP_COLOR_UPPER_BOUND);
+		b[i] = (unsigned char)(rand()%CDP_COLOR_UPPER_BOUND);
+	} // end for each data point
+
+	create_clusters();
+
+	// The random positions above are kept for KM_SEED_RANDOM so the data sets match
+	if(seeding != KM_SEED_RANDOM)
+		seed_clusters();
+}
+
+// Cluster the points of an open point file in place, rather than generated points.
+// The columns are mapped, not copied, so the file must stay open while the engine
+// uses them. The clusters are created and placed by the seeding method as in
+// initialize_data()
+// Returns the number of points, -1 on error
+int CKMeans::load_points(CPointFile &file)
+{
+	return adopt_points(file.attach(points));
+}
+
+// Cluster the rows of a CSV file, parsed across the thread pool by reader (which
+// also counts the rejected rows). The clusters are created and placed as in
+// initialize_data()
+// Returns the number of points, -1 on error
+int CKMeans::load_csv(CCsvReader &reader, const char *path)
+{
+	return adopt_points(reader.read(path, points, threadPool));
+}
+
+// Cluster numPoints points drawn from a Gaussian mixture, generated in parallel on the
+// thread pool; the same for a given generator seed whatever the number of threads. The
+// clusters are created and placed as in initialize_data()
+// Returns the number of points, -1 on error
+int CKMeans::load_mixture(CMixtureGenerator &generator, const int numPoints)
+{
+	return adopt_points(generator.generate(points, 0, numPoints, &threadPool));
+}
+
+// Take numPoints points just loaded into the store as the data set, and create and
+// place the clusters for them
+// Returns the number of points, -1 if the load failed (numPoints < 0)
+int CKMeans::adopt_points(const int numPoints)
+{
+	boundsValid = false;
+	incrementalValid = false;
+	reseedCount = 0;
+
+	if(numPoints < 0)
+	{
+		points.clear();
+		pointCount = 0;
+		return -1;
+	}
+
+	pointCount = numPoints;
+
+	srand(seed);
+	create_clusters();
+
+	if(seeding != KM_SEED_RANDOM)
+		seed_clusters();
+
+	return pointCount;
+}
+
+// Create clusterCount clusters at random positions, colored red, green, blue and yellow
+// then at random
+void CKMeans::create_clusters()
+{
+	vClusters.clear();
+	vClusters.reserve(clusterCount);
+
+	for(int j=0; j < clusterCount; j++)
+	{
+		// Use RGBY for the first 4 colors
+		if(j<4)
+		{
+			int redVal, greenVal, blueVal;
+			redVal = greenVal = blueVal = 0;
+
+			switch(j)
+			{
+			case 0:
+				redVal = 255;
+				break;
+			case 1:
+				greenVal = 150;
+				break;
+			case 2:
+				blueVal = 255;
+				break;
+			case 3: // Yellow
+				redVal = 200;
+				greenVal = 200;
+				break;
+			default:
+				// Should never arrive here
+				break;
+			}
+
+			vClusters.push_back(CDataPoint(rand()%CDP_X_UPPER_BOUND,
+										   rand()%CDP_Y_UPPER_BOUND,
+										   10, // No need to randomize, this is overriden elsewhere
+										   redVal,
+										   greenVal,
+										   blueVal));
+		} // end if j<4
+		else // else j >= 4, so generate a random color
+		{
+			// Load a randomized data point into the vector
+			vClusters.push_back(CDataPoint(rand()%CDP_X_UPPER_BOUND,
+										rand()%CDP_Y_UPPER_BOUND,
+										10, // No need to randomize, this is overridden elsewhere
+										rand()%(CDP_COLOR_UPPER_BOUND-100),
+										rand()%(CDP_COLOR_UPPER_BOUND-100),
+										rand()%(CDP_COLOR_UPPER_BOUND-100)));
+		} // end else
+	} // end for each cluster
+}
+
+// Convert the cluster positions to the float arrays the assignment kernel reads,
+// once per pass rather than once per point
+void CKMeans::load_centroids()
+{
+	const int numClusters = (int)vClusters.size();
+
+	centroidX.resize(numClusters);
+	centroidY.resize(numClusters);
+	for(int j=0; j < numClusters; j++)
+	{
+		centroidX[j] = (float)vClusters[j].get_x();
+		centroidY[j] = (float)vClusters[j].get_y();
+	}
+}
+
+// Assign each data point to the closest cluster
+// Only the x, y and label columns are touched; a point's display color follows
+// from its label. The work is done by the SIMD kernel selected in assignKernel
+// Returns the number of points whose label changed
+int CKMeans::assign_data()
+{
+	const int numClusters = (int)vClusters.size();
+	if(!numClusters)
+		return 0;
+
+	load_centroids();
+
+	KI_SCOPE("assign_data");
+
+	// The labels are about to change behind the bounds' and the running sums' back
+	boundsValid = false;
+	incrementalValid = false;
+
+	const int changed = assignKernel.assign(points.get_x(), points.get_y(), points.get_label(), points.get_count(),
+											&centroidX[0], &centroidY[0], numClusters);
+
+	// Every point reads its x and y and reads and writes its label
+	KI_COUNT("assign_data.distances", (long long)points.get_count() * numClusters);
+	KI_COUNT("assign_data.reassigned", changed);
+	KI_COUNT("assign_data.bytes", (long long)points.get_count() * 12);
+
+	return changed;
+}
+
+// Move a cluster to the mean of the dpCount points whose coordinates sum to xAccum, yAccum
+// Returns the distance the cluster moved
+double CKMeans::move_cluster(const int idx, const long long xAccum, const long long yAccum, const long long dpCount)
+{
+	CDataPoint &cluster = vClusters[idx];
+	const int oldX = cluster.get_x();
+	const int oldY = cluster.get_y();
+
+	// If there are no data points in this cluster, something went wrong,
+	// so move the cluster center to the center of the x and y range
+	if(!dpCount)
+	{
+		cluster.set_x(CDP_X_UPPER_BOUND/2);
+		cluster.set_y(CDP_Y_UPPER_BOUND/2);
+	}
+	else
+	{
+		// Compute the centroid as the mean of x and y, rounded to the nearest pixel
+		const double xMean = (double)xAccum / (double)dpCount;
+		const double yMean = (double)yAccum / (double)dpCount;
+
+		cluster.set_x((int)floor(xMean + 0.5));
+		cluster.set_y((int)floor(yMean + 0.5));
+	}
+
+	double dx = (double)(cluster.get_x() - oldX);
+	double dy = (double)(cluster.get_y() - oldY);
+
+	return sqrt(dx*dx + dy*dy);
+}
+
+// Update each cluster's position by computing the centroid of all data points associated with the cluster
+// A single pass over the points accumulates every cluster at once
+void CKMeans::compute_centroids()
+{
+	KI_SCOPE("compute_centroids");
+
+	const int numPoints = points.get_count();
+	const int numClusters = (int)vClusters.size();
+	const int *x = points.get_x();
+	const int *y = points.get_y();
+	const int *label = points.get_label();
+
+	// x and y position accumulators, 64-bit so large point sets don't overflow, and how many data points,
+	// kept in the partial sums of a single chunk rather than allocated on every call
+	prepare_partials(1);
+	long long *xAccum = &partialX[0];
+	long long *yAccum = &partialY[0];
+	long long *dpCount = &partialCount[0];
+
+	// For each data point...
+	for(int i=0; i < numPoints; i++)
+	{
+		const int l = label[i];
+
+		// Unassigned points don't belong to any cluster
+		if(l < 0 || l >= numClusters)
+			continue;
+
+		xAccum[l] += x[i];
+		yAccum[l] += y[i];
+		dpCount[l]++;
+	} // end FOR each data point
+
+	int emptyClusters = 0;
+	for(int j=0; j < numClusters; j++)
+	{
+		move_cluster(j, xAccum[j], yAccum[j], dpCount[j]);
+		if(!dpCount[j])
+			emptyClusters++;
+	}
+
+	KI_COUNT("compute_centroids.empty_clusters", emptyClusters);
+	KI_COUNT("compute_centroids.bytes", (long long)numPoints * 12);
+}
+
+// Label the points of one chunk of store and accumulate them into the chunk's own partial
+// sums, in the same pass through the kernel
+void CKMeans::assign_chunk(CPointStore &store, const int chunk, const int numChunks)
+{
+	const int numPoints = store.get_count();
+	const int begin = CThreadPool::chunk_begin(numPoints, chunk, numChunks);
+	const int end = CThreadPool::chunk_begin(numPoints, chunk + 1, numChunks);
+
+	KI_SCOPE("assign_chunk");
+
+	partialChanged[chunk] = assignKernel.assign(store.get_x() + begin, store.get_y() + begin, store.get_label() + begin,
+												end - begin, &centroidX[0], &centroidY[0], (int)vClusters.size(),
+												&partialX[chunk * partialStride],
+												&partialY[chunk * partialStride],
+												&partialCount[chunk * partialStride],
+												&partialDist[chunk]);
+}
+
+// Select how iterate() assigns points, KM_MODE_LLOYD or KM_MODE_HAMERLY
+// Returns the mode on success, -1 otherwise
+int CKMeans::set_assign_mode(const int mode)
+{
+	if(mode != KM_MODE_LLOYD && mode != KM_MODE_HAMERLY)
+		return -1;
+
+	assignMode = mode;
+	boundsValid = false;
+
+	return assignMode;
+}
+
+// Bounds are kept in float, so every bound is nudged outward by a few ulps when it's
+// computed or slid; a pruned point is then strictly closest to its cluster even allowing
+// for rounding, and Hamerly's labels match the Lloyd kernel's exactly
+#define KM_BOUND_SHRINK (1.0f - 1.0f/(1 << 20))
+#define KM_BOUND_GROW (1.0f + 1.0f/(1 << 20))
+
+// Work out, once per iteration, the per-cluster quantities the bounded assignment needs:
+// how far each cluster moved since the bounds were computed, and half the distance from
+// each cluster to its nearest neighbor
+void CKMeans::prepare_bounds()
+{
+	const int numPoints = points.get_count();
+	const int numClusters = (int)vClusters.size();
+
+	if((int)lowerBound.size() != numPoints || (int)boundCentroidX.size() != numClusters)
+		boundsValid = false;
+
+	lowerBound.resize(numPoints);
+	clusterShift.assign(numClusters, 0.0f);
+	halfSeparation.resize(numClusters);
+	farthestShiftCluster = 0;
+	firstShift = secondShift = 0.0f;
+
+	if(boundsValid)
+	{
+		for(int j=0; j < numClusters; j++)
+		{
+			double dx = (double)centroidX[j] - boundCentroidX[j];
+			double dy = (double)centroidY[j] - boundCentroidY[j];
+			float shift = (float)sqrt(dx*dx + dy*dy) * KM_BOUND_GROW;
+
+			clusterShift[j] = shift;
+			if(shift > firstShift)
+			{
+				secondShift = firstShift;
+				firstShift = shift;
+				farthestShiftCluster = j;
+			}
+			else if(shift > secondShift)
+				secondShift = shift;
+		} // end FOR each cluster
+	}
+
+	for(int j=0; j < numClusters; j++)
+	{
+		double nearest = numeric_limits<double>::infinity();
+
+		for(int k=0; k < numClusters; k++)
+		{
+			if(k == j)
+				continue;
+
+			double dx = (double)centroidX[j] - centroidX[k];
+			double dy = (double)centroidY[j] - centroidY[k];
+			double d = dx*dx + dy*dy;
+			if(d < nearest)
+				nearest = d;
+		}
+
+		halfSeparation[j] = (float)(0.5 * sqrt(nearest)) * KM_BOUND_SHRINK;
+	} // end FOR each cluster
+
+	// After this pass the bounds refer to the clusters where they are now
+	boundCentroidX = centroidX;
+	boundCentroidY = centroidY;
+}
+
+// Label the points of one chunk using Hamerly's triangle inequality bounds, and accumulate
+// them into the chunk's partial sums
+//
+// A point keeps its label without looking at any other cluster when its distance to that
+// cluster is below both half the distance from that cluster to its nearest neighbor and
+// the point's lower bound on the distance to every other cluster. The remaining points of
+// each block are gathered and rescanned against all clusters by the SIMD nearest_two()
+// kernel, which also refreshes their lower bound.
+//
+// The distance to the assigned cluster is needed for the inertia anyway, so the upper bound
+// is recomputed exactly on every pass instead of being stored and slid like the lower bound
+void CKMeans::assign_chunk_bounded(const int chunk, const int numChunks)
+{
+	KI_SCOPE("assign_chunk_bounded");
+
+	const int numPoints = points.get_count();
+	const int numClusters = (int)vClusters.size();
+	const int begin = CThreadPool::chunk_begin(numPoints, chunk, numChunks);
+	const int end = CThreadPool::chunk_begin(numPoints, chunk + 1, numChunks);
+	const int *x = points.get_x();
+	const int *y = points.get_y();
+	int *label = points.get_label();
+	float *lower = &lowerBound[0];
+	const float *cx = &centroidX[0];
+	const float *cy = &centroidY[0];
+	long long *sumX = &partialX[chunk * partialStride];
+	long long *sumY = &partialY[chunk * partialStride];
+	long long *count = &partialCount[chunk * partialStride];
+	double dist = 0.0;
+	long long evals = 0;
+	int changed = 0;
+
+	// Per block scratch: the distance of every point to its cluster, and the gathered
+	// points which need a full rescan
+	float best[KM_BOUND_BLOCK];
+	float scanX[KM_BOUND_BLOCK];
+	float scanY[KM_BOUND_BLOCK];
+	int scanIdx[KM_BOUND_BLOCK];
+	int scanLabel[KM_BOUND_BLOCK];
+	float scanBest[KM_BOUND_BLOCK];
+	float scanSecond[KM_BOUND_BLOCK];
+
+	for(int blockBegin = begin; blockBegin < end; blockBegin += KM_BOUND_BLOCK)
+	{
+		const int blockCount = (end - blockBegin > KM_BOUND_BLOCK) ? KM_BOUND_BLOCK : end - blockBegin;
+		int numScan = 0;
+
+		for(int k=0; k < blockCount; k++)
+		{
+			const int i = blockBegin + k;
+			const float px = (float)x[i];
+			const float py = (float)y[i];
+			const int a = label[i];
+
+			if(boundsValid && a >= 0 && a < numClusters)
+			{
+				// Slide the lower bound by the furthest any other cluster could have come closer
+				float l = (lower[i] - (a == farthestShiftCluster ? secondShift : firstShift)) * KM_BOUND_SHRINK;
+				float m = l > halfSeparation[a] ? l : halfSeparation[a];
+
+				float dx = px - cx[a];
+				float dy = py - cy[a];
+				best[k] = dx*dx + dy*dy;
+				lower[i] = l;
+				evals++;
+
+				if(m > 0.0f && best[k] * KM_BOUND_GROW * KM_BOUND_GROW < m * m)
+					continue;
+
+				// The distance to the assigned cluster was just counted
+				evals--;
+			}
+
+			scanX[numScan] = px;
+			scanY[numScan] = py;
+			scanIdx[numScan] = k;
+			numScan++;
+		} // end FOR each point in the block
+
+		if(numScan)
+		{
+			assignKernel.nearest_two(scanX, scanY, numScan, cx, cy, numClusters, scanLabel, scanBest, scanSecond);
+			evals += (long long)numScan * numClusters;
+
+			for(int n=0; n < numScan; n++)
+			{
+				const int k = scanIdx[n];
+				const int i = blockBegin + k;
+
+				if(label[i] != scanLabel[n])
+					changed++;
+				label[i] = scanLabel[n];
+				best[k] = scanBest[n];
+				lower[i] = sqrtf(scanSecond[n]) * KM_BOUND_SHRINK;
+			}
+		}
+
+		// Accumulate in point order so the inertia matches the Lloyd kernel exactly
+		for(int k=0; k < blockCount; k++)
+		{
+			const int i = blockBegin + k;
+			const int a = label[i];
+
+			sumX[a] += x[i];
+			sumY[a] += y[i];
+			count[a]++;
+			dist += best[k];
+		}
+	} // end FOR each block
+
+	partialChanged[chunk] = changed;
+	partialDist[chunk] = dist;
+	partialEvals[chunk] = evals;
+}
+
+// Zero the per chunk partial sums for a pass split into numChunks chunks
+void CKMeans::prepare_partials(const int numChunks)
+{
+	// Leave at least a cache line of padding between the partials of consecutive chunks
+	// so chunks on different threads never write to the same line
+	partialStride = (((int)vClusters.size() + 7) & ~7) + 8;
+	partialX.assign(numChunks * partialStride, 0);
+	partialY.assign(numChunks * partialStride, 0);
+	partialCount.assign(numChunks * partialStride, 0);
+	partialChanged.assign(numChunks, 0);
+	partialDist.assign(numChunks, 0.0);
+	partialEvals.assign(numChunks, 0);
+}
+
+// Run one Lloyd iteration (assign every point, then move every cluster to its centroid)
+// across the thread pool, in a single streaming pass over the points
+//
+// The points are split into chunks whose boundaries depend only on the number of points,
+// each chunk accumulates into its own partial sums, and the partials are reduced in chunk
+// order. The result is therefore the same whatever the number of threads
+// Fills in stats, if passed, and returns the number of points whose label changed, zero
+// once the clustering has converged
+int CKMeans::iterate(CIterationStats *stats)
+{
+	const int numPoints = points.get_count();
+	const int numClusters = (int)vClusters.size();
+	if(!numClusters)
+		return 0;
+
+	KI_SCOPE("iterate");
+
+	chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+
+	load_centroids();
+
+	const int numChunks = CThreadPool::chunk_count(numPoints, KM_MIN_CHUNK_POINTS, KM_MAX_CHUNKS);
+	prepare_partials(numChunks);
+	incrementalValid = false;
+
+	if(assignMode == KM_MODE_HAMERLY)
+	{
+		prepare_bounds();
+		threadPool.run(numChunks, [this, numChunks](int chunk){ assign_chunk_bounded(chunk, numChunks); });
+		boundsValid = true;
+	}
+	else
+	{
+		threadPool.run(numChunks, [this, numChunks](int chunk){ assign_chunk(points, chunk, numChunks); });
+		boundsValid = false;
+	}
+
+	chrono::high_resolution_clock::time_point assigned = chrono::high_resolution_clock::now();
+
+	// Reduce the partials in chunk order and move the clusters
+	double maxShift = 0.0;
+	int emptyClusters = 0;
+	for(int j=0; j < numClusters; j++)
+	{
+		long long xAccum = 0;
+		long long yAccum = 0;
+		long long dpCount = 0;
+
+		for(int c=0; c < numChunks; c++)
+		{
+			xAccum += partialX[c * partialStride + j];
+			yAccum += partialY[c * partialStride + j];
+			dpCount += partialCount[c * partialStride + j];
+		}
+
+		double shift = move_cluster(j, xAccum, yAccum, dpCount);
+		if(shift > maxShift)
+			maxShift = shift;
+		if(!dpCount)
+			emptyClusters++;
+	} // end FOR each cluster
+
+	int changed = 0;
+	double inertia = 0.0;
+	long long evals = 0;
+	for(int c=0; c < numChunks; c++)
+	{
+		changed += partialChanged[c];
+		inertia += partialDist[c];
+		evals += partialEvals[c];
+	}
+
+	// The Lloyd kernel always compares every point against every cluster
+	const long long allPairs = (long long)numPoints * numClusters;
+	if(assignMode != KM_MODE_HAMERLY)
+		evals = allPairs;
+
+	// Every point reads its x and y and reads and writes its label, and its lower bound
+	// when bounded
+	KI_COUNT("iterate.distances", evals);
+	KI_COUNT("iterate.reassigned", changed);
+	KI_COUNT("iterate.empty_clusters", emptyClusters);
+	KI_COUNT("iterate.bytes", (long long)numPoints * (assignMode == KM_MODE_HAMERLY ? 16 : 12));
+
+	if(stats)
+	{
+		chrono::high_resolution_clock::time_point updated = chrono::high_resolution_clock::now();
+
+		stats->labelChanges = changed;
+		stats->inertia = inertia;
+		stats->centroidShift = maxShift;
+		stats->distanceEvals = evals;
+		stats->pruneRate = allPairs ? 1.0 - (double)evals / (double)allPairs : 0.0;
+		stats->assignMs = chrono::duration<double, milli>(assigned - start).count();
+		stats->updateMs = chrono::duration<double, milli>(updated - assigned).count();
+	}
+
+	return changed;
+}
+
+// Iterate until no label changes, no cluster moves further than tolerance, or maxIterations
+// have run, whichever comes first
+// Appends one entry per iteration to stats, if passed, and returns the number of iterations run
+int CKMeans::run_until_converged(const int maxIterations, const double tolerance, vector<CIterationStats> *stats)
+{
+	int iter = 0;
+
+	while(iter < maxIterations)
+	{
+		CIterationStats iterStats;
+		iterStats.iteration = iter;
+
+		int changed = iterate(&iterStats);
+		iter++;
+
+		if(stats)
+			stats->push_back(iterStats);
+
+		if(!changed || iterStats.centroidShift <= tolerance)
+			break;
+	} // end WHILE not converged
+
+	return iter;
+}
+
+// Without touching the data sets, or the colors of the clusters, randomize
+// the positions of the clusters
+void CKMeans::randomize_cluster_positions()
+{
+	for(vector<CDataPoint>::iterator cIt = vClusters.begin(); cIt != vClusters.end(); ++cIt)
+	{
+		cIt->set_x(rand()%CDP_X_UPPER_BOUND);
+		cIt->set_y(rand()%CDP_Y_UPPER_BOUND);
+	} // end FOR each cluster
+}
+
+// Set the method seed_clusters() and initialize_data() use to place the clusters
+// Returns the method, or -1 if it isn't a KM_SEED_* value
+int CKMeans::set_seeding(const int method)
+{
+	if(method != KM_SEED_RANDOM && method != KM_SEED_PLUSPLUS && method != KM_SEED_PARALLEL)
+		return -1;
+
+	seeding = method;
+
+	return seeding;
+}
+
+// Place the clusters, keeping their colors, with the seeding method: at random, or
+// at data points picked by k-means++ or k-means||. Each call after initialize_data()
+// picks a different set of points, and the picks don't depend on the thread count
+// Returns the number of clusters placed
+int CKMeans::seed_clusters()
+{
+	KI_SCOPE("seed_clusters");
+
+	if(seeding == KM_SEED_RANDOM || !points.get_count())
+	{
+		randomize_cluster_positions();
+		return (int)vClusters.size();
+	}
+
+	return seed_from(points);
+}
+
+// Place the clusters at points of store picked by the seeding method
+// Returns the number of clusters placed
+int CKMeans::seed_from(CPointStore &store)
+{
+	const int numClusters = (int)vClusters.size();
+	unsigned long long rngSeed = ((unsigned long long)reseedCount++ << 32) | seed;
+
+	if(seeding == KM_SEED_PLUSPLUS)
+		seeder.seed_plusplus(store, numClusters, rngSeed, seedCenters);
+	else
+		seeder.seed_parallel(store, numClusters, rngSeed, seedCenters);
+
+	const int *x = store.get_x();
+	const int *y = store.get_y();
+	for(int j=0; j < (int)seedCenters.size() && j < numClusters; j++)
+	{
+		vClusters[j].set_x(x[seedCenters[j]]);
+		vClusters[j].set_y(y[seedCenters[j]]);
+	} // end FOR each cluster
+
+	return (int)seedCenters.size();
+}
+
+// Mini-batch k-means (Sculley, 2010) over a streamed data set. Batches of batchSize points
+// are read from source one at a time, so memory use is bounded by the batch whatever the
+// size of the data set. Each batch is labelled and summed by the same chunked kernel pass
+// as iterate(), then every cluster moves toward the mean of its points in the batch with
+// a learning rate of (its points in the batch) / (its points seen so far)
+//
+// The clusters are created and seeded (with the seeding method) from the first batch if
+// their number doesn't match the one requested. Positions are tracked in double and
+// rounded into the clusters after every batch. The bounded (Hamerly) assignment needs
+// the whole data set resident, so batches are always assigned the Lloyd way
+// Stops at the end of the data, after maxBatches batches, or once no cluster moves further
+// than tolerance in a batch. Appends one entry per batch to stats, if passed
+// Returns the number of batches run, -1 on error
+int CKMeans::run_minibatch(CPointSource &source, const int batchSize, const int maxBatches, const double tolerance,
+						   vector<CIterationStats> *stats)
+{
+	if(batchSize < 1)
+		return -1;
+
+	int batchCount = 0;
+	for(int batchNum=0; batchNum < maxBatches; batchNum++)
+	{
+		const int numPoints = source.read_batch(batch, batchSize);
+		if(numPoints < 0)
+			return -1;
+		if(!numPoints)
+			break;
+
+		KI_SCOPE("minibatch");
+
+		chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+
+		// First batch: make sure there are clusters to update, and start tracking them
+		if(!batchNum)
+		{
+			if((int)vClusters.size() != clusterCount)
+			{
+				srand(seed);
+				create_clusters();
+				reseedCount = 0;
+				if(seeding != KM_SEED_RANDOM)
+					seed_from(batch);
+			}
+
+			const int numClusters = (int)vClusters.size();
+			streamX.resize(numClusters);
+			streamY.resize(numClusters);
+			streamCount.assign(numClusters, 0);
+			for(int j=0; j < numClusters; j++)
+			{
+				streamX[j] = vClusters[j].get_x();
+				streamY[j] = vClusters[j].get_y();
+			}
+
+			// The labels of points no longer resident mean nothing to the bounds
+			boundsValid = false;
+		}
+
+		const int numClusters = (int)vClusters.size();
+		if(!numClusters)
+			break;
+
+		// The kernel compares against the full precision positions
+		centroidX.resize(numClusters);
+		centroidY.resize(numClusters);
+		for(int j=0; j < numClusters; j++)
+		{
+			centroidX[j] = (float)streamX[j];
+			centroidY[j] = (float)streamY[j];
+		}
+
+		const int numChunks = CThreadPool::chunk_count(numPoints, KM_MIN_CHUNK_POINTS, KM_MAX_CHUNKS);
+		prepare_partials(numChunks);
+		threadPool.run(numChunks, [this, numChunks](int chunk){ assign_chunk(batch, chunk, numChunks); });
+
+		chrono::high_resolution_clock::time_point assigned = chrono::high_resolution_clock::now();
+
+		// Reduce the partials in chunk order and step each cluster toward its batch mean
+		double maxShift = 0.0;
+		for(int j=0; j < numClusters; j++)
+		{
+			long long xAccum = 0;
+			long long yAccum = 0;
+			long long dpCount = 0;
+
+			for(int c=0; c < numChunks; c++)
+			{
+				xAccum += partialX[c * partialStride + j];
+				yAccum += partialY[c * partialStride + j];
+				dpCount += partialCount[c * partialStride + j];
+			}
+
+			if(!dpCount)
+				continue;
+
+			streamCount[j] += dpCount;
+			double rate = (double)dpCount / (double)streamCount[j];
+			double dx = rate * ((double)xAccum / (double)dpCount - streamX[j]);
+			double dy = rate * ((double)yAccum / (double)dpCount - streamY[j]);
+
+			streamX[j] += dx;
+			streamY[j] += dy;
+			vClusters[j].set_x((int)floor(streamX[j] + 0.5));
+			vClusters[j].set_y((int)floor(streamY[j] + 0.5));
+
+			double shift = sqrt(dx*dx + dy*dy);
+			if(shift > maxShift)
+				maxShift = shift;
+		} // end FOR each cluster
+
+		double inertia = 0.0;
+		for(int c=0; c < numChunks; c++)
+			inertia += partialDist[c];
+
+		KI_COUNT("minibatch.distances", (long long)numPoints * numClusters);
+		KI_COUNT("minibatch.bytes", (long long)numPoints * 12);
+
+		batchCount++;
+
+		if(stats)
+		{
+			chrono::high_resolution_clock::time_point updated = chrono::high_resolution_clock::now();
+			CIterationStats batchStats;
+
+			batchStats.iteration = batchNum;
+			batchStats.labelChanges = numPoints;
+			batchStats.inertia = inertia;
+			batchStats.centroidShift = maxShift;
+			batchStats.distanceEvals = (long long)numPoints * numClusters;
+			batchStats.pruneRate = 0.0;
+			batchStats.assignMs = chrono::duration<double, milli>(assigned - start).count();
+			batchStats.updateMs = chrono::duration<double, milli>(updated - assigned).count();
+			stats->push_back(batchStats);
+		}
+
+		if(maxShift <= tolerance)
+			break;
+	} // end FOR each batch
+
+	return batchCount;
+}
+
+// Label every point from scratch against the clusters where they are now, and build
+// the running sums and the revisit keys the incremental updates keep from then on.
+// Costs one Lloyd assignment pass, and only runs when they aren't already in step
+// with the labels (after the data was loaded or iterate() relabelled it)
+void CKMeans::prepare_incremental()
+{
+	const int numPoints = points.get_count();
+	const int numClusters = (int)vClusters.size();
+
+	if(incrementalValid && (int)runningCount.size() == numClusters && revisitQueue.get_count() == numPoints)
+		return;
+
+	KI_SCOPE("prepare_incremental");
+
+	load_centroids();
+	drift = 0.0;
+	trackedX.resize(numClusters);
+	trackedY.resize(numClusters);
+	for(int j=0; j < numClusters; j++)
+	{
+		trackedX[j] = vClusters[j].get_x();
+		trackedY[j] = vClusters[j].get_y();
+	}
+
+	revisitQueue.reset(numPoints);
+
+	const int numChunks = CThreadPool::chunk_count(numPoints, KM_MIN_CHUNK_POINTS, KM_MAX_CHUNKS);
+	prepare_partials(numChunks);
+	partialSq.assign(numChunks * partialStride, 0);
+	if(numClusters)
+		threadPool.run(numChunks, [this, numChunks](int chunk){ prepare_incremental_chunk(chunk, numChunks); });
+
+	runningX.assign(numClusters, 0);
+	runningY.assign(numClusters, 0);
+	runningSq.assign(numClusters, 0);
+	runningCount.assign(numClusters, 0);
+	for(int c=0; c < numChunks; c++)
+	{
+		for(int j=0; j < numClusters; j++)
+		{
+			runningX[j] += partialX[c * partialStride + j];
+			runningY[j] += partialY[c * partialStride + j];
+			runningSq[j] += partialSq[c * partialStride + j];
+			runningCount[j] += partialCount[c * partialStride + j];
+		}
+	} // end FOR each chunk
+
+	revisitQueue.build();
+
+	// The labels may have changed behind the bounds' back
+	boundsValid = false;
+	incrementalValid = true;
+
+	KI_COUNT("prepare_incremental.distances", (long long)numPoints * numClusters);
+}
+
+// Label the points of one chunk against their two nearest clusters, accumulate them
+// into the chunk's partial sums and set their revisit keys
+void CKMeans::prepare_incremental_chunk(const int chunk, const int numChunks)
+{
+	const int numPoints = points.get_count();
+	const int numClusters = (int)vClusters.size();
+	const int begin = CThreadPool::chunk_begin(numPoints, chunk, numChunks);
+	const int end = CThreadPool::chunk_begin(numPoints, chunk + 1, numChunks);
+	const int *x = points.get_x();
+	const int *y = points.get_y();
+	int *label = points.get_label();
+	long long *sumX = &partialX[chunk * partialStride];
+	long long *sumY = &partialY[chunk * partialStride];
+	long long *sumSq = &partialSq[chunk * partialStride];
+	long long *count = &partialCount[chunk * partialStride];
+
+	float scanX[KM_BOUND_BLOCK];
+	float scanY[KM_BOUND_BLOCK];
+	int scanLabel[KM_BOUND_BLOCK];
+	float scanBest[KM_BOUND_BLOCK];
+	float scanSecond[KM_BOUND_BLOCK];
+
+	for(int blockBegin = begin; blockBegin < end; blockBegin += KM_BOUND_BLOCK)
+	{
+		const int blockCount = (end - blockBegin > KM_BOUND_BLOCK) ? KM_BOUND_BLOCK : end - blockBegin;
+
+		for(int k=0; k < blockCount; k++)
+		{
+			scanX[k] = (float)x[blockBegin + k];
+			scanY[k] = (float)y[blockBegin + k];
+		}
+
+		assignKernel.nearest_two(scanX, scanY, blockCount, &centroidX[0], &centroidY[0], numClusters, scanLabel, scanBest, scanSecond);
+
+		for(int k=0; k < blockCount; k++)
+		{
+			const int i = blockBegin + k;
+			const int a = scanLabel[k];
+
+			label[i] = a;
+			sumX[a] += x[i];
+			sumY[a] += y[i];
+			sumSq[a] += (long long)x[i] * x[i] + (long long)y[i] * y[i];
+			count[a]++;
+			revisitQueue.set_key(i, revisit_key(scanBest[k], scanSecond[k]));
+		}
+	} // end FOR each block
+}
+
+// The drift at which a point at squared distances best and second from its nearest and
+// second nearest clusters might have a nearer cluster than its own: half the gap between
+// the two distances past the drift now, shrunk by a few ulps for the rounding of the
+// float distances
+double CKMeans::revisit_key(const float best, const float second)
+{
+	if(!(second < numeric_limits<float>::infinity()))
+		return RQ_NEVER;
+
+	return drift + 0.5 * (sqrt((double)second) * KM_BOUND_SHRINK - sqrt((double)best) * KM_BOUND_GROW);
+}
+
+// Add the furthest any cluster moved since the last step to the drift. Moves made by
+// anything else in between (a seeding, compute_centroids(), the window) are counted too
+void CKMeans::advance_drift()
+{
+	double maxShift = 0.0;
+
+	for(int j=0; j < (int)vClusters.size(); j++)
+	{
+		const double dx = (double)(vClusters[j].get_x() - trackedX[j]);
+		const double dy = (double)(vClusters[j].get_y() - trackedY[j]);
+		const double shift = sqrt(dx*dx + dy*dy);
+
+		if(shift > maxShift)
+			maxShift = shift;
+		trackedX[j] = vClusters[j].get_x();
+		trackedY[j] = vClusters[j].get_y();
+	} // end FOR each cluster
+
+	drift += maxShift * KM_BOUND_GROW;
+}
+
+// Add (sign 1) or take away (sign -1) the point at idx to the running sums of cluster
+void CKMeans::add_running(const int idx, const int cluster, const int sign)
+{
+	const long long px = points.get_x()[idx];
+	const long long py = points.get_y()[idx];
+
+	runningX[cluster] += sign * px;
+	runningY[cluster] += sign * py;
+	runningSq[cluster] += sign * (px * px + py * py);
+	runningCount[cluster] += sign;
+}
+
+// Label the points in due against the centroids loaded for the kernel, moving those whose
+// label changed from one cluster's running sums to the other's, and schedule their next
+// look. A point labelled CPS_UNASSIGNED (just appended) is only added
+// Returns the number of labels that changed
+int CKMeans::rescan(const vector<int> &due)
+{
+	const int numDue = (int)due.size();
+	const int numClusters = (int)vClusters.size();
+	const int *x = points.get_x();
+	const int *y = points.get_y();
+	int *label = points.get_label();
+	int changed = 0;
+
+	float scanX[KM_BOUND_BLOCK];
+	float scanY[KM_BOUND_BLOCK];
+	int scanLabel[KM_BOUND_BLOCK];
+	float scanBest[KM_BOUND_BLOCK];
+	float scanSecond[KM_BOUND_BLOCK];
+
+	for(int blockBegin = 0; blockBegin < numDue; blockBegin += KM_BOUND_BLOCK)
+	{
+		const int blockCount = (numDue - blockBegin > KM_BOUND_BLOCK) ? KM_BOUND_BLOCK : numDue - blockBegin;
+
+		for(int k=0; k < blockCount; k++)
+		{
+			scanX[k] = (float)x[due[blockBegin + k]];
+			scanY[k] = (float)y[due[blockBegin + k]];
+		}
+
+		assignKernel.nearest_two(scanX, scanY, blockCount, &centroidX[0], &centroidY[0], numClusters, scanLabel, scanBest, scanSecond);
+
+		for(int k=0; k < blockCount; k++)
+		{
+			const int i = due[blockBegin + k];
+			const int a = scanLabel[k];
+
+			if(label[i] != a)
+			{
+				if(label[i] >= 0 && label[i] < numClusters)
+					add_running(i, label[i], -1);
+				add_running(i, a, 1);
+				label[i] = a;
+				changed++;
+			}
+
+			revisitQueue.schedule(i, revisit_key(scanBest[k], scanSecond[k]));
+		}
+	} // end FOR each block
+
+	return changed;
+}
+
+// Add copies of the points of batch to the data set, each labelled with its nearest
+// cluster and added to that cluster's running sums; the clusters don't move until
+// update_incremental(). Costs the batch times the clusters, plus one full labelling
+// pass the first time after the data set was loaded or relabelled by iterate()
+// Returns the number of points in the data set, -1 if it couldn't grow (leaving it as it was)
+int CKMeans::append_points(CPointStore &batch)
+{
+	const int numClusters = (int)vClusters.size();
+	const int first = points.get_count();
+
+	KI_SCOPE("append_points");
+
+	prepare_incremental();
+
+	// A failed append leaves the store, and so the running sums, as they were
+	if(points.append(batch) < 0)
+		return -1;
+
+	const int numPoints = points.get_count();
+	int *label = points.get_label();
+
+	revisitDue.clear();
+	for(int i=first; i < numPoints; i++)
+	{
+		label[i] = CPS_UNASSIGNED;
+		revisitDue.push_back(i);
+	}
+
+	pointCount = numPoints;
+	revisitQueue.resize(numPoints);
+	boundsValid = false;
+
+	if(numClusters)
+	{
+		advance_drift();
+		load_centroids();
+		rescan(revisitDue);
+	}
+
+	KI_COUNT("append_points.points", numPoints - first);
+	KI_COUNT("append_points.distances", (long long)(numPoints - first) * numClusters);
+
+	return numPoints;
+}
+
+// Remove the points at indices (in any order, repeats ignored) from the data set and
+// from their clusters' running sums. Each hole is filled by moving the last point into
+// it, as CPointStore::swap_remove() does, so the indices of the points that remain past
+// the lowest index removed can change. Costs the points removed
+// Returns the number of points removed, -1 if an index is out of range or the store
+// couldn't be written (removing none)
+int CKMeans::remove_points(const int *indices, const int numIndices)
+{
+	const int numClusters = (int)vClusters.size();
+
+	if(numIndices < 0 || (numIndices && !indices))
+		return -1;
+	for(int n=0; n < numIndices; n++)
+	{
+		if(indices[n] < 0 || indices[n] >= points.get_count())
+			return -1;
+	}
+
+	KI_SCOPE("remove_points");
+
+	// Copy a borrowed store before anything is touched, so the removals below can't
+	// fail partway through
+	if(points.is_borrowed() && points.reserve(points.get_capacity() + 1) < 0)
+		return -1;
+
+	prepare_incremental();
+
+	// Largest first, so the last point moved into each hole is never one still to go
+	removeOrder.assign(indices, indices + numIndices);
+	sort(removeOrder.begin(), removeOrder.end(), greater<int>());
+	removeOrder.erase(unique(removeOrder.begin(), removeOrder.end()), removeOrder.end());
+
+	const int *label = points.get_label();
+	for(size_t n=0; n < removeOrder.size(); n++)
+	{
+		const int idx = removeOrder[n];
+		const int last = points.get_count() - 1;
+
+		if(label[idx] >= 0 && label[idx] < numClusters)
+			add_running(idx, label[idx], -1);
+
+		points.swap_remove(idx);
+		revisitQueue.move_point(last, idx);
+	} // end FOR each point removed
+
+	pointCount = points.get_count();
+	revisitQueue.resize(pointCount);
+	boundsValid = false;
+
+	KI_COUNT("remove_points.points", (long long)removeOrder.size());
+
+	return (int)removeOrder.size();
+}
+
+// Run Lloyd iterations warm from where the clusters are, after points were appended or
+// removed (or the clusters were moved). Each step adds the furthest any cluster moved to
+// the drift, rescans only the points whose revisit keys the drift has passed (the ones
+// near a boundary that moved), moves each relabelled point between the running sums and
+// moves every cluster to the mean of its running sums. The labels and clusters end up as
+// a full Lloyd pass would leave them (iterate() would change no label), for the cost of
+// the points near the boundaries
+// Stops once no cluster moves further than tolerance, or after maxIterations steps.
+// Appends one entry per step to stats, if passed, with the inertia worked out from the
+// running sums and the pruning rate against a full pass
+// Returns the number of steps run
+int CKMeans::update_incremental(const int maxIterations, const double tolerance, vector<CIterationStats> *stats)
+{
+	const int numClusters = (int)vClusters.size();
+	if(!numClusters)
+		return 0;
+
+	prepare_incremental();
+
+	int iter = 0;
+	while(iter < maxIterations)
+	{
+		KI_SCOPE("update_incremental");
+
+		chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+
+		advance_drift();
+		load_centroids();
+
+		revisitDue.clear();
+		const int numDue = revisitQueue.pop_due(drift, revisitDue);
+		const int changed = rescan(revisitDue);
+
+		chrono::high_resolution_clock::time_point assigned = chrono::high_resolution_clock::now();
+
+		// The sum of squared distances to the centroids the points were labelled against,
+		// expanded so it only needs the per-cluster sums
+		double inertia = 0.0;
+		double maxShift = 0.0;
+		int emptyClusters = 0;
+		for(int j=0; j < numClusters; j++)
+		{
+			const double cx = centroidX[j];
+			const double cy = centroidY[j];
+			inertia += (double)runningSq[j] - 2.0 * (cx * (double)runningX[j] + cy * (double)runningY[j]) +
+					   (double)runningCount[j] * (cx * cx + cy * cy);
+
+			double shift = move_cluster(j, runningX[j], runningY[j], runningCount[j]);
+			if(shift > maxShift)
+				maxShift = shift;
+			if(!runningCount[j])
+				emptyClusters++;
+		} // end FOR each cluster
+
+		KI_COUNT("update_incremental.distances", (long long)numDue * numClusters);
+		KI_COUNT("update_incremental.revisited", numDue);
+		KI_COUNT("update_incremental.reassigned", changed);
+		KI_COUNT("update_incremental.empty_clusters", emptyClusters);
+
+		if(stats)
+		{
+			chrono::high_resolution_clock::time_point updated = chrono::high_resolution_clock::now();
+			const long long allPairs = (long long)points.get_count() * numClusters;
+			CIterationStats iterStats;
+
+			iterStats.iteration = iter;
+			iterStats.labelChanges = changed;
+			iterStats.inertia = inertia;
+			iterStats.centroidShift = maxShift;
+			iterStats.distanceEvals = (long long)numDue * numClusters;
+			iterStats.pruneRate = allPairs ? 1.0 - (double)iterStats.distanceEvals / (double)allPairs : 0.0;
+			iterStats.assignMs = chrono::duration<double, milli>(assigned - start).count();
+			iterStats.updateMs = chrono::duration<double, milli>(updated - assigned).count();
+			stats->push_back(iterStats);
+		}
+
+		iter++;
+
+		if(maxShift <= tolerance)
+			break;
+	} // end WHILE not converged
+
+	return iter;
+}
@@ -0,0 +1,166 @@
+// kMeans.h
+// Authored by Alex Shows
+// Released under the MIT License (http://opensource.org/licenses/mit-license.php)
+//
+// Header declaring the CKMeans class
+//
+// A portable, headless K-Means Clustering (Lloyd's Algorithm) engine
+//
+// The engine owns the data points (in a structure-of-arrays CPointStore) and
+// the cluster centers and has no dependency on Win32 or GDI+, so it can be
+// driven from the window, a command line tool or a batch job alike
+//
+// A data set that changes a batch at a time is kept clustered incrementally:
+// append_points() and remove_points() label the batch and add it to (or take it
+// from) running per-cluster sums in time proportional to the batch, and
+// update_incremental() runs Lloyd iterations warm from the current clusters, only
+// rescanning the points CRevisitQueue says the clusters' moves could have relabelled
+
+#pragma once
+
+#define KM_DEFAULT_POINTS 100
+#define KM_DEFAULT_CLUSTERS 4
+#define KM_MAX_CHUNKS 256 // Upper bound on the chunks a parallel pass splits the points into
+#define KM_MIN_CHUNK_POINTS 16384 // Chunks are never smaller than this, unless there are fewer points
+#define KM_DEFAULT_MAX_ITERATIONS 100
+#define KM_DEFAULT_TOLERANCE 0.0 // Largest cluster movement, in pixels, still counted as converged
+#define KM_MODE_LLOYD 0 // Every point is compared against every cluster on every iteration
+#define KM_MODE_HAMERLY 1 // Triangle inequality bounds skip clusters that can't be the closest
+#define KM_BOUND_BLOCK 256 // Points the bounded assignment tests before rescanning the ones left over
+#define KM_SEED_RANDOM 0 // Clusters start at uniformly random positions
+#define KM_SEED_PLUSPLUS 1 // Clusters start at data points picked by k-means++
+#define KM_SEED_PARALLEL 2 // Clusters start at data points picked by k-means||
+#define KM_DEFAULT_BATCH_SIZE 65536 // Points per batch of run_minibatch()
+
+#include "dataPoint.h"
+#include "pointStore.h"
+#include "assignKernel.h"
+#include "threadPool.h"
+#include "clusterSeeder.h"
+#include "pointSource.h"
+#include "pointFile.h"
+#include "csvReader.h"
+#include "mixtureGenerator.h"
+#include "revisitQueue.h"
+#include <vector>
+using namespace std;
+
+// Statistics gathered by one Lloyd iteration, or one batch of run_minibatch()
+struct CIterationStats
+{
+	int iteration; // Zero based iteration (or batch) number
+	int labelChanges; // Number of points whose label changed (points in the batch for run_minibatch())
+	double inertia; // Sum of squared distances from each point (of the batch) to the cluster it was assigned to
+	double centroidShift; // Largest distance any cluster moved in the update
+	long long distanceEvals; // Point to cluster distances computed
+	double pruneRate; // Fraction of the point to cluster distances skipped by the bounds
+	double assignMs; // Wall time of the assign (and accumulate) phase
+	double updateMs; // Wall time of the reduce and update phase
+};
+
+class CKMeans
+{
+public:
+	CKMeans();
+	CKMeans(const int numPoints, const int numClusters);
+	~CKMeans();
+	void initialize_data();
+	void initialize_data(const int numPoints, const int numClusters);
+	int load_points(CPointFile &file);
+	int load_csv(CCsvReader &reader, const char *path);
+	int load_mixture(CMixtureGenerator &generator, const int numPoints);
+	int assign_data();
+	void compute_centroids();
+	int iterate(CIterationStats *stats = NULL);
+	int run_until_converged(const int maxIterations = KM_DEFAULT_MAX_ITERATIONS,
+							const double tolerance = KM_DEFAULT_TOLERANCE,
+							vector<CIterationStats> *stats = NULL);
+	int run_minibatch(CPointSource &source,
+					  const int batchSize = KM_DEFAULT_BATCH_SIZE,
+					  const int maxBatches = KM_DEFAULT_MAX_ITERATIONS,
+					  const double tolerance = KM_DEFAULT_TOLERANCE,
+					  vector<CIterationStats> *stats = NULL);
+	int append_points(CPointStore &batch);
+	int remove_points(const int *indices, const int numIndices);
+	int update_incremental(const int maxIterations = KM_DEFAULT_MAX_ITERATIONS,
+						   const double tolerance = KM_DEFAULT_TOLERANCE,
+						   vector<CIterationStats> *stats = NULL);
+	void randomize_cluster_positions();
+	int seed_clusters();
+	void set_seed(const unsigned int seedVal){ seed = seedVal;};
+	unsigned int get_seed(){ return seed;};
+	int set_assign_path(const int path = AK_PATH_AUTO){ return assignKernel.set_path(path);};
+	int get_assign_path(){ return assignKernel.get_path();};
+	int set_thread_count(const int numThreads = 0){ return threadPool.set_thread_count(numThreads);};
+	int get_thread_count(){ return threadPool.get_thread_count();};
+	int set_assign_mode(const int mode);
+	int get_assign_mode(){ return assignMode;};
+	int set_seeding(const int method);
+	int get_seeding(){ return seeding;};
+	int get_num_points(){ return points.get_count();};
+	int get_num_clusters(){ return (int)vClusters.size();};
+	CPointStore& get_points(){ return points;};
+	vector<CDataPoint>& get_clusters(){ return vClusters;};
+private:
+	unsigned int seed; // Seed passed to srand() by initialize_data()
+	int pointCount; // Number of data points generated by initialize_data()
+	int clusterCount; // Number of clusters generated by initialize_data()
+	int seeding; // KM_SEED_* used to place the clusters
+	unsigned int reseedCount; // Calls to seed_clusters() since the data was generated, varies the picks
+	CPointStore points; // Data points, stored column by column
+	vector<CDataPoint> vClusters;
+	vector<float> centroidX; // Cluster x positions as floats, handed to the assignment kernel
+	vector<float> centroidY; // Cluster y positions as floats, handed to the assignment kernel
+	CAssignKernel assignKernel; // Nearest-centroid kernel, best SIMD path by default
+	CThreadPool threadPool; // Workers for iterate(), single threaded by default
+	int partialStride; // Distance between the partial sums of consecutive chunks, padded by a cache line
+	vector<long long> partialX; // Per chunk, per cluster sum of x
+	vector<long long> partialY; // Per chunk, per cluster sum of y
+	vector<long long> partialCount; // Per chunk, per cluster number of points
+	vector<int> partialChanged; // Per chunk number of labels changed
+	vector<double> partialDist; // Per chunk sum of squared distances to the assigned clusters
+	vector<long long> partialEvals; // Per chunk number of point to cluster distances computed
+	int assignMode; // KM_MODE_* used by iterate()
+	bool boundsValid; // Whether lowerBound holds a bound for every point's current label
+	vector<float> lowerBound; // Per point lower bound on the distance to its second closest cluster
+	vector<float> boundCentroidX; // Cluster x positions the lower bounds were computed against
+	vector<float> boundCentroidY; // Cluster y positions the lower bounds were computed against
+	vector<float> halfSeparation; // Per cluster half the distance to the nearest other cluster
+	vector<float> clusterShift; // Per cluster distance moved since the bounds were computed
+	int farthestShiftCluster; // Cluster which moved the furthest
+	float firstShift; // Distance moved by farthestShiftCluster
+	float secondShift; // Largest distance moved by any other cluster
+	CPointStore batch; // The one resident batch of run_minibatch()
+	vector<double> streamX; // Cluster x positions tracked at full precision by run_minibatch()
+	vector<double> streamY; // Cluster y positions tracked at full precision by run_minibatch()
+	vector<long long> streamCount; // Per cluster points seen by run_minibatch(), sets the learning rate
+	CClusterSeeder seeder; // Picks the starting positions, keeping its buffers from one seeding to the next
+	vector<int> seedCenters; // Points the seeder picked
+	bool incrementalValid; // Whether the running sums and revisit keys match the labels
+	vector<long long> runningX; // Per cluster sum of x over its points, kept by the incremental updates
+	vector<long long> runningY; // Per cluster sum of y over its points
+	vector<long long> runningSq; // Per cluster sum of x*x + y*y over its points, for the inertia
+	vector<long long> runningCount; // Per cluster number of points
+	vector<long long> partialSq; // Per chunk, per cluster sum of x*x + y*y, while the running sums are built
+	vector<int> trackedX; // Cluster positions the drift was last brought up to
+	vector<int> trackedY;
+	double drift; // Sum of the furthest any cluster moved at each incremental step, since the keys were built
+	CRevisitQueue revisitQueue; // Points in the order the drift can unsettle their labels
+	vector<int> revisitDue; // Points being rescanned by an incremental step or append
+	vector<int> removeOrder; // Points being removed, largest index first
+	void create_clusters();
+	int adopt_points(const int numPoints);
+	int seed_from(CPointStore &store);
+	void prepare_partials(const int numChunks);
+	void load_centroids();
+	double move_cluster(const int idx, const long long xAccum, const long long yAccum, const long long dpCount);
+	void assign_chunk(CPointStore &store, const int chunk, const int numChunks);
+	void prepare_bounds();
+	void assign_chunk_bounded(const int chunk, const int numChunks);
+	void prepare_incremental();
+	void prepare_incremental_chunk(const int chunk, const int numChunks);
+	double revisit_key(const float best, const float second);
+	void advance_drift();
+	int rescan(const vector<int> &due);
+	void add_running(const int idx, const int cluster, const int sign);
+};
@@ -0,0 +1,703 @@
+// kMeansBench.cpp
+// Authored by Alex Shows
+// Released under the MIT License (http://opensource.org/licenses/mit-license.php)
+//
+// Benchmarks of the engine's hot paths, in the spirit of Google Benchmark
+//
+// Sweeps the number of points, clusters and threads over the stages: assign_data(),
+// compute_centroids(), a fused iterate() with Lloyd and with Hamerly assignment,
+// k-means++ and k-means|| seeding, rendering a frame with the software rasterizer,
+// generating a Gaussian mixture of K components with CMixtureGenerator,
+// CTypedKMeans::iterate() with int16, int32, float32 and float64 coordinates, keeping
+// the clusters up to date incrementally as 1% more points come and go (incremental), and
+// CFeatureKMeans::iterate() over D-dimensional features with the kernel specialized
+// for D (features) and with the runtime D one (features_generic). Each case runs
+// until it has taken at least the minimum time; the mean and fastest run, points per second and bytes per second are printed as a
+// table on stderr and written as JSON to stdout (or the -o file). Every case starts
+// with an untimed warm up run, and the data is generated with a fixed seed, so runs
+// are comparable
+//
+// -B compares the fastest run of every case against a JSON file written by an
+// earlier run and exits with status 2 if any case got slower by more than the
+// tolerance (-T, 0.25 by default), so it can gate a CI build. Baseline cases the
+// run didn't include are listed, and if none of its cases is in the baseline it exits
+// with status 1 rather than pass having checked nothing. -q runs a small
+// sweep quick enough for that. Cases whose points x clusters exceed -W are
+// skipped, to keep the default sweep to minutes, and so are point counts that
+// wouldn't fit in half the machine's memory (the default sweep goes up to 1e8
+// points, which takes about 10 GB)
+//
+// -d sweeps the dimensionality of the feature stages; the other stages work on the
+// two dimensional points of CKMeans
+//
+// Usage: kmeans_bench [-n points,...] [-k clusters,...] [-d dims,...] [-t threads,...] [-s stage,...] [-m min ms] [-W max work] [-q] [-o json file] [-B baseline json] [-T tolerance]
+
+#include "kMeans.h"
+#include "featureKMeans.h"
+#include "typedKMeans.h"
+#include "clusterSeeder.h"
+#include "rasterizer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+using namespace std;
+
+#define KB_DEFAULT_MIN_MS 250.0 // Each case runs at least this long
+#define KB_QUICK_MIN_MS 100.0
+#define KB_DEFAULT_MAX_WORK 2e9 // Largest points x clusters of a case in the default sweep
+#define KB_DEFAULT_TOLERANCE 0.25 // Slowdown against the baseline tolerated by -B
+#define KB_MAX_RUNS 1000000 // Upper bound on the timed runs of a case
+#define KB_MAX_FEATURE_VALUES (1 << 28) // Largest points x dims of a feature case, 1 GB of floats
+#define KB_BYTES_PER_POINT 96.0 // Memory the 2D stages take per point (store, bounds, incremental state), rounded up
+
+// Stages that can be benchmarked, in the order they run
+static const char *stageNames[] = { "assign", "update", "iterate", "hamerly", "kmeans++", "kmeans||", "render",
+									 "generate", "typed_int16", "typed_int32", "typed_float32", "typed_float64", "incremental",
+									 "features", "features_generic" };
+static const int numStages = sizeof(stageNames) / sizeof(stageNames[0]);
+static const int firstFeatureStage = 13; // Stages from here on cluster CFeatureKMeans features
+
+// Timings of one case
+struct CBenchResult
+{
+	string name; // stage/N:points/K:clusters[/D:dims]/threads:threads
+	string stage;
+	long long points;
+	int clusters;
+	int dims;
+	int threads;
+	int runs; // Timed runs
+	double meanMs; // Mean wall time of a run
+	double minMs; // Fastest run
+	double itemsPerSec; // Points processed per second, by the mean run
+	double bytesPerSec; // Bytes of point data streamed per second, by the mean run
+};
+
+static void print_usage(const char *exeName)
+{
+	fprintf(stderr, "Usage: %s [-n points,...] [-k clusters,...] [-d dims,...] [-t threads,...] [-s stage,...] [-m min ms] [-W max work] [-q] [-o json file] [-B baseline json] [-T tolerance]\n", exeName);
+	fprintf(stderr, "Stages: assign, update, iterate, hamerly, kmeans++, kmeans||, render, generate, typed_int16, typed_int32, typed_float32, typed_float64, incremental, features, features_generic\n");
+}
+
+// Bytes of physical memory in the machine, 0 if unknown
+static double physical_memory()
+{
+#ifdef _WIN32
+	MEMORYSTATUSEX status;
+	status.dwLength = sizeof(status);
+	return GlobalMemoryStatusEx(&status) ? (double)status.ullTotalPhys : 0.0;
+#else
+	const long pages = sysconf(_SC_PHYS_PAGES);
+	const long pageBytes = sysconf(_SC_PAGE_SIZE);
+	return pages > 0 && pageBytes > 0 ? (double)pages * pageBytes : 0.0;
+#endif
+}
+
+// Parse a comma separated list of numbers (which may use exponents, e.g. 1e6)
+// Returns 0 on success, -1 otherwise
+static int parse_list(const char *text, vector<long long> &values)
+{
+	values.clear();
+	while(*text)
+	{
+		char *end;
+		const double value = strtod(text, &end);
+		if(end == text || value < 0 || value > 9e18)
+			return -1;
+		values.push_back((long long)(value + 0.5));
+
+		text = end;
+		if(*text == ',')
+			text++;
+		else if(*text)
+			return -1;
+	}
+
+	return values.empty() ? -1 : 0;
+}
+
+// Run body until at least minMs have been spent in timed runs, after one untimed run
+// to warm up the caches and let the engine and rasterizer size their buffers
+static void time_case(const function<void ()> &body, const double minMs, CBenchResult &result)
+{
+	body();
+
+	double totalMs = 0.0;
+	result.runs = 0;
+	result.minMs = 0.0;
+
+	while(totalMs < minMs && result.runs < KB_MAX_RUNS)
+	{
+		const chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+		body();
+		const double runMs = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+
+		if(!result.runs || runMs < result.minMs)
+			result.minMs = runMs;
+		totalMs += runMs;
+		result.runs++;
+	}
+
+	result.meanMs = totalMs / result.runs;
+}
+
+// Time CTypedKMeans<T>::iterate() over the points of kMeans, every run starting from
+// startClusters
+// Returns the bytes of point data a run streams per point: x and y in T, plus the label
+template <typename T>
+static double time_typed(CKMeans &kMeans, const vector<CDataPoint> &startClusters, const int numThreads, const double minMs,
+						 CBenchResult &result)
+{
+	CTypedKMeans<T> typedKMeans;
+	vector<CDataPoint> clusters = startClusters;
+
+	typedKMeans.set_thread_count(numThreads);
+	typedKMeans.load(kMeans.get_points(), clusters);
+	time_case([&]{ typedKMeans.set_clusters(clusters); typedKMeans.iterate(); }, minMs, result);
+
+	return 2.0 * sizeof(T) + sizeof(int);
+}
+
+// Work out the rates of a timed case, print it and add it to results
+static void report(CBenchResult &result, const double bytesPerPoint, vector<CBenchResult> &results)
+{
+	result.itemsPerSec = result.points / (result.meanMs / 1000.0);
+	result.bytesPerSec = result.points * bytesPerPoint / (result.meanMs / 1000.0);
+	results.push_back(result);
+
+	fprintf(stderr, "%-44s %6d %12.3f %12.3f %14.4g %12.1f\n", result.name.c_str(), result.runs, result.meanMs, result.minMs,
+		result.itemsPerSec, result.bytesPerSec / 1e6);
+}
+
+// Read the fastest run of every case from a JSON file written by write_json()
+// Returns 0 on success, -1 otherwise
+static int read_baseline(const char *path, map<string, double> &baseline)
+{
+	FILE *fp = fopen(path, "rb");
+	if(!fp)
+		return -1;
+
+	string text;
+	char buffer[4096];
+	size_t bytes;
+	while((bytes = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+		text.append(buffer, bytes);
+	fclose(fp);
+
+	// Every case is an object holding a "name" followed by its "min_time"
+	static const char nameKey[] = "\"name\": \"";
+	static const char minKey[] = "\"min_time\": ";
+	size_t pos = 0;
+	while((pos = text.find(nameKey, pos)) != string::npos)
+	{
+		pos += sizeof(nameKey) - 1;
+		const size_t nameEnd = text.find('"', pos);
+		const size_t minPos = text.find(minKey, pos);
+		const size_t objectEnd = text.find('}', pos);
+		if(nameEnd == string::npos || minPos == string::npos || minPos > objectEnd)
+			return -1;
+
+		baseline[text.substr(pos, nameEnd - pos)] = atof(text.c_str() + minPos + sizeof(minKey) - 1);
+		pos = objectEnd;
+	}
+
+	return baseline.empty() ? -1 : 0;
+}
+
+// Write the results in the layout of Google Benchmark's JSON output
+// Returns 0 on success, -1 otherwise
+static int write_json(FILE *fp, const vector<CBenchResult> &results)
+{
+	char date[64];
+	time_t now = time(NULL);
+	strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+
+	fprintf(fp, "{\n  \"context\": {\n");
+	fprintf(fp, "    \"date\": \"%s\",\n", date);
+	fprintf(fp, "    \"num_cpus\": %d,\n", CThreadPool::hardware_thread_count());
+	fprintf(fp, "    \"assign_path\": \"%s\",\n", CAssignKernel::path_name(CAssignKernel::detect_path()));
+#ifdef NDEBUG
+	fprintf(fp, "    \"library_build_type\": \"release\"\n");
+#else
+	fprintf(fp, "    \"library_build_type\": \"debug\"\n");
+#endif
+	fprintf(fp, "  },\n  \"benchmarks\": [\n");
+
+	for(size_t i=0; i < results.size(); i++)
+	{
+		const CBenchResult &r = results[i];
+		fprintf(fp, "    {\n");
+		fprintf(fp, "      \"name\": \"%s\",\n", r.name.c_str());
+		fprintf(fp, "      \"stage\": \"%s\",\n", r.stage.c_str());
+		fprintf(fp, "      \"points\": %lld,\n", r.points);
+		fprintf(fp, "      \"clusters\": %d,\n", r.clusters);
+		fprintf(fp, "      \"dims\": %d,\n", r.dims);
+		fprintf(fp, "      \"threads\": %d,\n", r.threads);
+		fprintf(fp, "      \"iterations\": %d,\n", r.runs);
+		fprintf(fp, "      \"real_time\": %.6f,\n", r.meanMs);
+		fprintf(fp, "      \"min_time\": %.6f,\n", r.minMs);
+		fprintf(fp, "      \"time_unit\": \"ms\",\n");
+		fprintf(fp, "      \"items_per_second\": %.6e,\n", r.itemsPerSec);
+		fprintf(fp, "      \"bytes_per_second\": %.6e\n", r.bytesPerSec);
+		fprintf(fp, "    }%s\n", i + 1 < results.size() ? "," : "");
+	}
+
+	fprintf(fp, "  ]\n}\n");
+
+	return ferror(fp) ? -1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+	vector<long long> pointCounts;
+	vector<long long> clusterCounts;
+	vector<long long> dimCounts;
+	vector<long long> threadCounts;
+	bool runStage[numStages];
+	bool stageListed = false;
+	bool quick = false;
+	double minMs = 0.0;
+	double maxWork = KB_DEFAULT_MAX_WORK;
+	double tolerance = KB_DEFAULT_TOLERANCE;
+	const char *outputPath = NULL;
+	const char *baselinePath = NULL;
+
+	for(int s=0; s < numStages; s++)
+		runStage[s] = true;
+
+	for(int i=1; i < argc; i++)
+	{
+		if(i+1 < argc && !strcmp(argv[i], "-n"))
+		{
+			if(parse_list(argv[++i], pointCounts) < 0)
+			{
+				print_usage(argv[0]);
+				return 1;
+			}
+		}
+		else if(i+1 < argc && !strcmp(argv[i], "-k"))
+		{
+			if(parse_list(argv[++i], clusterCounts) < 0)
+			{
+				print_usage(argv[0]);
+				return 1;
+			}
+		}
+		else if(i+1 < argc && !strcmp(argv[i], "-d"))
+		{
+			if(parse_list(argv[++i], dimCounts) < 0)
+			{
+				print_usage(argv[0]);
+				return 1;
+			}
+		}
+		else if(i+1 < argc && !strcmp(argv[i], "-t"))
+		{
+			if(parse_list(argv[++i], threadCounts) < 0)
+			{
+				print_usage(argv[0]);
+				return 1;
+			}
+		}
+		else if(i+1 < argc && !strcmp(argv[i], "-s"))
+		{
+			// Only the listed stages run
+			char *list = argv[++i];
+			for(int s=0; s < numStages; s++)
+				runStage[s] = false;
+			stageListed = true;
+
+			for(char *name = strtok(list, ","); name; name = strtok(NULL, ","))
+			{
+				int s = 0;
+				while(s < numStages && strcmp(name, stageNames[s]))
+					s++;
+				if(s == numStages)
+				{
+					print_usage(argv[0]);
+					return 1;
+				}
+				runStage[s] = true;
+			}
+		}
+		else if(i+1 < argc && !strcmp(argv[i], "-m"))
+			minMs = atof(argv[++i]);
+		else if(i+1 < argc && !strcmp(argv[i], "-W"))
+			maxWork = atof(argv[++i]);
+		else if(i+1 < argc && !strcmp(argv[i], "-T"))
+			tolerance = atof(argv[++i]);
+		else if(i+1 < argc && !strcmp(argv[i], "-o"))
+			outputPath = argv[++i];
+		else if(i+1 < argc && !strcmp(argv[i], "-B"))
+			baselinePath = argv[++i];
+		else if(!strcmp(argv[i], "-q"))
+			quick = true;
+		else
+		{
+			print_usage(argv[0]);
+			return 1;
+		}
+	}
+
+	// The default sweeps; -q is small enough to run on every build
+	static const long long defaultPoints[] = { 1000, 100000, 1000000, 10000000, 100000000 };
+	static const long long defaultClusters[] = { 4, 16, 64, 256, 1024 };
+	static const long long quickPoints[] = { 10000, 100000, 1000000 };
+	static const long long quickClusters[] = { 4, 32 };
+	static const long long defaultDims[] = { 2, 4, 16, 32 };
+	static const long long quickDims[] = { 4, 32 };
+
+	if(pointCounts.empty())
+	{
+		if(quick)
+			pointCounts.assign(quickPoints, quickPoints + sizeof(quickPoints) / sizeof(quickPoints[0]));
+		else
+			pointCounts.assign(defaultPoints, defaultPoints + sizeof(defaultPoints) / sizeof(defaultPoints[0]));
+	}
+	if(clusterCounts.empty())
+	{
+		if(quick)
+			clusterCounts.assign(quickClusters, quickClusters + sizeof(quickClusters) / sizeof(quickClusters[0]));
+		else
+			clusterCounts.assign(defaultClusters, defaultClusters + sizeof(defaultClusters) / sizeof(defaultClusters[0]));
+	}
+	if(dimCounts.empty())
+	{
+		if(quick)
+			dimCounts.assign(quickDims, quickDims + sizeof(quickDims) / sizeof(quickDims[0]));
+		else
+			dimCounts.assign(defaultDims, defaultDims + sizeof(defaultDims) / sizeof(defaultDims[0]));
+	}
+	if(threadCounts.empty())
+	{
+		threadCounts.push_back(1);
+		if(!quick && CThreadPool::hardware_thread_count() > 1)
+			threadCounts.push_back(CThreadPool::hardware_thread_count());
+	}
+	if(minMs <= 0.0)
+		minMs = quick ? KB_QUICK_MIN_MS : KB_DEFAULT_MIN_MS;
+
+	for(size_t t=0; t < threadCounts.size(); t++)
+	{
+		if(!threadCounts[t])
+			threadCounts[t] = CThreadPool::hardware_thread_count();
+	}
+
+	for(size_t n=0; n < pointCounts.size(); n++)
+	{
+		if(pointCounts[n] < 1 || pointCounts[n] > INT_MAX)
+		{
+			print_usage(argv[0]);
+			return 1;
+		}
+	}
+
+	for(size_t k=0; k < clusterCounts.size(); k++)
+	{
+		if(clusterCounts[k] < 1 || clusterCounts[k] > INT_MAX)
+		{
+			print_usage(argv[0]);
+			return 1;
+		}
+	}
+
+	for(size_t d=0; d < dimCounts.size(); d++)
+	{
+		if(dimCounts[d] < 1 || dimCounts[d] > INT_MAX)
+		{
+			print_usage(argv[0]);
+			return 1;
+		}
+	}
+
+	map<string, double> baseline;
+	if(baselinePath && read_baseline(baselinePath, baseline) < 0)
+	{
+		fprintf(stderr, "Unable to read the baseline %s\n", baselinePath);
+		return 1;
+	}
+
+	if(stageListed && !quick && maxWork == KB_DEFAULT_MAX_WORK)
+		maxWork *= 10; // A hand picked list of stages can afford bigger cases
+
+	// A case must fit in half the memory, or it would measure the swap file
+	const double maxPointBytes = physical_memory() / 2;
+
+	vector<CBenchResult> results;
+	fprintf(stderr, "%-44s %6s %12s %12s %14s %12s\n", "case", "runs", "mean ms", "min ms", "points/s", "MB/s");
+
+	for(size_t n=0; n < pointCounts.size(); n++)
+	{
+		const int numPoints = (int)pointCounts[n];
+
+		if(maxPointBytes > 0.0 && numPoints * KB_BYTES_PER_POINT > maxPointBytes)
+		{
+			fprintf(stderr, "skipping N:%d, needs about %.1f GB, more than half the memory\n", numPoints,
+				numPoints * KB_BYTES_PER_POINT / 1e9);
+			continue;
+		}
+
+		for(size_t k=0; k < clusterCounts.size(); k++)
+		{
+			const int numClusters = (int)clusterCounts[k];
+
+			if((double)numPoints * numClusters > maxWork)
+			{
+				fprintf(stderr, "skipping N:%d/K:%d, more than %.3g points x clusters (-W)\n", numPoints, numClusters, maxWork);
+				continue;
+			}
+
+			CKMeans kMeans(numPoints, numClusters);
+			kMeans.set_seed(1);
+			kMeans.initialize_data();
+
+			// Every stage, and every run of an iteration, starts from the same clusters so the
+			// runs do the same work: left alone the clusters converge, and Hamerly's bounds
+			// prune more on every iteration
+			const vector<CDataPoint> startClusters = kMeans.get_clusters();
+
+			for(size_t t=0; t < threadCounts.size(); t++)
+			{
+				const int numThreads = (int)threadCounts[t];
+				kMeans.set_thread_count(numThreads);
+
+				for(int s=0; s < numStages; s++)
+				{
+					// assign_data() and compute_centroids() are single threaded
+					if(!runStage[s] || (s <= 1 && t > 0) || s >= firstFeatureStage)
+						continue;
+
+					CBenchResult result;
+					char name[128];
+					const int caseThreads = s <= 1 ? 1 : numThreads;
+					snprintf(name, sizeof(name), "%s/N:%d/K:%d/threads:%d", stageNames[s], numPoints, numClusters, caseThreads);
+					result.name = name;
+					result.stage = stageNames[s];
+					result.points = numPoints;
+					result.clusters = numClusters;
+					result.dims = 2;
+					result.threads = caseThreads;
+
+					// Bytes of point data a run streams per point: x and y, plus the label read
+					// or written, plus the Hamerly bound; seeding makes a pass per center added
+					// (k-means++) or per round (k-means||); rendering also reads the size, and generating
+					// writes every column
+					double bytesPerPoint = 12.0;
+					CRasterizer rasterizer;
+					CThreadPool renderPool(numThreads);
+					kMeans.get_clusters() = startClusters;
+
+					switch(s)
+					{
+					case 0:
+						time_case([&kMeans]{ kMeans.assign_data(); }, minMs, result);
+						break;
+					case 1:
+						// Sum points that are labeled, whether or not assign ran first
+						kMeans.assign_data();
+						time_case([&kMeans]{ kMeans.compute_centroids(); }, minMs, result);
+						break;
+					case 2:
+						kMeans.set_assign_mode(KM_MODE_LLOYD);
+						time_case([&]{ kMeans.get_clusters() = startClusters; kMeans.iterate(); }, minMs, result);
+						break;
+					case 3:
+						kMeans.set_assign_mode(KM_MODE_HAMERLY);
+						time_case([&]{ kMeans.get_clusters() = startClusters; kMeans.iterate(); }, minMs, result);
+						kMeans.set_assign_mode(KM_MODE_LLOYD);
+						bytesPerPoint = 16.0;
+						break;
+					case 4:
+						kMeans.set_seeding(KM_SEED_PLUSPLUS);
+						time_case([&kMeans]{ kMeans.seed_clusters(); }, minMs, result);
+						bytesPerPoint *= numClusters;
+						break;
+					case 5:
+						kMeans.set_seeding(KM_SEED_PARALLEL);
+						time_case([&kMeans]{ kMeans.seed_clusters(); }, minMs, result);
+						bytesPerPoint *= CS_PARALLEL_ROUNDS + 1;
+						break;
+					case 6:
+						// Label the points first so they're drawn in their clusters' colors
+						kMeans.assign_data();
+						time_case([&]{ rasterizer.draw_scene(kMeans.get_points(), kMeans.get_clusters(), &renderPool); }, minMs, result);
+						bytesPerPoint = 13.0;
+						break;
+					case 7:
+						{
+							CMixtureGenerator mixture(1);
+							CPointStore generated;
+							mixture.random_components(numClusters);
+							time_case([&]{ mixture.generate(generated, 0, numPoints, &renderPool); }, minMs, result);
+							bytesPerPoint = 16.0;
+						}
+						break;
+					case 8:
+						bytesPerPoint = time_typed<int16_t>(kMeans, startClusters, numThreads, minMs, result);
+						break;
+					case 9:
+						bytesPerPoint = time_typed<int32_t>(kMeans, startClusters, numThreads, minMs, result);
+						break;
+					case 10:
+						bytesPerPoint = time_typed<float>(kMeans, startClusters, numThreads, minMs, result);
+						break;
+					case 11:
+						bytesPerPoint = time_typed<double>(kMeans, startClusters, numThreads, minMs, result);
+						break;
+					case 12:
+						{
+							// Append 1% more points (more blobs) and remove them again, bringing the
+							// clusters up to date after each, so every run does the same work. The
+							// untimed first run labels the data set and converges it
+							const int batchPoints = numPoints / 100 + 1;
+							CBlobPointSource source(batchPoints, 2);
+							CPointStore arrivals;
+							source.read_batch(arrivals, batchPoints);
+							vector<int> added(arrivals.get_count());
+
+							time_case([&]
+							{
+								const int first = kMeans.get_num_points();
+								kMeans.append_points(arrivals);
+								kMeans.update_incremental();
+								for(size_t n=0; n < added.size(); n++)
+									added[n] = first + (int)n;
+								kMeans.remove_points(&added[0], (int)added.size());
+								kMeans.update_incremental();
+							}, minMs, result);
+							bytesPerPoint = 24.0 * arrivals.get_count() / numPoints;
+						}
+						break;
+					}
+
+					report(result, bytesPerPoint, results);
+				} // end FOR each stage
+			} // end FOR each thread count
+
+			for(size_t d=0; d < dimCounts.size(); d++)
+			{
+				const int numDims = (int)dimCounts[d];
+				if(!runStage[firstFeatureStage] && !runStage[firstFeatureStage + 1])
+					break;
+
+				if((double)numPoints * numClusters * numDims / 2 > maxWork || (double)numPoints * numDims > KB_MAX_FEATURE_VALUES)
+				{
+					fprintf(stderr, "skipping N:%d/K:%d/D:%d, too much work (-W) or memory\n", numPoints, numClusters, numDims);
+					continue;
+				}
+
+				CFeatureKMeans featureKMeans;
+				featureKMeans.get_features().generate(numPoints, numDims, numClusters, 1);
+				featureKMeans.create_clusters(numClusters);
+				featureKMeans.seed_clusters(KM_SEED_RANDOM, 1);
+
+				// As above, every run of an iteration starts from the same clusters
+				const vector<double> startCentroids(featureKMeans.get_centroid(0), featureKMeans.get_centroid(0) + (size_t)numClusters * numDims);
+
+				for(size_t t=0; t < threadCounts.size(); t++)
+				{
+					const int numThreads = (int)threadCounts[t];
+					featureKMeans.set_thread_count(numThreads);
+
+					for(int s=firstFeatureStage; s < numStages; s++)
+					{
+						if(!runStage[s])
+							continue;
+
+						CBenchResult result;
+						char name[128];
+						snprintf(name, sizeof(name), "%s/N:%d/K:%d/D:%d/threads:%d", stageNames[s], numPoints, numClusters, numDims, numThreads);
+						result.name = name;
+						result.stage = stageNames[s];
+						result.points = numPoints;
+						result.clusters = numClusters;
+						result.dims = numDims;
+						result.threads = numThreads;
+
+						featureKMeans.set_specialized(s == firstFeatureStage);
+						time_case([&]
+						{
+							copy(startCentroids.begin(), startCentroids.end(), featureKMeans.get_centroid(0));
+							featureKMeans.iterate();
+						}, minMs, result);
+
+						// Every point reads its features and reads and writes its label
+						report(result, numDims * 4.0 + 4.0, results);
+					} // end FOR each feature stage
+				} // end FOR each thread count
+			} // end FOR each dimensionality
+		} // end FOR each cluster count
+	} // end FOR each point count
+
+	FILE *fp = outputPath ? fopen(outputPath, "w") : stdout;
+	if(!fp || write_json(fp, results) < 0)
+	{
+		fprintf(stderr, "Unable to write the results to %s\n", outputPath ? outputPath : "stdout");
+		return 1;
+	}
+	if(outputPath)
+		fclose(fp);
+
+	if(!baselinePath)
+		return 0;
+
+	// Regression gate: compare the fastest runs, which are the least noisy
+	int regressions = 0;
+	int compared = 0;
+	for(size_t i=0; i < results.size(); i++)
+	{
+		map<string, double>::iterator base = baseline.find(results[i].name);
+		if(base == baseline.end() || base->second <= 0.0)
+			continue;
+
+		const double ratio = results[i].minMs / base->second;
+		compared++;
+		if(ratio > 1.0 + tolerance)
+		{
+			fprintf(stderr, "REGRESSION %s: %.3f ms against %.3f ms (%+.1f%%)\n", results[i].name.c_str(), results[i].minMs,
+				base->second, (ratio - 1.0) * 100.0);
+			regressions++;
+		}
+	} // end FOR each result
+
+	// A renamed stage or a changed sweep leaves baseline cases nothing compares against
+	int missing = 0;
+	for(map<string, double>::iterator base = baseline.begin(); base != baseline.end(); ++base)
+	{
+		size_t i = 0;
+		while(i < results.size() && results[i].name != base->first)
+			i++;
+		if(i == results.size())
+		{
+			fprintf(stderr, "MISSING %s: in %s but not run\n", base->first.c_str(), baselinePath);
+			missing++;
+		}
+	} // end FOR each baseline case
+
+	fprintf(stderr, "%d of %d cases compared against %s slower by more than %.0f%%", regressions, compared, baselinePath,
+		tolerance * 100.0);
+	if(missing)
+		fprintf(stderr, ", %d baseline cases not run", missing);
+	fprintf(stderr, "\n");
+
+	if(!compared)
+	{
+		fprintf(stderr, "No case matched the baseline %s, nothing was checked\n", baselinePath);
+		return 1;
+	}
+
+	return regressions ? 2 : 0;
+}
@@ -0,0 +1,537 @@
+// kMeansCli.cpp
+// Authored by Alex Shows
+// Released under the MIT License (http://opensource.org/licenses/mit-license.php)
+//
+// A headless command line driver for the CKMeans engine
+//
+// With -b the points are streamed through run_minibatch() in batches of that size
+// and never held in memory all at once, so -n can exceed what fits in RAM
+//
+// -f clusters the points of a binary point file (mapped, not read), -V verifies its
+// checksum first. -w saves the generated points to a point file and -o saves the
+// labels and clusters to a results file. -c clusters the rows of a CSV file,
+// taking x and y from the columns given by -C (0,1 by default). -r renders the
+// final plot to a PNG or PPM image, as a density heatmap when there are more points
+// than -L (0 always draws the points one by one). -d clusters Gaussian blobs of that
+// many dimensions with CFeatureKMeans instead, -r drawing their first two dimensions.
+// -g generates the points from a mixture of that many Gaussians laid out at random,
+// with -N of them spread uniformly as noise, in parallel and the same for a seed at
+// any thread count; with -b the mixture is streamed, so it can run to billions of points.
+// -x clusters the points with CTypedKMeans, its coordinates held in int16, int32,
+// float32 or float64 and its centroids never rounded to whole pixels. -u steps,points
+// then keeps the clustering up to date over a rolling window: every step appends that
+// many new points, retires as many at random and runs update_incremental(). -P records the engine's phases
+// and counters to a Chrome trace-event file, in a build with KMEANS_INSTRUMENT
+//
+// Usage: kmeans_cli [-n points] [-k clusters] [-i max iterations] [-e tolerance] [-s seed] [-t threads] [-m lloyd|hamerly] [-p scalar|avx2|avx512] [-S random|kmeans++|kmeans||] [-b batch size] [-f points file] [-V] [-c csv file] [-C x,y[,r,g,b] columns] [-w points file] [-o results file] [-r image.png|image.ppm] [-L lod points] [-d dims] [-g components] [-N noise fraction] [-x int16|int32|float32|float64] [-u steps,points] [-P trace file]
+
+#include "kMeans.h"
+#include "featureKMeans.h"
+#include "typedKMeans.h"
+#include "rasterizer.h"
+#include "instrument.h"
+#include "counterRng.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <chrono>
+
+static void print_usage(const char *exeName)
+{
+	printf("Usage: %s [-n points] [-k clusters] [-i max iterations] [-e tolerance] [-s seed] [-t threads] [-m lloyd|hamerly] [-p scalar|avx2|avx512] [-S random|kmeans++|kmeans||] [-b batch size] [-f points file] [-V] [-c csv file] [-C x,y[,r,g,b] columns] [-w points file] [-o results file] [-r image.png|image.ppm] [-L lod points] [-d dims] [-g components] [-N noise fraction] [-x int16|int32|float32|float64] [-u steps,points] [-P trace file]\n", exeName);
+}
+
+// Render points and clusters to a PNG, or a PPM if the path ends in .ppm
+// Returns 0 on success, -1 otherwise
+static int render_image(const char *imagePath, CPointStore &points, vector<CDataPoint> &clusters, const int numThreads,
+						const int lodThreshold)
+{
+	const size_t pathLength = strlen(imagePath);
+	const bool ppm = pathLength > 4 && !strcmp(imagePath + pathLength - 4, ".ppm");
+	CRasterizer rasterizer;
+	CThreadPool renderPool(numThreads);
+	rasterizer.set_lod_threshold(lodThreshold);
+
+	chrono::high_resolution_clock::time_point renderStart = chrono::high_resolution_clock::now();
+	rasterizer.draw_scene(points, clusters, &renderPool);
+	chrono::high_resolution_clock::time_point rendered = chrono::high_resolution_clock::now();
+
+	if((ppm ? rasterizer.write_ppm(imagePath) : rasterizer.write_png(imagePath)) < 0)
+	{
+		printf("Unable to write the image %s\n", imagePath);
+		return -1;
+	}
+
+	printf("rendered %s: draw %.3f ms, write %.3f ms\n", imagePath,
+		chrono::duration<double, milli>(rendered - renderStart).count(),
+		chrono::duration<double, milli>(chrono::high_resolution_clock::now() - rendered).count());
+
+	return 0;
+}
+
+// Cluster the points of kMeans with CTypedKMeans<T>, starting from kMeans' clusters, then
+// copy the labels and the clusters (rounded) back for saving and drawing
+// Returns the number of iterations run, the unrounded centroids in centroidX and centroidY
+template <typename T>
+static int run_typed(CKMeans &kMeans, const int numThreads, const int maxIterations, const double tolerance,
+					 vector<CIterationStats> &stats, vector<double> &centroidX, vector<double> &centroidY)
+{
+	CTypedKMeans<T> typedKMeans;
+	typedKMeans.set_thread_count(numThreads);
+
+	chrono::high_resolution_clock::time_point loadStart = chrono::high_resolution_clock::now();
+	typedKMeans.load(kMeans.get_points(), kMeans.get_clusters());
+	printf("precision %s: %d bytes per point, converted in %.3f ms\n", CTypedKMeans<T>::type_name(), (int)(2 * sizeof(T)),
+		chrono::duration<double, milli>(chrono::high_resolution_clock::now() - loadStart).count());
+
+	int iterations = typedKMeans.run_until_converged(maxIterations, tolerance, &stats);
+
+	const int count = typedKMeans.get_count();
+	if(count)
+		memcpy(kMeans.get_points().get_label(), typedKMeans.get_labels(), count * sizeof(int));
+	typedKMeans.get_clusters(kMeans.get_clusters());
+
+	for(int j=0; j < typedKMeans.get_num_clusters(); j++)
+	{
+		centroidX.push_back(typedKMeans.get_centroid_x(j));
+		centroidY.push_back(typedKMeans.get_centroid_y(j));
+	}
+
+	return iterations;
+}
+
+int main(int argc, char *argv[])
+{
+	long long numPoints = KM_DEFAULT_POINTS;
+	int numClusters = KM_DEFAULT_CLUSTERS;
+	int numIterations = KM_DEFAULT_MAX_ITERATIONS;
+	double tolerance = KM_DEFAULT_TOLERANCE;
+	unsigned int seed = 1;
+	int assignPath = AK_PATH_AUTO;
+	int numThreads = 0; // every core
+	int assignMode = KM_MODE_LLOYD;
+	int seeding = KM_SEED_RANDOM;
+	int batchSize = 0; // whole data set in memory
+	bool verifyFile = false;
+	const char *inputPath = NULL;
+	const char *pointsPath = NULL;
+	const char *resultsPath = NULL;
+	const char *csvPath = NULL;
+	const char *imagePath = NULL;
+	int lodThreshold = DM_DEFAULT_LOD_POINTS;
+	const char *tracePath = NULL;
+	int numDims = 0; // two dimensional points of CKMeans
+	int numComponents = 0; // quadrant blobs of initialize_data()
+	double noiseFraction = 0.0;
+	const char *precision = NULL; // int coordinates and whole pixel clusters of CKMeans
+	int updateSteps = 0; // no rolling window
+	int updatePoints = 0;
+	int csvColumns[5] = { 0, 1, CR_NO_COLUMN, CR_NO_COLUMN, CR_NO_COLUMN };
+
+	for(int i=1; i < argc; i++)
+	{
+		if(i+1 < argc && !strcmp(argv[i], "-n"))
+			numPoints = strtoll(argv[++i], NULL, 10);
+		else if(i+1 < argc && !strcmp(argv[i], "-k"))
+			numClusters = atoi(argv[++i]);
+		else if(i+1 < argc && !strcmp(argv[i], "-i"))
+			numIterations = atoi(argv[++i]);
+		else if(i+1 < argc && !strcmp(argv[i], "-e"))
+			tolerance = atof(argv[++i]);
+		else if(i+1 < argc && !strcmp(argv[i], "-s"))
+			seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+		else if(i+1 < argc && !strcmp(argv[i], "-t"))
+			numThreads = atoi(argv[++i]);
+		else if(i+1 < argc && !strcmp(argv[i], "-m"))
+		{
+			i++;
+			if(!strcmp(argv[i], "lloyd"))
+				assignMode = KM_MODE_LLOYD;
+			else if(!strcmp(argv[i], "hamerly"))
+				assignMode = KM_MODE_HAMERLY;
+			else
+			{
+				print_usage(argv[0]);
+				return 1;
+			}
+		}
+		else if(i+1 < argc && !strcmp(argv[i], "-p"))
+		{
+			i++;
+			if(!strcmp(argv[i], "scalar"))
+				assignPath = AK_PATH_SCALAR;
+			else if(!strcmp(argv[i], "avx2"))
+				assignPath = AK_PATH_AVX2;
+			else if(!strcmp(argv[i], "avx512"))
+				assignPath = AK_PATH_AVX512;
+			else
+			{
+				print_usage(argv[0]);
+				return 1;
+			}
+		}
+		else if(i+1 < argc && !strcmp(argv[i], "-f"))
+			inputPath = argv[++i];
+		else if(i+1 < argc && !strcmp(argv[i], "-r"))
+			imagePath = argv[++i];
+		else if(i+1 < argc && !strcmp(argv[i], "-L"))
+			lodThreshold = atoi(argv[++i]);
+		else if(i+1 < argc && !strcmp(argv[i], "-d"))
+			numDims = atoi(argv[++i]);
+		else if(i+1 < argc && !strcmp(argv[i], "-g"))
+			numComponents = atoi(argv[++i]);
+		else if(i+1 < argc && !strcmp(argv[i], "-N"))
+			noiseFraction = atof(argv[++i]);
+		else if(i+1 < argc && !strcmp(argv[i], "-x"))
+		{
+			precision = argv[++i];
+			if(strcmp(precision, "int16") && strcmp(precision, "int32") && strcmp(precision, "float32") && strcmp(precision, "float64"))
+			{
+				print_usage(argv[0]);
+				return 1;
+			}
+		}
+		else if(i+1 < argc && !strcmp(argv[i], "-u"))
+		{
+			if(sscanf(argv[++i], "%d,%d", &updateSteps, &updatePoints) != 2)
+			{
+				print_usage(argv[0]);
+				return 1;
+			}
+		}
+		else if(i+1 < argc && !strcmp(argv[i], "-P"))
+			tracePath = argv[++i];
+		else if(i+1 < argc && !strcmp(argv[i], "-c"))
+			csvPath = argv[++i];
+		else if(i+1 < argc && !strcmp(argv[i], "-C"))
+		{
+			int parsed = sscanf(argv[++i], "%d,%d,%d,%d,%d", &csvColumns[0], &csvColumns[1], &csvColumns[2], &csvColumns[3], &csvColumns[4]);
+			if(parsed != 2 && parsed != 5)
+			{
+				print_usage(argv[0]);
+				return 1;
+			}
+		}
+		else if(!strcmp(argv[i], "-V"))
+			verifyFile = true;
+		else if(i+1 < argc && !strcmp(argv[i], "-w"))
+			pointsPath = argv[++i];
+		else if(i+1 < argc && !strcmp(argv[i], "-o"))
+			resultsPath = argv[++i];
+		else if(i+1 < argc && !strcmp(argv[i], "-b"))
+			batchSize = atoi(argv[++i]);
+		else if(i+1 < argc && !strcmp(argv[i], "-S"))
+		{
+			i++;
+			if(!strcmp(argv[i], "random"))
+				seeding = KM_SEED_RANDOM;
+			else if(!strcmp(argv[i], "kmeans++"))
+				seeding = KM_SEED_PLUSPLUS;
+			else if(!strcmp(argv[i], "kmeans||"))
+				seeding = KM_SEED_PARALLEL;
+			else
+			{
+				print_usage(argv[0]);
+				return 1;
+			}
+		}
+		else
+		{
+			print_usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if(numPoints < 1 || numClusters < 1 || numIterations < 0 || batchSize < 0 || lodThreshold < 0 || (!batchSize && numPoints > INT_MAX) ||
+	   (batchSize && (inputPath || csvPath || pointsPath || resultsPath || imagePath)) || (inputPath && csvPath) || numDims < 0 ||
+	   (numDims && (batchSize || inputPath || csvPath || pointsPath || resultsPath || assignMode != KM_MODE_LLOYD || seeding == KM_SEED_PARALLEL)) ||
+	   numComponents < 0 || !(noiseFraction >= 0.0 && noiseFraction <= 1.0) || (noiseFraction > 0.0 && !numComponents) ||
+	   (numComponents && (inputPath || csvPath || numDims)) || (precision && (batchSize || numDims || assignMode != KM_MODE_LLOYD)) ||
+	   updateSteps < 0 || (updateSteps && (updatePoints < 1 || batchSize || numDims || precision)))
+	{
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	if(tracePath)
+	{
+		if(!CInstrument::compiled_in())
+		{
+			printf("-P needs a build with KMEANS_INSTRUMENT defined (cmake -DKMEANS_INSTRUMENT=ON)\n");
+			return 1;
+		}
+		CInstrument::instance().start();
+	}
+
+	CKMeans kMeans((int)(numPoints < INT_MAX ? numPoints : INT_MAX), numClusters);
+	kMeans.set_seed(seed);
+	if(kMeans.set_assign_path(assignPath) < 0)
+	{
+		printf("The %s assignment path is not supported on this CPU\n", CAssignKernel::path_name(assignPath));
+		return 1;
+	}
+	kMeans.set_thread_count(numThreads);
+	kMeans.set_assign_mode(assignMode);
+
+	static const char *seedingNames[] = { "random", "kmeans++", "kmeans||" };
+	vector<CIterationStats> stats;
+	vector<double> typedX, typedY; // Unrounded centroids of -x
+
+	if(batchSize)
+	{
+		// The clusters are created and seeded from the first batch
+		CBlobPointSource blobSource(numPoints, seed);
+		CMixtureGenerator mixture(seed);
+		CThreadPool generatePool(numComponents ? numThreads : 1);
+		CMixturePointSource mixtureSource(mixture, numPoints, &generatePool);
+		CPointSource &source = numComponents ? (CPointSource&)mixtureSource : (CPointSource&)blobSource;
+		kMeans.set_seeding(seeding);
+
+		if(numComponents)
+		{
+			mixture.random_components(numComponents);
+			mixture.set_noise(noiseFraction);
+			printf("mixture of %d components, %.1f%% noise\n", numComponents, noiseFraction * 100.0);
+		}
+
+		printf("points=%lld clusters=%d batch=%d max batches=%d seed=%u threads=%d path=%s seeding=%s\n", numPoints, numClusters,
+			batchSize, numIterations, seed, kMeans.get_thread_count(), CAssignKernel::path_name(kMeans.get_assign_path()),
+			seedingNames[seeding]);
+
+		int batches = kMeans.run_minibatch(source, batchSize, numIterations, tolerance, &stats);
+		if(batches < 0)
+		{
+			printf("Unable to allocate a batch of %d points\n", batchSize);
+			return 1;
+		}
+
+		for(vector<CIterationStats>::iterator it = stats.begin(); it != stats.end(); ++it)
+			printf("batch %d: %d points, inertia %.6g, shift %.3f, assign %.3f ms, update %.3f ms\n",
+				it->iteration, it->labelChanges, it->inertia, it->centroidShift, it->assignMs, it->updateMs);
+
+		printf("finished after %d batches\n", batches);
+	}
+	else if(numDims)
+	{
+		CFeatureKMeans featureKMeans;
+		featureKMeans.set_thread_count(numThreads);
+
+		chrono::high_resolution_clock::time_point generateStart = chrono::high_resolution_clock::now();
+		if(featureKMeans.get_features().generate((int)numPoints, numDims, numClusters, seed) < 0 ||
+		   featureKMeans.create_clusters(numClusters) < 0)
+		{
+			printf("Unable to generate %lld points of %d dimensions\n", numPoints, numDims);
+			return 1;
+		}
+		chrono::high_resolution_clock::time_point seedStart = chrono::high_resolution_clock::now();
+		featureKMeans.seed_clusters(seeding, seed);
+		chrono::high_resolution_clock::time_point seeded = chrono::high_resolution_clock::now();
+
+		printf("points=%lld dims=%d clusters=%d iterations=%d seed=%u threads=%d kernel=%s\n", numPoints, numDims, numClusters,
+			numIterations, seed, featureKMeans.get_thread_count(), feature_kernel(numDims) == feature_assign<0> ? "runtime" : "specialized");
+		printf("generated in %.3f ms, seeding %s: %.3f ms\n", chrono::duration<double, milli>(seedStart - generateStart).count(),
+			seedingNames[seeding], chrono::duration<double, milli>(seeded - seedStart).count());
+
+		int iterations = featureKMeans.run_until_converged(numIterations, tolerance, &stats);
+
+		for(vector<CIterationStats>::iterator it = stats.begin(); it != stats.end(); ++it)
+			printf("iteration %d: %d labels changed, inertia %.6g, shift %.3f, assign %.3f ms, update %.3f ms\n",
+				it->iteration, it->labelChanges, it->inertia, it->centroidShift, it->assignMs, it->updateMs);
+
+		bool converged = !stats.empty() && (!stats.back().labelChanges || stats.back().centroidShift <= tolerance);
+		printf("%s after %d iterations\n", converged ? "converged" : "stopped", iterations);
+
+		if(imagePath)
+		{
+			CPointStore projected;
+			vector<CDataPoint> projectedClusters;
+			if(featureKMeans.project(projected, projectedClusters, 0, numDims > 1 ? 1 : 0) < 0)
+			{
+				printf("Unable to project the points\n");
+				return 1;
+			}
+			if(render_image(imagePath, projected, projectedClusters, numThreads, lodThreshold) < 0)
+				return 1;
+		}
+
+		for(int j=0; j < featureKMeans.get_num_clusters(); j++)
+		{
+			const double *centroid = featureKMeans.get_centroid(j);
+			printf("cluster %d:", j);
+			for(int d=0; d < numDims; d++)
+				printf(" %.3f", centroid[d]);
+			printf("\n");
+		}
+	}
+	else
+	{
+		CPointFile inputFile;
+		CMixtureGenerator mixture(seed);
+		if(inputPath)
+		{
+			chrono::high_resolution_clock::time_point loadStart = chrono::high_resolution_clock::now();
+			if(inputFile.open(inputPath, verifyFile) < 0 || kMeans.load_points(inputFile) < 0)
+			{
+				printf("Unable to load the point file %s\n", inputPath);
+				return 1;
+			}
+			numPoints = kMeans.get_num_points();
+			printf("loaded %lld points from %s in %.3f ms\n", numPoints, inputPath,
+				chrono::duration<double, milli>(chrono::high_resolution_clock::now() - loadStart).count());
+		}
+		else if(csvPath)
+		{
+			CCsvReader reader;
+			chrono::high_resolution_clock::time_point loadStart = chrono::high_resolution_clock::now();
+			if(reader.set_columns(csvColumns[0], csvColumns[1], csvColumns[2], csvColumns[3], csvColumns[4]) < 0 ||
+			   kMeans.load_csv(reader, csvPath) < 0)
+			{
+				printf("Unable to load the CSV file %s\n", csvPath);
+				return 1;
+			}
+			numPoints = kMeans.get_num_points();
+			printf("loaded %lld rows from %s in %.3f ms, %lld rejected%s\n", numPoints, csvPath,
+				chrono::duration<double, milli>(chrono::high_resolution_clock::now() - loadStart).count(),
+				reader.get_rejected_rows(), reader.get_header_skipped() ? ", header skipped" : "");
+		}
+		else if(numComponents)
+		{
+			mixture.random_components(numComponents);
+			mixture.set_noise(noiseFraction);
+
+			chrono::high_resolution_clock::time_point generateStart = chrono::high_resolution_clock::now();
+			if(kMeans.load_mixture(mixture, (int)numPoints) < 0)
+			{
+				printf("Unable to generate %lld points\n", numPoints);
+				return 1;
+			}
+			printf("generated %lld points from %d components, %.1f%% noise, in %.3f ms\n", numPoints, numComponents, noiseFraction * 100.0,
+				chrono::duration<double, milli>(chrono::high_resolution_clock::now() - generateStart).count());
+		}
+		else
+			kMeans.initialize_data();
+
+		if(pointsPath && CPointFile::write_points(pointsPath, kMeans.get_points()) < 0)
+		{
+			printf("Unable to write the point file %s\n", pointsPath);
+			return 1;
+		}
+
+		// Seed separately from the data generation so the seeding can be timed on its own
+		kMeans.set_seeding(seeding);
+		chrono::high_resolution_clock::time_point seedStart = chrono::high_resolution_clock::now();
+		if(seeding != KM_SEED_RANDOM)
+			kMeans.seed_clusters();
+		double seedMs = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - seedStart).count();
+
+		printf("points=%lld clusters=%d iterations=%d seed=%u threads=%d path=%s\n", numPoints, numClusters, numIterations, seed,
+			kMeans.get_thread_count(), CAssignKernel::path_name(kMeans.get_assign_path()));
+		printf("seeding %s: %.3f ms\n", seedingNames[seeding], seedMs);
+
+		int iterations;
+		if(!precision)
+			iterations = kMeans.run_until_converged(numIterations, tolerance, &stats);
+		else if(!strcmp(precision, "int16"))
+			iterations = run_typed<int16_t>(kMeans, numThreads, numIterations, tolerance, stats, typedX, typedY);
+		else if(!strcmp(precision, "int32"))
+			iterations = run_typed<int32_t>(kMeans, numThreads, numIterations, tolerance, stats, typedX, typedY);
+		else if(!strcmp(precision, "float32"))
+			iterations = run_typed<float>(kMeans, numThreads, numIterations, tolerance, stats, typedX, typedY);
+		else
+			iterations = run_typed<double>(kMeans, numThreads, numIterations, tolerance, stats, typedX, typedY);
+
+		for(vector<CIterationStats>::iterator it = stats.begin(); it != stats.end(); ++it)
+			printf("iteration %d: %d labels changed, inertia %.6g, shift %.3f, pruned %.1f%%, assign %.3f ms, update %.3f ms\n",
+				it->iteration, it->labelChanges, it->inertia, it->centroidShift, it->pruneRate * 100.0, it->assignMs, it->updateMs);
+
+		bool converged = !stats.empty() && (!stats.back().labelChanges || stats.back().centroidShift <= tolerance);
+		printf("%s after %d iterations\n", converged ? "converged" : "stopped", iterations);
+
+		if(updateSteps)
+		{
+			// A rolling window: every step brings in updatePoints new points (the mixture
+			// carrying on past the points generated, or more blobs) and retires as many
+			// picked at random, then brings the clusters up to date from where they are
+			CPointStore arrivals;
+			CBlobPointSource blobArrivals((long long)updateSteps * updatePoints, seed + 1);
+			vector<int> retired(updatePoints);
+			vector<CIterationStats> updateStats;
+
+			for(int step=0; step < updateSteps; step++)
+			{
+				chrono::high_resolution_clock::time_point stepStart = chrono::high_resolution_clock::now();
+
+				const int arrived = numComponents ? mixture.generate(arrivals, numPoints + (long long)step * updatePoints, updatePoints) :
+													blobArrivals.read_batch(arrivals, updatePoints);
+				if(arrived < 0 || kMeans.append_points(arrivals) < 0)
+				{
+					printf("Unable to append %d points\n", updatePoints);
+					return 1;
+				}
+
+				// Stream 0 of the seed picks the points retired
+				for(int n=0; n < updatePoints; n++)
+					retired[n] = (int)CCounterRng::below(seed, 0, (unsigned long long)step * updatePoints + n, kMeans.get_num_points());
+				const int removed = kMeans.remove_points(&retired[0], updatePoints);
+
+				updateStats.clear();
+				const int steps = kMeans.update_incremental(numIterations, tolerance, &updateStats);
+
+				long long evals = 0;
+				int changed = 0;
+				for(vector<CIterationStats>::iterator it = updateStats.begin(); it != updateStats.end(); ++it)
+				{
+					evals += it->distanceEvals;
+					changed += it->labelChanges;
+				}
+
+				printf("update %d: +%d -%d points, %d iterations, %d labels changed, %lld distances (%.2f%% of a pass), inertia %.6g, %.3f ms\n",
+					step, arrived, removed, steps, changed, evals,
+					100.0 * evals / ((double)kMeans.get_num_points() * kMeans.get_num_clusters()),
+					updateStats.empty() ? 0.0 : updateStats.back().inertia,
+					chrono::duration<double, milli>(chrono::high_resolution_clock::now() - stepStart).count());
+			} // end FOR each update
+
+			printf("points=%d, a full assignment changes %d labels\n", kMeans.get_num_points(), kMeans.assign_data());
+		}
+
+		if(resultsPath && CPointFile::write_results(resultsPath, kMeans.get_points(), kMeans.get_clusters()) < 0)
+		{
+			printf("Unable to write the results file %s\n", resultsPath);
+			return 1;
+		}
+
+		if(imagePath && render_image(imagePath, kMeans.get_points(), kMeans.get_clusters(), numThreads, lodThreshold) < 0)
+			return 1;
+	}
+
+	if(precision)
+	{
+		for(size_t j=0; j < typedX.size(); j++)
+			printf("cluster %d: x=%.3f y=%.3f\n", (int)j, typedX[j], typedY[j]);
+	}
+	else if(!numDims)
+	{
+		vector<CDataPoint> &vClusters = kMeans.get_clusters();
+		for(vector<CDataPoint>::iterator cIt = vClusters.begin(); cIt != vClusters.end(); ++cIt)
+			printf("cluster %d: x=%d y=%d\n", (int)(cIt - vClusters.begin()), cIt->get_x(), cIt->get_y());
+	}
+
+	if(tracePath)
+	{
+		map<string, long long> counters;
+		CInstrument::instance().get_counters(counters);
+		for(map<string, long long>::iterator it = counters.begin(); it != counters.end(); ++it)
+			printf("counter %s: %lld\n", it->first.c_str(), it->second);
+
+		CInstrument::instance().stop();
+		if(CInstrument::instance().write_trace(tracePath) < 0)
+		{
+			printf("Unable to write the trace %s\n", tracePath);
+			return 1;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,191 @@
+// kMeansWorker.cpp
+// Authored by Alex Shows
+// Released under the MIT License (http://opensource.org/licenses/mit-license.php)
+//
+// Implementation of the CKMeansWorker class
+// Runs a CKMeans engine off the UI thread and publishes snapshots of it
+
+#include "kMeansWorker.h"
+#include "instrument.h"
+#include <string.h>
+
+CKMeansWorker::CKMeansWorker(CKMeans &kMeans) : engine(kMeans)
+{
+	running = false;
+	autoRun = false;
+	quitting = false;
+	generation = 1;
+	sequence = 0;
+	published = 0;
+	iterations = 0;
+	labelChanges = 0;
+	converged = false;
+}
+
+CKMeansWorker::~CKMeansWorker()
+{
+	stop();
+}
+
+// Start the worker thread, which publishes a snapshot of the engine as it stands and
+// then waits for jobs. notifyFunc is called on the worker thread after every snapshot
+// Returns 0 on success, -1 if the worker is already running
+int CKMeansWorker::start(const function<void ()> &notifyFunc)
+{
+	if(worker.joinable())
+		return -1;
+
+	notify = notifyFunc;
+	quitting = false;
+	worker = thread(&CKMeansWorker::worker_loop, this);
+
+	return 0;
+}
+
+// Stop the worker once the job in progress finishes, dropping any still waiting
+void CKMeansWorker::stop()
+{
+	if(!worker.joinable())
+		return;
+
+	{
+		lock_guard<mutex> lock(jobLock);
+		quitting = true;
+		jobs.clear();
+	}
+	jobReady.notify_one();
+	worker.join();
+}
+
+// Queue job to run against the engine. Set newData if it replaces the data set, so
+// the next snapshot carries the new points
+// Returns the number of jobs waiting, including this one
+int CKMeansWorker::post(const function<void (CKMeans&)> &job, const bool newData)
+{
+	CJob entry;
+	entry.run = job;
+	entry.newData = newData;
+
+	int waiting;
+	{
+		lock_guard<mutex> lock(jobLock);
+		jobs.push_back(entry);
+		waiting = (int)jobs.size();
+	}
+	jobReady.notify_one();
+
+	return waiting;
+}
+
+// Queue one iteration, counted in the snapshots (unlike an iterate() job)
+// Returns the number of jobs waiting, including this one
+int CKMeansWorker::post_iterate()
+{
+	return post([this](CKMeans&){ run_iteration(); });
+}
+
+// Turn auto-run on or off. Turning it off lets the iteration in progress finish
+void CKMeansWorker::set_auto_run(const bool run)
+{
+	{
+		lock_guard<mutex> lock(jobLock);
+		autoRun = run;
+	}
+	jobReady.notify_one();
+}
+
+// Run one iteration on the worker thread and keep count
+void CKMeansWorker::run_iteration()
+{
+	CIterationStats stats;
+	labelChanges = engine.iterate(&stats);
+	converged = labelChanges == 0;
+	iterations++;
+}
+
+// Copy the engine's state into the back snapshot and publish it
+void CKMeansWorker::publish()
+{
+	KI_SCOPE("publish");
+
+	CClusterSnapshot &snapshot = snapshots.get_back();
+	CPointStore &points = engine.get_points();
+	CPointStore &copy = snapshot.points;
+	const int numPoints = points.get_count();
+
+	if(snapshot.generation != generation || copy.get_count() != numPoints)
+	{
+		copy.clear();
+		if(copy.resize(numPoints) == numPoints && numPoints > 0)
+		{
+			memcpy(copy.get_x(), points.get_x(), numPoints * sizeof(int));
+			memcpy(copy.get_y(), points.get_y(), numPoints * sizeof(int));
+			memcpy(copy.get_size(), points.get_size(), numPoints);
+			memcpy(copy.get_r(), points.get_r(), numPoints);
+			memcpy(copy.get_g(), points.get_g(), numPoints);
+			memcpy(copy.get_b(), points.get_b(), numPoints);
+		}
+	}
+
+	if(copy.get_count() == numPoints && numPoints > 0)
+		memcpy(copy.get_label(), points.get_label(), numPoints * sizeof(int));
+
+	snapshot.clusters = engine.get_clusters();
+	snapshot.generation = generation;
+	snapshot.sequence = sequence++;
+	snapshot.iterations = iterations;
+	snapshot.labelChanges = labelChanges;
+	snapshot.converged = converged;
+	snapshots.publish();
+	published.store(sequence);
+
+	if(notify)
+		notify();
+}
+
+// Publish the starting state, then run jobs as they're posted, and iterate between
+// them in auto-run mode, until told to stop
+void CKMeansWorker::worker_loop()
+{
+	publish();
+
+	for(;;)
+	{
+		CJob job;
+		bool haveJob = false;
+		{
+			unique_lock<mutex> lock(jobLock);
+			jobReady.wait(lock, [this]{ return quitting || !jobs.empty() || (autoRun && !converged); });
+			if(quitting)
+				return;
+
+			if(!jobs.empty())
+			{
+				job = jobs.front();
+				jobs.pop_front();
+				haveJob = true;
+			}
+			running = true;
+		}
+
+		if(haveJob)
+		{
+			// Whatever the job does, the clusters may have somewhere to go again
+			converged = false;
+			job.run(engine);
+			if(job.newData)
+			{
+				generation++;
+				iterations = 0;
+				labelChanges = 0;
+			}
+		}
+		else
+			run_iteration();
+
+		publish();
+
+		lock_guard<mutex> lock(jobLock);
+		running = false;
+	} // end FOR each job
+}
@@ -0,0 +1,93 @@
+// kMeansWorker.h
+// Authored by Alex Shows
+// Released under the MIT License (http://opensource.org/licenses/mit-license.php)
+//
+// Header declaring the CKMeansWorker class
+//
+// Runs a CKMeans engine on a thread of its own, so a UI never blocks on it. The UI
+// posts jobs (a function run against the engine: iterate, reseed, regenerate...),
+// which the worker runs in order. After each job the worker publishes an immutable
+// snapshot of the points and clusters through a lock-free triple buffer and calls
+// the notify function passed to start(), e.g. to post the window a repaint message.
+// The UI acquires the latest snapshot when it paints and draws from it while the
+// engine carries on; it never touches the engine itself while the worker runs
+//
+// In auto-run mode the worker keeps iterating whenever it has no job waiting, until
+// an iteration changes no labels, publishing a snapshot after every iteration. The
+// triple buffer lets the UI draw at its own pace: it gets the latest snapshot and
+// the ones in between are simply dropped. Any job restarts a converged auto-run
+//
+// The positions and colors of the points only change when a job makes a new data
+// set (post() with newData), so they are copied into a snapshot slot only when the
+// slot last held an older data set; the labels are copied every time
+
+#pragma once
+
+#include "kMeans.h"
+#include "tripleBuffer.h"
+#include <deque>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+using namespace std;
+
+// The state of the engine after a job, for drawing
+struct CClusterSnapshot
+{
+	CClusterSnapshot() : generation(0), sequence(0), iterations(0), labelChanges(0), converged(false) {};
+	CPointStore points; // Positions, sizes and colors of the data set, and the labels
+	vector<CDataPoint> clusters; // Cluster positions and colors
+	unsigned int generation; // Data set the points belong to, incremented by every new one
+	unsigned int sequence; // Number of snapshots published before this one
+	int iterations; // Iterations run by the worker on this data set
+	int labelChanges; // Labels changed by the last of those iterations
+	bool converged; // Whether the last iteration changed no labels
+};
+
+class CKMeansWorker
+{
+public:
+	CKMeansWorker(CKMeans &kMeans);
+	~CKMeansWorker();
+	int start(const function<void ()> &notifyFunc);
+	void stop();
+	int post(const function<void (CKMeans&)> &job, const bool newData = false);
+	int post_iterate();
+	void set_auto_run(const bool run);
+	bool get_auto_run(){ lock_guard<mutex> lock(jobLock); return autoRun;};
+	unsigned int get_published(){ return published.load();};
+	bool acquire(){ return snapshots.acquire();};
+	CClusterSnapshot& get_snapshot(){ return snapshots.get_front();};
+	int get_pending(){ lock_guard<mutex> lock(jobLock); return (int)jobs.size() + (running ? 1 : 0);};
+private:
+	// Not copyable, the thread is owned
+	CKMeansWorker(const CKMeansWorker&);
+	CKMeansWorker& operator=(const CKMeansWorker&);
+	// A job and whether it makes a new data set
+	struct CJob
+	{
+		function<void (CKMeans&)> run;
+		bool newData;
+	};
+	void worker_loop();
+	void run_iteration();
+	void publish();
+	CKMeans &engine; // Engine the jobs run against, only touched by the worker thread once started
+	thread worker; // Thread running the jobs
+	mutex jobLock; // Guards jobs, running, autoRun and quitting
+	condition_variable jobReady; // Signaled when a job is posted or the worker should quit
+	deque<CJob> jobs; // Jobs waiting to run, oldest first
+	bool running; // Whether the worker is in the middle of a job
+	bool autoRun; // Whether to iterate while there are no jobs
+	bool quitting; // Set to stop the worker after the job in progress
+	function<void ()> notify; // Called from the worker thread after each snapshot is published
+	CTripleBuffer<CClusterSnapshot> snapshots; // Snapshots handed from the worker to the UI
+	unsigned int generation; // Data set the engine holds
+	unsigned int sequence; // Snapshots published so far
+	atomic<unsigned int> published; // Copy of sequence the UI can read
+	int iterations; // Iterations run on the data set, by post_iterate() or auto-run
+	int labelChanges; // Labels changed by the last iteration
+	bool converged; // Whether the last iteration changed no labels, only touched by the worker thread
+};
@@ -0,0 +1,255 @@
+// mixtureGenerator.cpp
+// Authored by Alex Shows
+// Released under the MIT License (http://opensource.org/licenses/mit-license.php)
+//
+// Implementation of the CMixtureGenerator and CMixturePointSource classes
+// Reproducible Gaussian mixture data sets, generated in parallel
+
+#include "mixtureGenerator.h"
+#include "counterRng.h"
+#include "dataPoint.h"
+#include "instrument.h"
+#include <math.h>
+
+// Streams of CCounterRng used by the generator
+#define MG_STREAM_COMPONENT 0 // Noise or component of each point, counter is the point index
+#define MG_STREAM_NORMAL 1 // Two per point (normals, or the noise position), counter is twice the point index
+#define MG_STREAM_COLOR 2 // Color of each point, counter is the point index
+#define MG_STREAM_LAYOUT 3 // random_components(), counter is the component * 8 + the quantity drawn
+
+#define MG_TWO_PI 6.283185307179586
+
+CMixtureGenerator::CMixtureGenerator(const unsigned long long seedVal)
+{
+	seed = seedVal;
+	noise = 0.0;
+}
+
+CMixtureGenerator::~CMixtureGenerator()
+{
+}
+
+// Add a Gaussian centered on meanX, meanY with covariance [varX covXY; covXY varY],
+// drawing weight shares of the points not drawn as noise
+// Returns the index of the component, -1 if the covariance isn't positive definite or
+// the weight isn't positive
+int CMixtureGenerator::add_component(const double meanX, const double meanY, const double varX, const double varY,
+									 const double covXY, const double weight)
+{
+	if(!(varX > 0.0) || !(varY > 0.0) || varX * varY - covXY * covXY <= 0.0 || !(weight > 0.0))
+		return -1;
+
+	CMixtureComponent component;
+	component.meanX = meanX;
+	component.meanY = meanY;
+	component.varX = varX;
+	component.varY = varY;
+	component.covXY = covXY;
+	component.weight = weight;
+	component.cholXX = sqrt(varX);
+	component.cholYX = covXY / component.cholXX;
+	component.cholYY = sqrt(varY - component.cholYX * component.cholYX);
+	components.push_back(component);
+
+	// Keep the running sums normalized so component_of() can search them directly
+	double total = 0.0;
+	cumulative.resize(components.size());
+	for(size_t c=0; c < components.size(); c++)
+	{
+		total += components[c].weight;
+		cumulative[c] = total;
+	}
+	for(size_t c=0; c < cumulative.size(); c++)
+		cumulative[c] /= total;
+
+	return (int)components.size() - 1;
+}
+
+// Replace the components with numComponents laid out at random from the seed: centers
+// uniform over the middle 80% of the bounds, standard deviations between MG_MIN_SPREAD
+// and MG_MAX_SPREAD along axes at a random angle, weights between 0.5 and 1.5
+// Returns the number of components, -1 if numComponents isn't positive
+int CMixtureGenerator::random_components(const int numComponents)
+{
+	if(numComponents < 1)
+		return -1;
+
+	const double rangeX = CDP_X_UPPER_BOUND - CDP_X_LOWER_BOUND;
+	const double rangeY = CDP_Y_UPPER_BOUND - CDP_Y_LOWER_BOUND;
+
+	clear_components();
+	for(int j=0; j < numComponents; j++)
+	{
+		const unsigned long long counter = (unsigned long long)j * 8;
+		const double meanX = CDP_X_LOWER_BOUND + (0.1 + 0.8 * CCounterRng::uniform(seed, MG_STREAM_LAYOUT, counter)) * rangeX;
+		const double meanY = CDP_Y_LOWER_BOUND + (0.1 + 0.8 * CCounterRng::uniform(seed, MG_STREAM_LAYOUT, counter + 1)) * rangeY;
+		const double spread1 = MG_MIN_SPREAD + (MG_MAX_SPREAD - MG_MIN_SPREAD) * CCounterRng::uniform(seed, MG_STREAM_LAYOUT, counter + 2);
+		const double spread2 = MG_MIN_SPREAD + (MG_MAX_SPREAD - MG_MIN_SPREAD) * CCounterRng::uniform(seed, MG_STREAM_LAYOUT, counter + 3);
+		const double angle = 0.5 * MG_TWO_PI * CCounterRng::uniform(seed, MG_STREAM_LAYOUT, counter + 4);
+		const double weight = 0.5 + CCounterRng::uniform(seed, MG_STREAM_LAYOUT, counter + 5);
+		const double c = cos(angle);
+		const double s = sin(angle);
+		const double var1 = spread1 * spread1;
+		const double var2 = spread2 * spread2;
+
+		// Rotate diag(var1, var2) by the angle
+		add_component(meanX, meanY, c * c * var1 + s * s * var2, s * s * var1 + c * c * var2, c * s * (var1 - var2), weight);
+	} // end FOR each component
+
+	return (int)components.size();
+}
+
+// Set the fraction of the points spread uniformly over the bounds rather than drawn
+// from the components
+// Returns 0 on success, -1 if fraction isn't within [0, 1]
+int CMixtureGenerator::set_noise(const double fraction)
+{
+	if(!(fraction >= 0.0 && fraction <= 1.0))
+		return -1;
+
+	noise = fraction;
+
+	return 0;
+}
+
+// The component point idx of the sequence is drawn from, or MG_NOISE
+int CMixtureGenerator::component_of(const unsigned long long idx)
+{
+	const double pick = CCounterRng::uniform(seed, MG_STREAM_COMPONENT, idx);
+
+	if(components.empty() || pick < noise)
+		return MG_NOISE;
+
+	// Scale what's left of [noise, 1) back to [0, 1) and find its component
+	const double share = (pick - noise) / (1.0 - noise);
+	int lo = 0, hi = (int)cumulative.size() - 1;
+	while(lo < hi)
+	{
+		const int mid = (lo + hi) / 2;
+		if(share < cumulative[mid])
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+
+	return lo;
+}
+
+// Write points first + begin to first + end - 1 of the sequence into [begin, end) of
+// the store
+void CMixtureGenerator::fill(CPointStore &points, const int begin, const int end, const long long first)
+{
+	int *x = points.get_x();
+	int *y = points.get_y();
+	int *label = points.get_label();
+	unsigned char *size = points.get_size();
+	unsigned char *r = points.get_r();
+	unsigned char *g = points.get_g();
+	unsigned char *b = points.get_b();
+
+	for(int i=begin; i < end; i++)
+	{
+		const unsigned long long idx = (unsigned long long)(first + i);
+		const int c = component_of(idx);
+		double px, py;
+
+		if(c == MG_NOISE)
+		{
+			px = CDP_X_LOWER_BOUND + (CDP_X_UPPER_BOUND - CDP_X_LOWER_BOUND) * CCounterRng::uniform(seed, MG_STREAM_NORMAL, idx * 2);
+			py = CDP_Y_LOWER_BOUND + (CDP_Y_UPPER_BOUND - CDP_Y_LOWER_BOUND) * CCounterRng::uniform(seed, MG_STREAM_NORMAL, idx * 2 + 1);
+		}
+		else
+		{
+			// Box-Muller, two independent normals from two uniforms, then shaped by the
+			// covariance's factor
+			const CMixtureComponent &component = components[c];
+			const double u = 1.0 - CCounterRng::uniform(seed, MG_STREAM_NORMAL, idx * 2);
+			const double v = CCounterRng::uniform(seed, MG_STREAM_NORMAL, idx * 2 + 1);
+			const double radius = sqrt(-2.0 * log(u));
+			const double z0 = radius * cos(MG_TWO_PI * v);
+			const double z1 = radius * sin(MG_TWO_PI * v);
+
+			px = component.meanX + component.cholXX * z0;
+			py = component.meanY + component.cholYX * z0 + component.cholYY * z1;
+		}
+
+		px = px < CDP_X_LOWER_BOUND ? CDP_X_LOWER_BOUND : (px > CDP_X_UPPER_BOUND ? CDP_X_UPPER_BOUND : px);
+		py = py < CDP_Y_LOWER_BOUND ? CDP_Y_LOWER_BOUND : (py > CDP_Y_UPPER_BOUND ? CDP_Y_UPPER_BOUND : py);
+
+		const unsigned long long color = CCounterRng::bits(seed, MG_STREAM_COLOR, idx);
+
+		x[i] = (int)floor(px + 0.5);
+		y[i] = (int)floor(py + 0.5);
+		label[i] = CPS_UNASSIGNED;
+		size[i] = 3;
+		r[i] = (unsigned char)(color%CDP_COLOR_UPPER_BOUND);
+		g[i] = (unsigned char)((color >> 16)%CDP_COLOR_UPPER_BOUND);
+		b[i] = (unsigned char)((color >> 32)%CDP_COLOR_UPPER_BOUND);
+	} // end FOR each data point
+}
+
+// Replace the contents of points with count points of the sequence, starting with
+// point first. The points are generated in chunks across pool, if passed
+// Returns the number of points generated, -1 on error (no components and no noise to
+// draw from, or out of memory)
+int CMixtureGenerator::generate(CPointStore &points, const long long first, const int count, CThreadPool *pool)
+{
+	KI_SCOPE("generate_mixture");
+
+	if(count < 0 || first < 0 || (components.empty() && noise <= 0.0))
+		return -1;
+
+	points.clear();
+	if(points.resize(count) < 0)
+		return -1;
+
+	const int numChunks = CThreadPool::chunk_count(count, MG_MIN_CHUNK_POINTS, MG_MAX_CHUNKS);
+	auto task = [this, &points, count, numChunks, first](int chunk)
+	{
+		fill(points, CThreadPool::chunk_begin(count, chunk, numChunks), CThreadPool::chunk_begin(count, chunk + 1, numChunks), first);
+	};
+
+	if(pool)
+		pool->run(numChunks, task);
+	else
+	{
+		for(int chunk=0; chunk < numChunks; chunk++)
+			task(chunk);
+	}
+
+	KI_COUNT("generate_mixture.points", count);
+
+	return count;
+}
+
+CMixturePointSource::CMixturePointSource(CMixtureGenerator &mixture, const long long numPoints, CThreadPool *pool) : generator(mixture)
+{
+	threadPool = pool;
+	pointCount = numPoints > 0 ? numPoints : 0;
+	nextPoint = 0;
+}
+
+CMixturePointSource::~CMixturePointSource()
+{
+}
+
+// Generate the next batch of points of the mixture
+// Returns the number of points generated, 0 once every point has been handed out, -1 on error
+int CMixturePointSource::read_batch(CPointStore &batch, const int maxPoints)
+{
+	const long long remaining = pointCount - nextPoint;
+	const int count = (int)(remaining < maxPoints ? remaining : maxPoints);
+
+	if(count <= 0)
+	{
+		batch.clear();
+		return 0;
+	}
+
+	if(generator.generate(batch, nextPoint, count, threadPool) < 0)
+		return -1;
+
+	nextPoint += count;
+
+	return count;
+}
@@ -0,0 +1,89 @@
+// mixtureGenerator.h
+// Authored by Alex Shows
+// Released under the MIT License (http://opensource.org/licenses/mit-license.php)
+//
+// Header declaring the CMixtureGenerator and CMixturePointSource classes
+//
+// Synthetic data sets drawn from a mixture of 2D Gaussians over uniform background
+// noise, for load tests and benchmarks. Each component has a mean, a covariance and a
+// weight: add_component() sets them by hand, random_components() lays out any number
+// of them at random. A fraction of the points (set_noise()) are spread uniformly over
+// the bounds instead of being drawn from a component
+//
+// Every point is a pure function of the seed and its index, drawn from CCounterRng
+// (its component, then two normals by Box-Muller, then its color), so generate() can
+// fill any range of the sequence on any number of threads and get the same points.
+// CMixturePointSource hands the sequence to run_minibatch() a batch at a time, so a
+// billion point data set is reproducible without ever being stored. Coordinates are
+// rounded and clamped to the CDP_ bounds
+
+#pragma once
+
+#include "pointStore.h"
+#include "pointSource.h"
+#include "threadPool.h"
+#include <vector>
+using namespace std;
+
+#define MG_NOISE -1 // Returned by component_of() for a point of the background noise
+#define MG_MIN_SPREAD 5.0 // Range of the standard deviations random_components() draws, in pixels
+#define MG_MAX_SPREAD 30.0
+#define MG_MIN_CHUNK_POINTS 65536 // generate() chunks are never smaller than this, unless there are fewer points
+#define MG_MAX_CHUNKS 256 // Upper bound on the chunks generate() splits the points into
+
+// One Gaussian of the mixture
+struct CMixtureComponent
+{
+	double meanX; // Center of the component
+	double meanY;
+	double varX; // Covariance matrix, [varX covXY; covXY varY]
+	double varY;
+	double covXY;
+	double weight; // Share of the points not drawn as noise, relative to the other components
+	double cholXX; // Lower triangular factor L of the covariance, L * L' = covariance
+	double cholYX;
+	double cholYY;
+};
+
+class CMixtureGenerator
+{
+public:
+	CMixtureGenerator(const unsigned long long seedVal = 0);
+	~CMixtureGenerator();
+	int add_component(const double meanX, const double meanY, const double varX, const double varY,
+					  const double covXY = 0.0, const double weight = 1.0);
+	int random_components(const int numComponents);
+	void clear_components(){ components.clear(); cumulative.clear();};
+	int set_noise(const double fraction);
+	double get_noise(){ return noise;};
+	void set_seed(const unsigned long long seedVal){ seed = seedVal;};
+	unsigned long long get_seed(){ return seed;};
+	int get_num_components(){ return (int)components.size();};
+	CMixtureComponent& get_component(const int idx){ return components[idx];};
+	int component_of(const unsigned long long idx);
+	int generate(CPointStore &points, const long long first, const int count, CThreadPool *pool = NULL);
+private:
+	void fill(CPointStore &points, const int begin, const int end, const long long first);
+	unsigned long long seed; // Every point is a pure function of the seed and its index
+	double noise; // Fraction of the points spread uniformly over the bounds
+	vector<CMixtureComponent> components; // Gaussians of the mixture
+	vector<double> cumulative; // Per component, sum of the weights up to and including it, over the total
+};
+
+class CMixturePointSource : public CPointSource
+{
+public:
+	CMixturePointSource(CMixtureGenerator &mixture, const long long numPoints, CThreadPool *pool = NULL);
+	~CMixturePointSource();
+	int read_batch(CPointStore &batch, const int maxPoints);
+	int rewind(){ nextPoint = 0; return 0;};
+	long long get_num_points(){ return pointCount;};
+private:
+	// Not copyable, holds a reference to the generator
+	CMixturePointSource(const CMixturePointSource&);
+	CMixturePointSource& operator=(const CMixturePointSource&);
+	CMixtureGenerator &generator; // Mixture the points are drawn from
+	CThreadPool *threadPool; // Workers generating each batch, NULL for the calling thread only
+	long long pointCount; // Number of points in the data set
+	long long nextPoint; // Index of the next point to hand out
+};
@@ -0,0 +1,56 @@
+// pointBatch.cpp
+// Authored by Alex Shows
+// Released under the MIT License (http://opensource.org/licenses/mit-license.php)
+//
+// Implementation of the CPointBatch class
+// Groups the points of a frame by color for batched drawing
+
+#include "pointBatch.h"
+
+CPointBatch::CPointBatch()
+{
+	groupStart.assign(2, 0);
+}
+
+CPointBatch::~CPointBatch()
+{
+}
+
+// Sort the points into numClusters + 1 groups by label, in two passes over the labels
+void CPointBatch::build(CPointStore &points, const int numClusters)
+{
+	const int numPoints = points.get_count();
+	const int numGroups = numClusters + 1;
+	const int *px = points.get_x();
+	const int *py = points.get_y();
+	const int *label = points.get_label();
+	const unsigned char *psize = points.get_size();
+
+	// Count the points of each group, then turn the counts into starting positions
+	groupStart.assign(numGroups + 1, 0);
+	for(int i=0; i < numPoints; i++)
+	{
+		const int l = label[i];
+		groupStart[(l >= 0 && l < numClusters) ? l + 2 : PB_UNASSIGNED_GROUP + 1]++;
+	}
+	for(int g=1; g <= numGroups; g++)
+		groupStart[g] += groupStart[g - 1];
+
+	x.resize(numPoints);
+	y.resize(numPoints);
+	size.resize(numPoints);
+	index.resize(numPoints);
+
+	// Scatter the points, using the starts of the following groups as write positions
+	vector<int> next(groupStart.begin(), groupStart.end() - 1);
+	for(int i=0; i < numPoints; i++)
+	{
+		const int l = label[i];
+		const int pos = next[(l >= 0 && l < numClusters) ? l + 1 : PB_UNASSIGNED_GROUP]++;
+
+		x[pos] = px[i];
+		y[pos] = py[i];
+		size[pos] = psize[i];
+		index[pos] = i;
+	} // end FOR each data point
+}
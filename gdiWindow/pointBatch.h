@@ -0,0 +1,45 @@
+// pointBatch.h
+// Authored by Alex Shows
+// Released under the MIT License (http://opensource.org/licenses/mit-license.php)
+//
+// Header declaring the CPointBatch class
+//
+// Groups the points of a frame by the color they are drawn in, so a renderer can
+// set up a color once and submit every point of that color in one go. Assigned
+// points take the color of their cluster, so the groups are simply the clusters,
+// plus group 0 for the unassigned points (each drawn in its own color). The points
+// are counting sorted into the groups, keeping their order within each group, and
+// the coordinates and sizes are gathered group by group so renderers stream them
+//
+// Both the GDI+ window and the software rasterizer draw from a CPointBatch
+
+#pragma once
+
+#include "pointStore.h"
+#include <vector>
+using namespace std;
+
+#define PB_UNASSIGNED_GROUP 0 // Group of the points not assigned to a cluster
+
+class CPointBatch
+{
+public:
+	CPointBatch();
+	~CPointBatch();
+	void build(CPointStore &points, const int numClusters);
+	int get_num_groups(){ return (int)groupStart.size() - 1;};
+	int group_begin(const int group){ return groupStart[group];};
+	int group_end(const int group){ return groupStart[group + 1];};
+	static int group_cluster(const int group){ return group - 1;};
+	int get_count(){ return (int)index.size();};
+	const int* get_x(){ return x.empty() ? NULL : &x[0];};
+	const int* get_y(){ return y.empty() ? NULL : &y[0];};
+	const unsigned char* get_size(){ return size.empty() ? NULL : &size[0];};
+	const int* get_index(){ return index.empty() ? NULL : &index[0];};
+private:
+	vector<int> groupStart; // Position of the first point of each group, plus one past the last
+	vector<int> x; // x of the points, group by group
+	vector<int> y; // y of the points, group by group
+	vector<unsigned char> size; // Size of the points, group by group
+	vector<int> index; // Index in the point store of the points, group by group
+};
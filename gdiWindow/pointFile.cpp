@@ -0,0 +1,399 @@
+// pointFile.cpp
+// Authored by Alex Shows
+// Released under the MIT License (http://opensource.org/licenses/mit-license.php)
+//
+// Implementation of the CPointFile class
+// Reads (by memory mapping) and writes binary point and result files
+
+#include "pointFile.h"
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define PF_CHECKSUM_BASIS 0xCBF29CE484222325ULL // FNV-1a offset basis
+#define PF_CHECKSUM_PRIME 0x00000100000001B3ULL // FNV-1a prime
+
+static const char pfMagic[4] = { 'K', 'M', 'P', 'F' };
+
+// The header is read and written as a single block
+static_assert(sizeof(CPointFileHeader) == PF_HEADER_BYTES, "CPointFileHeader must be PF_HEADER_BYTES long");
+
+CPointFile::CPointFile()
+{
+	base = NULL;
+	mappedBytes = 0;
+	memset(&header, 0, sizeof(header));
+}
+
+CPointFile::~CPointFile()
+{
+	close();
+}
+
+// FNV-1a over 64-bit words rather than bytes, so hashing keeps up with the disk.
+// A trailing partial word is hashed as if zero padded, which makes hashing a column
+// and then its padding the same as hashing the two in one go
+uint64_t CPointFile::checksum(uint64_t hash, const void *data, const size_t bytes)
+{
+	const unsigned char *p = (const unsigned char*)data;
+	const size_t words = bytes / 8;
+
+	for(size_t i=0; i < words; i++)
+	{
+		uint64_t w;
+		memcpy(&w, p + i*8, 8);
+		hash = (hash ^ w) * PF_CHECKSUM_PRIME;
+	}
+
+	if(bytes % 8)
+	{
+		uint64_t w = 0;
+		memcpy(&w, p + words*8, bytes % 8);
+		hash = (hash ^ w) * PF_CHECKSUM_PRIME;
+	}
+
+	return hash;
+}
+
+// Number of payload bytes the columns described by fileHeader take up
+uint64_t CPointFile::payload_bytes(const CPointFileHeader &fileHeader)
+{
+	const size_t count = (size_t)fileHeader.count;
+
+	if(fileHeader.kind == PF_KIND_RESULTS)
+		return padded(count * 4) + 2 * padded((size_t)fileHeader.numClusters * 4);
+
+	return 2 * padded(count * 4) + ((fileHeader.flags & PF_FLAG_COLOR) ? 3 * padded(count) : 0);
+}
+
+// Map the file at path, check its header and, if verify is set, its checksum
+// Returns the number of points in the file, -1 on error
+int CPointFile::open(const char *path, const bool verify)
+{
+	close();
+
+	size_t fileBytes = 0;
+	void *view = NULL;
+
+#ifdef _WIN32
+	HANDLE fileHandle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+									FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if(fileHandle == INVALID_HANDLE_VALUE)
+		return -1;
+
+	LARGE_INTEGER fileSize;
+	if(!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart < PF_HEADER_BYTES)
+	{
+		CloseHandle(fileHandle);
+		return -1;
+	}
+	fileBytes = (size_t)fileSize.QuadPart;
+
+	// Copy-on-write, so the engine may edit the points without touching the file
+	HANDLE mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+	if(mappingHandle)
+	{
+		view = MapViewOfFile(mappingHandle, FILE_MAP_COPY, 0, 0, 0);
+		// The view keeps the mapping alive on its own
+		CloseHandle(mappingHandle);
+	}
+	CloseHandle(fileHandle);
+
+	if(!view)
+		return -1;
+#else
+	int fd = ::open(path, O_RDONLY);
+	if(fd < 0)
+		return -1;
+
+	struct stat fileStat;
+	if(fstat(fd, &fileStat) || fileStat.st_size < PF_HEADER_BYTES)
+	{
+		::close(fd);
+		return -1;
+	}
+	fileBytes = (size_t)fileStat.st_size;
+
+	// Copy-on-write, so the engine may edit the points without touching the file
+	view = mmap(NULL, fileBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	// The mapping keeps the file alive on its own
+	::close(fd);
+
+	if(view == MAP_FAILED)
+		return -1;
+#endif
+
+	base = (unsigned char*)view;
+	mappedBytes = fileBytes;
+	memcpy(&header, base, sizeof(header));
+
+	// Check the header describes a file this version understands, and that it all fits
+	if(memcmp(header.magic, pfMagic, 4) || header.version != PF_VERSION ||
+	   (header.kind != PF_KIND_POINTS && header.kind != PF_KIND_RESULTS) ||
+	   (header.coordType != PF_COORD_INT32 && header.coordType != PF_COORD_FLOAT32) ||
+	   header.count > INT_MAX || header.numClusters > INT_MAX ||
+	   header.payloadBytes != payload_bytes(header) ||
+	   header.payloadBytes > mappedBytes - PF_HEADER_BYTES)
+	{
+		close();
+		return -1;
+	}
+
+	if(verify && checksum(PF_CHECKSUM_BASIS, base + PF_HEADER_BYTES, (size_t)header.payloadBytes) != header.checksum)
+	{
+		close();
+		return -1;
+	}
+
+	return (int)header.count;
+}
+
+// Unmap the open file, if any. Stores attached to it must not be used afterwards
+void CPointFile::close()
+{
+	if(base)
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(base);
+#else
+		munmap(base, mappedBytes);
+#endif
+	}
+
+	base = NULL;
+	mappedBytes = 0;
+	memset(&header, 0, sizeof(header));
+}
+
+// Whether every one of count values lies within low..high
+static bool column_in_bounds(const int *column, const int count, const int low, const int high)
+{
+	// Min and max rather than an early exit, so the scan vectorizes
+	int lowest = low;
+	int highest = high;
+	for(int i=0; i < count; i++)
+	{
+		lowest = column[i] < lowest ? column[i] : lowest;
+		highest = column[i] > highest ? column[i] : highest;
+	}
+
+	return lowest >= low && highest <= high;
+}
+
+// Round count float values into column, as long as each rounds within low..high
+// Returns true on success, false for NaN, infinite or out of range values
+static bool round_column(const float *values, int *column, const int count, const int low, const int high)
+{
+	for(int i=0; i < count; i++)
+	{
+		// Written so NaN fails too
+		if(!(values[i] >= (float)low - 0.5f && values[i] < (float)high + 0.5f))
+			return false;
+		column[i] = (int)floor(values[i] + 0.5f);
+	}
+
+	return true;
+}
+
+// Point store at the points of the open points file. int32 coordinates and the colors
+// are used in place; float32 coordinates are rounded into columns the store owns.
+// The file must stay open for as long as store uses it
+// Returns the number of points, -1 on error or if a coordinate lies outside the range
+// the clusters can reach (see CDataPoint)
+int CPointFile::attach(CPointStore &store)
+{
+	if(!base || header.kind != PF_KIND_POINTS)
+		return -1;
+
+	const int count = (int)header.count;
+	unsigned char *xColumn = base + PF_HEADER_BYTES;
+	unsigned char *yColumn = xColumn + padded((size_t)count * 4);
+	unsigned char *rColumn = NULL;
+	unsigned char *gColumn = NULL;
+	unsigned char *bColumn = NULL;
+
+	if(header.flags & PF_FLAG_COLOR)
+	{
+		rColumn = yColumn + padded((size_t)count * 4);
+		gColumn = rColumn + padded((size_t)count);
+		bColumn = gColumn + padded((size_t)count);
+	}
+
+	if(header.coordType == PF_COORD_INT32)
+	{
+		if(!column_in_bounds((const int*)xColumn, count, CDP_X_LOWER_BOUND, CDP_X_UPPER_BOUND) ||
+		   !column_in_bounds((const int*)yColumn, count, CDP_Y_LOWER_BOUND, CDP_Y_UPPER_BOUND) ||
+		   store.attach(count, (int*)xColumn, (int*)yColumn, rColumn, gColumn, bColumn) < 0)
+			return -1;
+	}
+	else
+	{
+		store.clear();
+		if(store.resize(count) < 0)
+			return -1;
+
+		if(!round_column((const float*)xColumn, store.get_x(), count, CDP_X_LOWER_BOUND, CDP_X_UPPER_BOUND) ||
+		   !round_column((const float*)yColumn, store.get_y(), count, CDP_Y_LOWER_BOUND, CDP_Y_UPPER_BOUND))
+		{
+			store.clear();
+			return -1;
+		}
+
+		if(rColumn)
+		{
+			memcpy(store.get_r(), rColumn, (size_t)count);
+			memcpy(store.get_g(), gColumn, (size_t)count);
+			memcpy(store.get_b(), bColumn, (size_t)count);
+		}
+		else
+		{
+			memset(store.get_r(), 0, (size_t)count);
+			memset(store.get_g(), 0, (size_t)count);
+			memset(store.get_b(), 0, (size_t)count);
+		}
+	}
+
+	// Sizes aren't stored, every point gets the generator's size
+	memset(store.get_size(), 3, (size_t)count);
+
+	return count;
+}
+
+// Write bytes of data followed by zero padding to the next column boundary, and fold
+// both into hash
+// Returns 0 on success, -1 otherwise
+static int write_column(FILE *fp, const void *data, const size_t bytes, uint64_t &hash)
+{
+	static const unsigned char zeros[PF_COLUMN_ALIGNMENT] = { 0 };
+	const size_t padBytes = CPointFile::padded(bytes) - bytes;
+
+	if(bytes && fwrite(data, 1, bytes, fp) != bytes)
+		return -1;
+	if(padBytes && fwrite(zeros, 1, padBytes, fp) != padBytes)
+		return -1;
+
+	// The partial word at the end of the data was hashed zero padded, skip those bytes
+	const size_t hashedPad = padBytes - (bytes % 8 ? 8 - bytes % 8 : 0);
+	hash = CPointFile::checksum(CPointFile::checksum(hash, data, bytes), zeros, hashedPad);
+
+	return 0;
+}
+
+// Write the header, with its checksum filled in, over the start of the file
+// Returns 0 on success, -1 otherwise
+static int finish_file(FILE *fp, CPointFileHeader &fileHeader, const uint64_t hash)
+{
+	fileHeader.checksum = hash;
+
+	if(fseek(fp, 0, SEEK_SET) || fwrite(&fileHeader, sizeof(fileHeader), 1, fp) != 1)
+		return -1;
+
+	return 0;
+}
+
+// Start a file of the given kind, with a placeholder header
+// Returns the open file, NULL on error
+static FILE* begin_file(const char *path, CPointFileHeader &fileHeader, const uint32_t kind, const uint32_t flags,
+						const uint64_t count, const uint32_t numClusters)
+{
+	memset(&fileHeader, 0, sizeof(fileHeader));
+	memcpy(fileHeader.magic, pfMagic, 4);
+	fileHeader.version = PF_VERSION;
+	fileHeader.kind = kind;
+	fileHeader.flags = flags;
+	fileHeader.coordType = PF_COORD_INT32;
+	fileHeader.numClusters = numClusters;
+	fileHeader.count = count;
+
+	FILE *fp = fopen(path, "wb");
+	if(!fp)
+		return NULL;
+
+	if(fwrite(&fileHeader, sizeof(fileHeader), 1, fp) != 1)
+	{
+		fclose(fp);
+		return NULL;
+	}
+
+	return fp;
+}
+
+// Write the points of store to a points file at path, with or without their colors
+// Returns the number of points written, -1 on error
+int CPointFile::write_points(const char *path, CPointStore &store, const bool withColor)
+{
+	const int count = store.get_count();
+	CPointFileHeader fileHeader;
+	uint64_t hash = PF_CHECKSUM_BASIS;
+
+	FILE *fp = begin_file(path, fileHeader, PF_KIND_POINTS, withColor ? PF_FLAG_COLOR : 0, count, 0);
+	if(!fp)
+		return -1;
+
+	fileHeader.payloadBytes = payload_bytes(fileHeader);
+
+	int result = write_column(fp, store.get_x(), (size_t)count * 4, hash);
+	if(!result)
+		result = write_column(fp, store.get_y(), (size_t)count * 4, hash);
+	if(!result && withColor)
+	{
+		result = write_column(fp, store.get_r(), (size_t)count, hash);
+		if(!result)
+			result = write_column(fp, store.get_g(), (size_t)count, hash);
+		if(!result)
+			result = write_column(fp, store.get_b(), (size_t)count, hash);
+	}
+	if(!result)
+		result = finish_file(fp, fileHeader, hash);
+
+	if(fclose(fp))
+		result = -1;
+
+	return result ? -1 : count;
+}
+
+// Write the labels of store and the positions of clusters to a results file at path
+// Returns the number of points written, -1 on error
+int CPointFile::write_results(const char *path, CPointStore &store, vector<CDataPoint> &clusters)
+{
+	const int count = store.get_count();
+	const int numClusters = (int)clusters.size();
+	CPointFileHeader fileHeader;
+	uint64_t hash = PF_CHECKSUM_BASIS;
+
+	vector<int32_t> clusterX(numClusters);
+	vector<int32_t> clusterY(numClusters);
+	for(int j=0; j < numClusters; j++)
+	{
+		clusterX[j] = clusters[j].get_x();
+		clusterY[j] = clusters[j].get_y();
+	}
+
+	FILE *fp = begin_file(path, fileHeader, PF_KIND_RESULTS, 0, count, numClusters);
+	if(!fp)
+		return -1;
+
+	fileHeader.payloadBytes = payload_bytes(fileHeader);
+
+	int result = write_column(fp, store.get_label(), (size_t)count * 4, hash);
+	if(!result)
+		result = write_column(fp, numClusters ? &clusterX[0] : NULL, (size_t)numClusters * 4, hash);
+	if(!result)
+		result = write_column(fp, numClusters ? &clusterY[0] : NULL, (size_t)numClusters * 4, hash);
+	if(!result)
+		result = finish_file(fp, fileHeader, hash);
+
+	if(fclose(fp))
+		result = -1;
+
+	return result ? -1 : count;
+}
@@ -0,0 +1,84 @@
+// pointFile.h
+// Authored by Alex Shows
+// Released under the MIT License (http://opensource.org/licenses/mit-license.php)
+//
+// Header declaring the CPointFile class
+//
+// A compact binary file of data points, laid out so it can be memory mapped and
+// clustered in place: a 64 byte header followed by the columns, each starting on
+// a 64 byte boundary and zero padded up to the next one
+//
+//	points file		x, y (int32 or float32) and, with PF_FLAG_COLOR, r, g, b (uint8)
+//	results file	label (int32) per point, then the cluster x and y (int32)
+//
+// The checksum in the header covers everything after it (columns and padding).
+// Values are stored little-endian
+//
+// open() maps the file copy-on-write; attach() then points a CPointStore at the
+// mapped int32 x, y and color columns without parsing or copying them, so only
+// the pages the engine touches are read from disk. float32 coordinates are the
+// exception, they are rounded into columns owned by the store, so any fraction of a
+// pixel they carry is lost to the engine
+//
+// Every coordinate has to lie (after rounding) within the CDataPoint bounds the
+// clusters move in; attach() rejects a file with any point outside them, and any
+// NaN or infinite float coordinate
+
+#pragma once
+
+#include "pointStore.h"
+#include "dataPoint.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+using namespace std;
+
+#define PF_VERSION 1
+#define PF_HEADER_BYTES 64
+#define PF_COLUMN_ALIGNMENT 64 // Every column starts on a multiple of this, from the start of the file
+#define PF_KIND_POINTS 1
+#define PF_KIND_RESULTS 2
+#define PF_FLAG_COLOR 0x01 // Points file carries r, g and b columns
+#define PF_COORD_INT32 0
+#define PF_COORD_FLOAT32 1
+
+// On-disk header, exactly PF_HEADER_BYTES long
+struct CPointFileHeader
+{
+	char magic[4]; // "KMPF"
+	uint32_t version; // PF_VERSION
+	uint32_t kind; // PF_KIND_*
+	uint32_t flags; // PF_FLAG_*
+	uint32_t coordType; // PF_COORD_* of the x and y columns
+	uint32_t numClusters; // Clusters in a results file, 0 otherwise
+	uint64_t count; // Number of points
+	uint64_t payloadBytes; // Bytes following the header
+	uint64_t checksum; // checksum() of the payload
+	uint8_t reserved[16]; // Zero
+};
+
+class CPointFile
+{
+public:
+	CPointFile();
+	~CPointFile();
+	int open(const char *path, const bool verify = false);
+	void close();
+	int attach(CPointStore &store);
+	bool is_open(){ return base != NULL;};
+	int get_count(){ return base ? (int)header.count : 0;};
+	int get_kind(){ return base ? (int)header.kind : 0;};
+	bool has_color(){ return base && (header.flags & PF_FLAG_COLOR);};
+	static int write_points(const char *path, CPointStore &store, const bool withColor = true);
+	static int write_results(const char *path, CPointStore &store, vector<CDataPoint> &clusters);
+	static uint64_t checksum(uint64_t hash, const void *data, const size_t bytes);
+	static size_t padded(const size_t bytes){ return (bytes + PF_COLUMN_ALIGNMENT - 1) & ~((size_t)PF_COLUMN_ALIGNMENT - 1);};
+private:
+	// Not copyable, the mapping is owned
+	CPointFile(const CPointFile&);
+	CPointFile& operator=(const CPointFile&);
+	static uint64_t payload_bytes(const CPointFileHeader &fileHeader);
+	unsigned char *base; // Start of the mapped file, NULL when none is open
+	size_t mappedBytes; // Length of the mapping
+	CPointFileHeader header; // Copy of the header of the open file
+};
@@ -0,0 +1,430 @@
+// pointGrid.cpp
+// Authored by Alex Shows
+// Released under the MIT License (http://opensource.org/licenses/mit-license.php)
+//
+// Implementation of the CPointGrid class
+// A uniform grid spatial index over the positions of the data points
+
+#include "pointGrid.h"
+
+CPointGrid::CPointGrid(const int size)
+{
+	cellSize = size > 0 ? size : PG_CELL_SIZE;
+	columns = (CDP_X_UPPER_BOUND - CDP_X_LOWER_BOUND) / cellSize + 1;
+	rows = (CDP_Y_UPPER_BOUND - CDP_Y_LOWER_BOUND) / cellSize + 1;
+	count = 0;
+	cellPoints.resize((size_t)columns * rows);
+}
+
+CPointGrid::~CPointGrid()
+{
+}
+
+// Column of the cell holding x, the edge one if x is out of bounds
+int CPointGrid::column_of(const int x)
+{
+	if(x < CDP_X_LOWER_BOUND)
+		return 0;
+
+	const int c = (x - CDP_X_LOWER_BOUND) / cellSize;
+
+	return c < columns ? c : columns - 1;
+}
+
+// Row of the cell holding y, the edge one if y is out of bounds
+int CPointGrid::row_of(const int y)
+{
+	if(y < CDP_Y_LOWER_BOUND)
+		return 0;
+
+	const int r = (y - CDP_Y_LOWER_BOUND) / cellSize;
+
+	return r < rows ? r : rows - 1;
+}
+
+// Append point idx at x, y to the end of its cell's list
+void CPointGrid::insert(const int idx, const int x, const int y)
+{
+	const int cell = row_of(y) * columns + column_of(x);
+	vector<CGridEntry> &list = cellPoints[cell];
+	CGridEntry entry = { idx, x, y };
+
+	pointCell[idx] = cell;
+	pointSlot[idx] = (int)list.size();
+	list.push_back(entry);
+}
+
+// Take point idx out of its cell, moving the cell's last point into its slot
+void CPointGrid::remove(const int idx)
+{
+	vector<CGridEntry> &list = cellPoints[pointCell[idx]];
+	const int slot = pointSlot[idx];
+
+	list[slot] = list.back();
+	pointSlot[list[slot].index] = slot;
+	list.pop_back();
+}
+
+// Forget every point, keeping the cells' storage
+void CPointGrid::clear()
+{
+	for(size_t cell=0; cell < cellPoints.size(); cell++)
+		cellPoints[cell].clear();
+
+	pointCell.clear();
+	pointSlot.clear();
+	count = 0;
+}
+
+// Index every point of the store from scratch. The cells are counted first so each
+// list is allocated once
+// Returns the number of points indexed
+int CPointGrid::build(CPointStore &points)
+{
+	const int numPoints = points.get_count();
+	const int *x = points.get_x();
+	const int *y = points.get_y();
+
+	clear();
+	pointCell.resize(numPoints);
+	pointSlot.resize(numPoints);
+
+	vector<int> cellCount(cellPoints.size(), 0);
+	for(int i=0; i < numPoints; i++)
+	{
+		pointCell[i] = row_of(y[i]) * columns + column_of(x[i]);
+		cellCount[pointCell[i]]++;
+	}
+
+	for(size_t cell=0; cell < cellPoints.size(); cell++)
+		cellPoints[cell].reserve(cellCount[cell]);
+
+	for(int i=0; i < numPoints; i++)
+		insert(i, x[i], y[i]);
+
+	count = numPoints;
+
+	return count;
+}
+
+// Bring the index up to date with the store: points past the end of a store that
+// shrank are dropped, points that moved are moved, and points a store that grew
+// gained are added. A point that moved within its cell is only given its new position
+// Returns the number of points dropped, moved or added
+int CPointGrid::update(CPointStore &points)
+{
+	const int numPoints = points.get_count();
+	const int *x = points.get_x();
+	const int *y = points.get_y();
+	int changed = 0;
+
+	for(int i=count - 1; i >= numPoints; i--)
+	{
+		remove(i);
+		changed++;
+	}
+
+	const int kept = numPoints < count ? numPoints : count;
+	for(int i=0; i < kept; i++)
+	{
+		CGridEntry &entry = cellPoints[pointCell[i]][pointSlot[i]];
+		if(entry.x == x[i] && entry.y == y[i])
+			continue;
+
+		if(row_of(y[i]) * columns + column_of(x[i]) == pointCell[i])
+		{
+			entry.x = x[i];
+			entry.y = y[i];
+		}
+		else
+		{
+			remove(i);
+			insert(i, x[i], y[i]);
+		}
+		changed++;
+	} // end FOR each point already indexed
+
+	pointCell.resize(numPoints);
+	pointSlot.resize(numPoints);
+	for(int i=kept; i < numPoints; i++)
+	{
+		insert(i, x[i], y[i]);
+		changed++;
+	}
+
+	count = numPoints;
+
+	return changed;
+}
+
+// Move point idx to its current position in the store
+// Returns 1 if it changed cells, 0 if not, -1 if idx isn't indexed
+int CPointGrid::move_point(CPointStore &points, const int idx)
+{
+	if(idx < 0 || idx >= count || idx >= points.get_count())
+		return -1;
+
+	const int x = points.get_x()[idx];
+	const int y = points.get_y()[idx];
+
+	if(row_of(y) * columns + column_of(x) == pointCell[idx])
+	{
+		CGridEntry &entry = cellPoints[pointCell[idx]][pointSlot[idx]];
+		entry.x = x;
+		entry.y = y;
+		return 0;
+	}
+
+	remove(idx);
+	insert(idx, x, y);
+
+	return 1;
+}
+
+// The point closest to x, y, and no further than maxRadius pixels if maxRadius isn't
+// negative. The rings of cells around x, y are searched from the inside out; a cell
+// r rings out is at least (r - 1) cell sizes away, so the search ends as soon as the
+// closest point found is nearer than the next ring. The lowest index wins ties
+// Returns the index of the point, or PG_NO_POINT if there is none close enough
+int CPointGrid::nearest(const int x, const int y, const int maxRadius)
+{
+	const int qc = column_of(x);
+	const int qr = row_of(y);
+	int lastRing = qc > columns - 1 - qc ? qc : columns - 1 - qc;
+	lastRing = qr > lastRing ? qr : lastRing;
+	lastRing = rows - 1 - qr > lastRing ? rows - 1 - qr : lastRing;
+
+	long long bestDist = maxRadius < 0 ? -1 : (long long)maxRadius * maxRadius;
+	int best = PG_NO_POINT;
+
+	for(int ring=0; ring <= lastRing; ring++)
+	{
+		const long long ringDist = (long long)(ring - 1) * cellSize;
+		if(ring > 0 && bestDist >= 0 && ringDist * ringDist >= bestDist)
+			break;
+
+		for(int r=qr - ring; r <= qr + ring; r++)
+		{
+			if(r < 0 || r >= rows)
+				continue;
+
+			// Only the first and last rows of the ring are whole, the rest just their ends
+			const bool wholeRow = r == qr - ring || r == qr + ring;
+			const int step = wholeRow || ring == 0 ? 1 : 2 * ring;
+
+			for(int c=qc - ring; c <= qc + ring; c += step)
+			{
+				if(c < 0 || c >= columns)
+					continue;
+
+				const vector<CGridEntry> &list = cellPoints[(size_t)r * columns + c];
+				for(size_t k=0; k < list.size(); k++)
+				{
+					const int i = list[k].index;
+					const long long dx = list[k].x - x;
+					const long long dy = list[k].y - y;
+					const long long dist = dx * dx + dy * dy;
+
+					if(bestDist < 0 || dist < bestDist || (dist == bestDist && (best == PG_NO_POINT || i < best)))
+					{
+						bestDist = dist;
+						best = i;
+					}
+				} // end FOR each point in the cell
+			}
+		}
+	} // end FOR each ring
+
+	return best;
+}
+
+// Append the points inside pixels [left, right) x [top, bottom) to found, after
+// clearing it. Cells wholly inside are taken without testing their points; edge cells
+// never are, as they also hold the points out of bounds
+// Returns the number of points found
+int CPointGrid::query_rect(const int left, const int top, const int right, const int bottom, vector<int> &found)
+{
+
+	found.clear();
+	if(right <= left || bottom <= top)
+		return 0;
+
+	const int c0 = column_of(left);
+	const int c1 = column_of(right - 1);
+	const int r0 = row_of(top);
+	const int r1 = row_of(bottom - 1);
+
+	for(int r=r0; r <= r1; r++)
+	{
+		const int cellTop = CDP_Y_LOWER_BOUND + r * cellSize;
+		for(int c=c0; c <= c1; c++)
+		{
+			const int cellLeft = CDP_X_LOWER_BOUND + c * cellSize;
+			const vector<CGridEntry> &list = cellPoints[(size_t)r * columns + c];
+
+			if(!is_edge(c, r) && cellLeft >= left && cellLeft + cellSize <= right && cellTop >= top && cellTop + cellSize <= bottom)
+			{
+				for(size_t k=0; k < list.size(); k++)
+					found.push_back(list[k].index);
+				continue;
+			}
+
+			for(size_t k=0; k < list.size(); k++)
+			{
+				const CGridEntry &entry = list[k];
+				if(entry.x >= left && entry.x < right && entry.y >= top && entry.y < bottom)
+					found.push_back(entry.index);
+			}
+		}
+	}
+
+	return (int)found.size();
+}
+
+// The number of points inside pixels [left, right) x [top, bottom), counted the same
+// way as query_rect() finds them but without listing them
+int CPointGrid::count_rect(const int left, const int top, const int right, const int bottom)
+{
+	int total = 0;
+
+	if(right <= left || bottom <= top)
+		return 0;
+
+	const int c0 = column_of(left);
+	const int c1 = column_of(right - 1);
+	const int r0 = row_of(top);
+	const int r1 = row_of(bottom - 1);
+
+	for(int r=r0; r <= r1; r++)
+	{
+		const int cellTop = CDP_Y_LOWER_BOUND + r * cellSize;
+		for(int c=c0; c <= c1; c++)
+		{
+			const int cellLeft = CDP_X_LOWER_BOUND + c * cellSize;
+			const vector<CGridEntry> &list = cellPoints[(size_t)r * columns + c];
+
+			if(!is_edge(c, r) && cellLeft >= left && cellLeft + cellSize <= right && cellTop >= top && cellTop + cellSize <= bottom)
+			{
+				total += (int)list.size();
+				continue;
+			}
+
+			for(size_t k=0; k < list.size(); k++)
+			{
+				const CGridEntry &entry = list[k];
+				total += entry.x >= left && entry.x < right && entry.y >= top && entry.y < bottom;
+			}
+		}
+	}
+
+	return total;
+}
+
+// Append the points no further than radius pixels from x, y to found, after clearing
+// it. Cells whose farthest corner is within the radius are taken without testing
+// their points
+// Returns the number of points found
+int CPointGrid::query_radius(const int x, const int y, const int radius, vector<int> &found)
+{
+	const long long radius2 = (long long)radius * radius;
+
+	found.clear();
+	if(radius < 0)
+		return 0;
+
+	const int c0 = column_of(x - radius);
+	const int c1 = column_of(x + radius);
+	const int r0 = row_of(y - radius);
+	const int r1 = row_of(y + radius);
+
+	for(int r=r0; r <= r1; r++)
+	{
+		const int cellTop = CDP_Y_LOWER_BOUND + r * cellSize;
+		const long long dyTop = cellTop - y;
+		const long long dyBottom = cellTop + cellSize - 1 - y;
+		const long long farY = dyTop * dyTop > dyBottom * dyBottom ? dyTop * dyTop : dyBottom * dyBottom;
+
+		for(int c=c0; c <= c1; c++)
+		{
+			const int cellLeft = CDP_X_LOWER_BOUND + c * cellSize;
+			const long long dxLeft = cellLeft - x;
+			const long long dxRight = cellLeft + cellSize - 1 - x;
+			const long long farX = dxLeft * dxLeft > dxRight * dxRight ? dxLeft * dxLeft : dxRight * dxRight;
+			const vector<CGridEntry> &list = cellPoints[(size_t)r * columns + c];
+
+			if(!is_edge(c, r) && farX + farY <= radius2)
+			{
+				for(size_t k=0; k < list.size(); k++)
+					found.push_back(list[k].index);
+				continue;
+			}
+
+			for(size_t k=0; k < list.size(); k++)
+			{
+				const long long dx = list[k].x - x;
+				const long long dy = list[k].y - y;
+				if(dx * dx + dy * dy <= radius2)
+					found.push_back(list[k].index);
+			}
+		}
+	}
+
+	return (int)found.size();
+}
+
+// Append the points inside the polygon of numVertices vertices polyX, polyY (closed
+// back to the first vertex) to found, after clearing it, using the even-odd rule as
+// a lasso would. Only the cells under the polygon's bounding box are visited
+// Returns the number of points found, or -1 if there are fewer than three vertices
+int CPointGrid::query_polygon(const int *polyX, const int *polyY, const int numVertices, vector<int> &found)
+{
+
+	found.clear();
+	if(!polyX || !polyY || numVertices < 3)
+		return -1;
+
+	int left = polyX[0], right = polyX[0], top = polyY[0], bottom = polyY[0];
+	for(int v=1; v < numVertices; v++)
+	{
+		left = polyX[v] < left ? polyX[v] : left;
+		right = polyX[v] > right ? polyX[v] : right;
+		top = polyY[v] < top ? polyY[v] : top;
+		bottom = polyY[v] > bottom ? polyY[v] : bottom;
+	}
+
+	const int c0 = column_of(left);
+	const int c1 = column_of(right);
+	const int r0 = row_of(top);
+	const int r1 = row_of(bottom);
+
+	for(int r=r0; r <= r1; r++)
+	{
+		for(int c=c0; c <= c1; c++)
+		{
+			const vector<CGridEntry> &list = cellPoints[(size_t)r * columns + c];
+			for(size_t k=0; k < list.size(); k++)
+			{
+				const CGridEntry &entry = list[k];
+				const double x = entry.x;
+				const double y = entry.y;
+				bool inside = false;
+
+				if(entry.x < left || entry.x > right || entry.y < top || entry.y > bottom)
+					continue;
+
+				// Count the edges a ray from the point to the right crosses
+				for(int v=0, u=numVertices - 1; v < numVertices; u = v++)
+				{
+					if((polyY[v] > y) != (polyY[u] > y) &&
+					   x < (double)(polyX[u] - polyX[v]) * (y - polyY[v]) / (polyY[u] - polyY[v]) + polyX[v])
+						inside = !inside;
+				}
+
+				if(inside)
+					found.push_back(entry.index);
+			} // end FOR each point in the cell
+		}
+	}
+
+	return (int)found.size();
+}
@@ -0,0 +1,73 @@
+// pointGrid.h
+// Authored by Alex Shows
+// Released under the MIT License (http://opensource.org/licenses/mit-license.php)
+//
+// Header declaring the CPointGrid class
+//
+// A uniform grid spatial index over the positions of a CPointStore, for finding the
+// points under the cursor without scanning all of them. The CDP_ bounds are divided
+// into square cells of PG_CELL_SIZE pixels, each holding the indices and positions
+// of the points inside it; a point outside the bounds is kept in the nearest edge
+// cell. The positions are copies, so testing a cell's points reads one contiguous
+// list rather than gathering from the store. Every point also remembers its cell and
+// its slot there, so one that moves is taken out of its old cell and put in its new
+// one in constant time: update() scans the positions and moves only the points that
+// moved, and follows the store as it grows or shrinks. Labels aren't indexed (the
+// queries return indices into the store, which holds them), so label changes need no
+// update at all
+//
+// The queries only visit the cells the query area overlaps: the nearest point
+// searches outward ring by ring and stops once no unvisited cell can be closer,
+// and rectangle and radius queries take cells that lie wholly inside the area
+// without testing their points one by one
+
+#pragma once
+
+#include "pointStore.h"
+#include "dataPoint.h"
+#include <vector>
+using namespace std;
+
+#define PG_CELL_SIZE 4 // Width and height of a cell in pixels
+#define PG_NO_POINT -1 // Returned by nearest() when no point is close enough
+
+// A point in a cell's list
+struct CGridEntry
+{
+	int index; // Index of the point in the store
+	int x; // Position of the point when it was last indexed
+	int y;
+};
+
+class CPointGrid
+{
+public:
+	CPointGrid(const int cellSize = PG_CELL_SIZE);
+	~CPointGrid();
+	int build(CPointStore &points);
+	int update(CPointStore &points);
+	int move_point(CPointStore &points, const int idx);
+	void clear();
+	int nearest(const int x, const int y, const int maxRadius = -1);
+	int query_rect(const int left, const int top, const int right, const int bottom, vector<int> &found);
+	int count_rect(const int left, const int top, const int right, const int bottom);
+	int query_radius(const int x, const int y, const int radius, vector<int> &found);
+	int query_polygon(const int *polyX, const int *polyY, const int numVertices, vector<int> &found);
+	int get_count(){ return count;};
+	int get_cell_size(){ return cellSize;};
+	int get_columns(){ return columns;};
+	int get_rows(){ return rows;};
+private:
+	int column_of(const int x);
+	int row_of(const int y);
+	bool is_edge(const int c, const int r){ return c == 0 || r == 0 || c == columns - 1 || r == rows - 1;};
+	void insert(const int idx, const int x, const int y);
+	void remove(const int idx);
+	int cellSize; // Width and height of a cell in pixels
+	int columns; // Cells across the bounds
+	int rows; // Cells down the bounds
+	int count; // Number of points indexed
+	vector< vector<CGridEntry> > cellPoints; // Per cell, the points inside it, row by row
+	vector<int> pointCell; // Per point, the cell holding it
+	vector<int> pointSlot; // Per point, its position in the cell's list
+};
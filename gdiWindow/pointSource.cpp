@@ -0,0 +1,73 @@
+// pointSource.cpp
+// Authored by Alex Shows
+// Released under the MIT License (http://opensource.org/licenses/mit-license.php)
+//
+// Implementation of the CBlobPointSource class
+// Generates four quadrant blobs of points a batch at a time
+
+#include "pointSource.h"
+#include "counterRng.h"
+#include "dataPoint.h"
+
+// Streams of CCounterRng for each attribute of a point, the counter is the point index
+#define PS_STREAM_X 0
+#define PS_STREAM_Y 1
+#define PS_STREAM_COLOR 2
+
+CBlobPointSource::CBlobPointSource(const long long numPoints, const unsigned long long seedVal)
+{
+	pointCount = numPoints > 0 ? numPoints : 0;
+	nextPoint = 0;
+	seed = seedVal;
+}
+
+CBlobPointSource::~CBlobPointSource()
+{
+}
+
+// Generate the next batch of points, steered into the four quadrants like initialize_data()
+// Returns the number of points generated, 0 once every point has been handed out, -1 on error
+int CBlobPointSource::read_batch(CPointStore &batch, const int maxPoints)
+{
+	long long remaining = pointCount - nextPoint;
+	const int count = (int)(remaining < maxPoints ? remaining : maxPoints);
+
+	if(count <= 0)
+	{
+		batch.clear();
+		return 0;
+	}
+
+	if(batch.resize(count) < 0)
+		return -1;
+
+	int *x = batch.get_x();
+	int *y = batch.get_y();
+	int *label = batch.get_label();
+	unsigned char *size = batch.get_size();
+	unsigned char *r = batch.get_r();
+	unsigned char *g = batch.get_g();
+	unsigned char *b = batch.get_b();
+
+	for(int i=0; i < count; i++)
+	{
+		const unsigned long long idx = (unsigned long long)(nextPoint + i);
+		int modulo = (int)(idx%4);
+		// Artificial steering of clusters into the four quadrants
+		int xOffset = (modulo == 1 || modulo == 3) ? 300 : 20;
+		int yOffset = (modulo == 2 || modulo == 3) ? 300 : 20;
+		unsigned long long color = CCounterRng::bits(seed, PS_STREAM_COLOR, idx);
+
+		x[i] = (int)CCounterRng::below(seed, PS_STREAM_X, idx, CDP_X_UPPER_BOUND)/6 + xOffset;
+		y[i] = (int)CCounterRng::below(seed, PS_STREAM_Y, idx, CDP_Y_UPPER_BOUND)/6 + yOffset;
+		label[i] = CPS_UNASSIGNED;
+		size[i] = 3;
+		r[i] = (unsigned char)(color%CDP_COLOR_UPPER_BOUND);
+		g[i] = (unsigned char)((color >> 16)%CDP_COLOR_UPPER_BOUND);
+		b[i] = (unsigned char)((color >> 32)%CDP_COLOR_UPPER_BOUND);
+	} // end FOR each data point
+
+	nextPoint += count;
+
+	return count;
+}
@@ -0,0 +1,40 @@
+// pointSource.h
+// Authored by Alex Shows
+// Released under the MIT License (http://opensource.org/licenses/mit-license.php)
+//
+// Header declaring the CPointSource interface and the CBlobPointSource class
+//
+// A point source hands out a data set a batch at a time, so the mini-batch mode
+// of CKMeans can cluster data sets far larger than memory: only one batch is
+// ever resident. CBlobPointSource generates the same four quadrant blobs as
+// CKMeans::initialize_data() on the fly, point by point, without storing them
+
+#pragma once
+
+#include "pointStore.h"
+
+class CPointSource
+{
+public:
+	virtual ~CPointSource(){};
+	// Replace the contents of batch with up to maxPoints of the next points
+	// Returns the number of points read, 0 at the end of the data, -1 on error
+	virtual int read_batch(CPointStore &batch, const int maxPoints) = 0;
+	// Start again from the first point
+	// Returns 0 on success, -1 otherwise
+	virtual int rewind() = 0;
+};
+
+class CBlobPointSource : public CPointSource
+{
+public:
+	CBlobPointSource(const long long numPoints, const unsigned long long seedVal);
+	~CBlobPointSource();
+	int read_batch(CPointStore &batch, const int maxPoints);
+	int rewind(){ nextPoint = 0; return 0;};
+	long long get_num_points(){ return pointCount;};
+private:
+	long long pointCount; // Number of points in the data set
+	long long nextPoint; // Index of the next point to hand out
+	unsigned long long seed; // Every point is a pure function of the seed and its index
+};
@@ -0,0 +1,311 @@
+// pointStore.cpp
+// Authored by Alex Shows
+// Released under the MIT License (http://opensource.org/licenses/mit-license.php)
+//
+// Implementation of the CPointStore class
+// A structure-of-arrays container for data points
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+#include "pointStore.h"
+
+CPointStore::CPointStore()
+{
+	count = capacity = 0;
+	x = y = label = NULL;
+	size = r = g = b = NULL;
+	borrowedColumns = 0;
+}
+
+CPointStore::~CPointStore()
+{
+	release();
+}
+
+// Allocate a block aligned to CPS_ALIGNMENT
+// Returns NULL on failure
+void* CPointStore::aligned_malloc(const size_t bytes)
+{
+	// Round up so the allocators which require a multiple of the alignment are happy
+	size_t rounded = (bytes + CPS_ALIGNMENT - 1) & ~((size_t)CPS_ALIGNMENT - 1);
+	if(!rounded)
+		rounded = CPS_ALIGNMENT;
+#ifdef _WIN32
+	return _aligned_malloc(rounded, CPS_ALIGNMENT);
+#else
+	void *ptr = NULL;
+	if(posix_memalign(&ptr, CPS_ALIGNMENT, rounded))
+		return NULL;
+	return ptr;
+#endif
+}
+
+void CPointStore::aligned_free(void *ptr)
+{
+#ifdef _WIN32
+	_aligned_free(ptr);
+#else
+	free(ptr);
+#endif
+}
+
+void CPointStore::release()
+{
+	if(!(borrowedColumns & CPS_COLUMN_X))
+		aligned_free(x);
+	if(!(borrowedColumns & CPS_COLUMN_Y))
+		aligned_free(y);
+	aligned_free(label);
+	aligned_free(size);
+	if(!(borrowedColumns & CPS_COLUMN_R))
+		aligned_free(r);
+	if(!(borrowedColumns & CPS_COLUMN_G))
+		aligned_free(g);
+	if(!(borrowedColumns & CPS_COLUMN_B))
+		aligned_free(b);
+	x = y = label = NULL;
+	size = r = g = b = NULL;
+	count = capacity = 0;
+	borrowedColumns = 0;
+}
+
+// Move the first used elements of a column into newColumn, which replaces it
+// A borrowed column (its bit set in borrowed) is left alone rather than freed, and the
+// new one is owned
+template <typename T>
+static void move_column(T *&column, T *newColumn, const int used, unsigned int &borrowed, const unsigned int bit)
+{
+	if(column && used)
+		memcpy(newColumn, column, sizeof(T) * (size_t)used);
+
+	if(!(borrowed & bit))
+		CPointStore::aligned_free(column);
+	borrowed &= ~bit;
+	column = newColumn;
+}
+
+// Make room for at least newCapacity points without changing the count
+// Every new column is allocated before any point is moved, so running out of memory
+// leaves the store as it was
+// Returns the capacity on success, -1 otherwise
+int CPointStore::reserve(const int newCapacity)
+{
+	if(newCapacity <= capacity)
+		return capacity;
+
+	int *newX = (int*)aligned_malloc(sizeof(int) * (size_t)newCapacity);
+	int *newY = (int*)aligned_malloc(sizeof(int) * (size_t)newCapacity);
+	int *newLabel = (int*)aligned_malloc(sizeof(int) * (size_t)newCapacity);
+	unsigned char *newSize = (unsigned char*)aligned_malloc((size_t)newCapacity);
+	unsigned char *newR = (unsigned char*)aligned_malloc((size_t)newCapacity);
+	unsigned char *newG = (unsigned char*)aligned_malloc((size_t)newCapacity);
+	unsigned char *newB = (unsigned char*)aligned_malloc((size_t)newCapacity);
+
+	if(!newX || !newY || !newLabel || !newSize || !newR || !newG || !newB)
+	{
+		aligned_free(newX);
+		aligned_free(newY);
+		aligned_free(newLabel);
+		aligned_free(newSize);
+		aligned_free(newR);
+		aligned_free(newG);
+		aligned_free(newB);
+		return -1;
+	}
+
+	move_column(x, newX, count, borrowedColumns, CPS_COLUMN_X);
+	move_column(y, newY, count, borrowedColumns, CPS_COLUMN_Y);
+	move_column(label, newLabel, count, borrowedColumns, 0);
+	move_column(size, newSize, count, borrowedColumns, 0);
+	move_column(r, newR, count, borrowedColumns, CPS_COLUMN_R);
+	move_column(g, newG, count, borrowedColumns, CPS_COLUMN_G);
+	move_column(b, newB, count, borrowedColumns, CPS_COLUMN_B);
+	capacity = newCapacity;
+
+	return capacity;
+}
+
+// Replace the contents of the store with newCount points whose x and y (and, if all three
+// are passed, color) columns are borrowed rather than copied. The caller keeps the
+// borrowed memory alive, and writable if the points are to be edited, for as long as the
+// store uses it. The label, size and any color columns not passed are owned, with every
+// point unassigned and the size and color zeroed; those the store already owns are kept
+// if they have room, so attaching again to a file of the same size allocates nothing
+// Returns the count on success, -1 otherwise
+int CPointStore::attach(const int newCount, int *xColumn, int *yColumn,
+						unsigned char *rColumn, unsigned char *gColumn, unsigned char *bColumn)
+{
+	if(newCount < 0 || !xColumn || !yColumn)
+	{
+		release();
+		return -1;
+	}
+
+	const bool withColor = rColumn && gColumn && bColumn;
+
+	if(newCount > capacity || (!withColor && (borrowedColumns & (CPS_COLUMN_R | CPS_COLUMN_G | CPS_COLUMN_B))))
+		release();
+
+	// Owned columns about to be replaced by borrowed ones go
+	if(!(borrowedColumns & CPS_COLUMN_X))
+		aligned_free(x);
+	if(!(borrowedColumns & CPS_COLUMN_Y))
+		aligned_free(y);
+	x = y = NULL;
+	if(withColor)
+	{
+		if(!(borrowedColumns & CPS_COLUMN_R))
+			aligned_free(r);
+		if(!(borrowedColumns & CPS_COLUMN_G))
+			aligned_free(g);
+		if(!(borrowedColumns & CPS_COLUMN_B))
+			aligned_free(b);
+		r = g = b = NULL;
+	}
+	borrowedColumns = 0;
+
+	if(!label)
+		label = (int*)aligned_malloc(sizeof(int) * (size_t)newCount);
+	if(!size)
+		size = (unsigned char*)aligned_malloc((size_t)newCount);
+	if(!withColor)
+	{
+		if(!r)
+			r = (unsigned char*)aligned_malloc((size_t)newCount);
+		if(!g)
+			g = (unsigned char*)aligned_malloc((size_t)newCount);
+		if(!b)
+			b = (unsigned char*)aligned_malloc((size_t)newCount);
+	}
+
+	if(!label || !size || (!withColor && (!r || !g || !b)))
+	{
+		release();
+		return -1;
+	}
+
+	for(int i=0; i < newCount; i++)
+		label[i] = CPS_UNASSIGNED;
+	memset(size, 0, (size_t)newCount);
+	if(!withColor)
+	{
+		memset(r, 0, (size_t)newCount);
+		memset(g, 0, (size_t)newCount);
+		memset(b, 0, (size_t)newCount);
+	}
+	else
+	{
+		r = rColumn;
+		g = gColumn;
+		b = bColumn;
+		borrowedColumns |= CPS_COLUMN_R | CPS_COLUMN_G | CPS_COLUMN_B;
+	}
+
+	x = xColumn;
+	y = yColumn;
+	borrowedColumns |= CPS_COLUMN_X | CPS_COLUMN_Y;
+	count = capacity = newCount;
+
+	return count;
+}
+
+// Set the number of points in use, growing the columns if needed
+// New points are left unassigned, other attributes are left to the caller
+// Returns the count on success, -1 otherwise
+int CPointStore::resize(const int newCount)
+{
+	if(newCount < 0)
+		return -1;
+
+	if(newCount > capacity && reserve(newCount) < 0)
+		return -1;
+
+	for(int i=count; i < newCount; i++)
+		label[i] = CPS_UNASSIGNED;
+
+	count = newCount;
+
+	return count;
+}
+
+// Set every attribute of the point at idx
+// Returns idx on success, -1 otherwise
+int CPointStore::set_point(const int idx, const int xVal, const int yVal, const int sizeVal, const int rVal, const int gVal, const int bVal)
+{
+	if(idx < 0 || idx >= count)
+		return -1;
+
+	x[idx] = xVal;
+	y[idx] = yVal;
+	label[idx] = CPS_UNASSIGNED;
+	size[idx] = (unsigned char)sizeVal;
+	r[idx] = (unsigned char)rVal;
+	g[idx] = (unsigned char)gVal;
+	b[idx] = (unsigned char)bVal;
+
+	return idx;
+}
+
+// Add copies of the points of other, labels included, after the points of the store.
+// The capacity grows by half again at least, so appending a batch at a time costs the
+// points appended, not the points already stored
+// Returns the new count on success, -1 otherwise
+int CPointStore::append(CPointStore &other)
+{
+	const int first = count;
+	const int added = other.get_count();
+
+	if(added > INT_MAX - count)
+		return -1;
+
+	const int newCount = count + added;
+	if(newCount > capacity)
+	{
+		const int grown = capacity > INT_MAX / 3 * 2 ? INT_MAX : capacity + capacity / 2;
+		if(reserve(newCount > grown ? newCount : grown) < 0)
+			return -1;
+	}
+
+	if(added)
+	{
+		memcpy(x + first, other.get_x(), sizeof(int) * (size_t)added);
+		memcpy(y + first, other.get_y(), sizeof(int) * (size_t)added);
+		memcpy(label + first, other.get_label(), sizeof(int) * (size_t)added);
+		memcpy(size + first, other.get_size(), (size_t)added);
+		memcpy(r + first, other.get_r(), (size_t)added);
+		memcpy(g + first, other.get_g(), (size_t)added);
+		memcpy(b + first, other.get_b(), (size_t)added);
+	}
+
+	count = newCount;
+
+	return count;
+}
+
+// Remove the point at idx by moving the last point into its place. Borrowed columns are
+// copied first, as when the store grows, so the memory they came from is never written
+// Returns the new count on success, -1 otherwise
+int CPointStore::swap_remove(const int idx)
+{
+	if(idx < 0 || idx >= count)
+		return -1;
+
+	if(borrowedColumns && reserve(capacity + 1) < 0)
+		return -1;
+
+	const int last = count - 1;
+	x[idx] = x[last];
+	y[idx] = y[last];
+	label[idx] = label[last];
+	size[idx] = size[last];
+	r[idx] = r[last];
+	g[idx] = g[last];
+	b[idx] = b[last];
+	count = last;
+
+	return count;
+}
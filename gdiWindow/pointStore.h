@@ -0,0 +1,73 @@
+// pointStore.h
+// Authored by Alex Shows
+// Released under the MIT License (http://opensource.org/licenses/mit-license.php)
+//
+// Header declaring the CPointStore class
+//
+// A structure-of-arrays container for data points. Each attribute lives in its
+// own contiguous, 64-byte aligned column, so a pass over the data only pulls the
+// columns it actually reads through the cache (e.g. assignment streams x, y and
+// writes label, and never touches size or color)
+//
+// The coordinate and color columns may also be borrowed from memory the store
+// doesn't own, such as a mapped point file (see attach()). A borrowed column is
+// never freed, and is copied into an owned one the first time the store grows.
+// clear() lets go of borrowed columns altogether
+//
+// append() and swap_remove() let a data set change a few points at a time: appending
+// grows the columns geometrically, and removing moves the last point into the hole,
+// so both cost the points changed rather than the points kept
+
+#pragma once
+
+#include <stddef.h>
+
+#define CPS_ALIGNMENT 64 // Byte alignment of every column (one cache line)
+#define CPS_UNASSIGNED -1 // Label of a point not yet assigned to a cluster
+#define CPS_COLUMN_X 0x01 // Bits of the borrowed column mask
+#define CPS_COLUMN_Y 0x02
+#define CPS_COLUMN_R 0x04
+#define CPS_COLUMN_G 0x08
+#define CPS_COLUMN_B 0x10
+
+class CPointStore
+{
+public:
+	CPointStore();
+	~CPointStore();
+	int resize(const int newCount);
+	int reserve(const int newCapacity);
+	int attach(const int newCount, int *xColumn, int *yColumn,
+			   unsigned char *rColumn = NULL, unsigned char *gColumn = NULL, unsigned char *bColumn = NULL);
+	bool is_borrowed(){ return borrowedColumns != 0;};
+	void clear(){ if(borrowedColumns) release(); count = 0;};
+	int set_point(const int idx, const int xVal, const int yVal, const int sizeVal, const int rVal, const int gVal, const int bVal);
+	int append(CPointStore &other);
+	int swap_remove(const int idx);
+	int get_count(){ return count;};
+	int get_capacity(){ return capacity;};
+	int* get_x(){ return x;};
+	int* get_y(){ return y;};
+	int* get_label(){ return label;};
+	unsigned char* get_size(){ return size;};
+	unsigned char* get_r(){ return r;};
+	unsigned char* get_g(){ return g;};
+	unsigned char* get_b(){ return b;};
+	static void* aligned_malloc(const size_t bytes);
+	static void aligned_free(void *ptr);
+private:
+	// Not copyable, the columns are owned
+	CPointStore(const CPointStore&);
+	CPointStore& operator=(const CPointStore&);
+	void release();
+	int count; // Number of points in use
+	int capacity; // Number of points each column has room for
+	int *x; // Offset in pixels from left edge
+	int *y; // Offset in pixels from top edge
+	int *label; // Cluster to which the point is assigned, or CPS_UNASSIGNED
+	unsigned char *size; // Size in pixels
+	unsigned char *r; // red color component
+	unsigned char *g; // green color component
+	unsigned char *b; // blue color component
+	unsigned int borrowedColumns; // CPS_COLUMN_* bits of the columns the store doesn't own
+};
@@ -0,0 +1,634 @@
+// rasterizer.cpp
+// Authored by Alex Shows
+// Released under the MIT License (http://opensource.org/licenses/mit-license.php)
+//
+// Implementation of the CRasterizer class
+// Software rendering of the cluster plot, saved as PPM or PNG
+
+#include "rasterizer.h"
+#include "instrument.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+CRasterizer::CRasterizer()
+{
+	width = height = 0;
+	lodThreshold = DM_DEFAULT_LOD_POINTS;
+	useDensity = false;
+	resize(RS_DEFAULT_WIDTH, RS_DEFAULT_HEIGHT);
+}
+
+CRasterizer::CRasterizer(const int w, const int h)
+{
+	width = height = 0;
+	lodThreshold = DM_DEFAULT_LOD_POINTS;
+	useDensity = false;
+	resize(w, h);
+}
+
+CRasterizer::~CRasterizer()
+{
+}
+
+// Set the size of the frame
+// Returns 0 on success, -1 otherwise
+int CRasterizer::resize(const int w, const int h)
+{
+	if(w < 1 || h < 1 || w > 32767 || h > 32767)
+		return -1;
+
+	width = w;
+	height = h;
+	pixels.assign((size_t)w * h, pack(255, 255, 255));
+
+	return 0;
+}
+
+// Work out the spans of the filled and outlined circle of every diameter a point can draw.
+// Pixel centers sit on whole coordinates, as with GDI+'s default pixel offset mode
+void CRasterizer::build_shapes()
+{
+	disks.resize(RS_MAX_DIAMETER + 1);
+	rings.resize(RS_MAX_DIAMETER + 1);
+
+	for(int d=0; d <= RS_MAX_DIAMETER; d++)
+	{
+		const double c = d / 2.0;
+		const double inner = c > 0.5 ? (c - 0.5) * (c - 0.5) : 0.0;
+		const double outer = (c + 0.5) * (c + 0.5);
+
+		for(int py=0; py <= d; py++)
+		{
+			const double dy = py - c;
+
+			// Fill: centers strictly inside the circle
+			int x0 = -1, x1 = -1;
+			for(int px=0; px < d; px++)
+			{
+				const double dx = px - c;
+				if(dx*dx + dy*dy < c*c)
+				{
+					if(x0 < 0)
+						x0 = px;
+					x1 = px + 1;
+				}
+			}
+			if(x0 >= 0)
+			{
+				CSpan span = { (short)py, (short)x0, (short)x1 };
+				disks[d].push_back(span);
+			}
+
+			// Outline: centers within half a pixel of the circle, up to two runs per row
+			int runStart = -1;
+			for(int px=0; px <= d + 1; px++)
+			{
+				const double dx = px - c;
+				const double dist = dx*dx + dy*dy;
+				const bool on = px <= d && dist >= inner && dist <= outer;
+
+				if(on && runStart < 0)
+					runStart = px;
+				else if(!on && runStart >= 0)
+				{
+					CSpan span = { (short)py, (short)runStart, (short)px };
+					rings[d].push_back(span);
+					runStart = -1;
+				}
+			}
+		} // end FOR each row
+	} // end FOR each diameter
+}
+
+// Blend color at alpha (0-255) over pixels [x0, x1) of row. Red and blue are blended
+// together in one multiply, green in another
+static inline void blend_span(uint32_t *row, const int x0, const int x1, const uint32_t color, const int alpha)
+{
+	if(alpha >= 255)
+	{
+		for(int x=x0; x < x1; x++)
+			row[x] = color;
+		return;
+	}
+
+	const uint32_t a = (uint32_t)(alpha + (alpha >> 7));
+	const uint32_t inv = 256 - a;
+	const uint32_t srcRB = (color & 0x00FF00FF) * a;
+	const uint32_t srcG = (color & 0x0000FF00) * a;
+
+	for(int x=x0; x < x1; x++)
+	{
+		const uint32_t d = row[x];
+		const uint32_t rb = (((d & 0x00FF00FF) * inv + srcRB) >> 8) & 0x00FF00FF;
+		const uint32_t g = (((d & 0x0000FF00) * inv + srcG) >> 8) & 0x0000FF00;
+		row[x] = 0xFF000000u | rb | g;
+	}
+}
+
+// Blend a shape whose box starts at x, y, drawing only the pixels within clip
+void CRasterizer::fill_shape(const vector<CSpan> &shape, const int x, const int y, const uint32_t color, const int alpha,
+							 const CPixelRect &clip)
+{
+	for(size_t s=0; s < shape.size(); s++)
+	{
+		const CSpan &span = shape[s];
+		const int py = y + span.dy;
+		if(py < clip.top || py >= clip.bottom)
+			continue;
+
+		int sx0 = x + span.x0;
+		int sx1 = x + span.x1;
+		if(sx0 < clip.left)
+			sx0 = clip.left;
+		if(sx1 > clip.right)
+			sx1 = clip.right;
+		if(sx0 < sx1)
+			blend_span(&pixels[(size_t)py * width], sx0, sx1, color, alpha);
+	}
+}
+
+// Blend a w x h rectangle at x, y, drawing only the pixels within clip
+void CRasterizer::fill_rect(const int x, const int y, const int w, const int h, const uint32_t color, const int alpha,
+							const CPixelRect &clip)
+{
+	const int top = y > clip.top ? y : clip.top;
+	const int bottom = y + h < clip.bottom ? y + h : clip.bottom;
+	const int left = x > clip.left ? x : clip.left;
+	const int right = x + w < clip.right ? x + w : clip.right;
+
+	if(left >= right)
+		return;
+
+	for(int py=top; py < bottom; py++)
+		blend_span(&pixels[(size_t)py * width], left, right, color, alpha);
+}
+
+// Blend the one pixel outline of a w x h rectangle at x, y (covering w+1 x h+1 pixels),
+// drawing only the pixels within clip
+void CRasterizer::draw_rect(const int x, const int y, const int w, const int h, const uint32_t color, const int alpha,
+							const CPixelRect &clip)
+{
+	fill_rect(x, y, w + 1, 1, color, alpha, clip);
+	fill_rect(x, y + h, w + 1, 1, color, alpha, clip);
+	fill_rect(x, y + 1, 1, h - 1, color, alpha, clip);
+	fill_rect(x + w, y + 1, 1, h - 1, color, alpha, clip);
+}
+
+// Draw everything of the scene that falls within clip
+void CRasterizer::draw_region(CPointStore &points, vector<CDataPoint> &clusters, const CPixelRect &clip)
+{
+	const int insetW = CDP_X_UPPER_BOUND + RS_INSET_PADDING;
+	const int insetH = CDP_Y_UPPER_BOUND + RS_INSET_PADDING;
+	const int numClusters = (int)clusters.size();
+
+	// Background, inset and its outline
+	fill_rect(0, 0, width, height, pack(255, 255, 255), 255, clip);
+	fill_rect(RS_INSET_X, RS_INSET_Y, insetW, insetH, pack(240, 240, 240), 255, clip);
+	draw_rect(RS_INSET_X, RS_INSET_Y, insetW, insetH, pack(0, 0, 0), 255, clip);
+
+	if(useDensity)
+		density.composite(&pixels[(size_t)RS_INSET_Y * width + RS_INSET_X], width, clip.left - RS_INSET_X, clip.top - RS_INSET_Y,
+						  clip.right - RS_INSET_X, clip.bottom - RS_INSET_Y);
+	else
+		draw_points(points, clip);
+
+	for(int j=0; j < numClusters; j++)
+	{
+		const int boxX = clusters[j].get_x() + RS_CLUSTER_SIZE/2 + RS_INSET_X;
+		const int boxY = clusters[j].get_y() + RS_CLUSTER_SIZE/2 + RS_INSET_Y;
+
+		draw_rect(boxX, boxY, RS_CLUSTER_SIZE, RS_CLUSTER_SIZE, clusterColor[j], 255, clip);
+		fill_rect(boxX, boxY, RS_CLUSTER_SIZE, RS_CLUSTER_SIZE, clusterColor[j], RS_CLUSTER_ALPHA, clip);
+	} // end FOR each cluster
+}
+
+// Draw the points that fall within clip, as circles
+void CRasterizer::draw_points(CPointStore &points, const CPixelRect &clip)
+{
+	const int *x = batch.get_x();
+	const int *y = batch.get_y();
+	const unsigned char *size = batch.get_size();
+	const int *index = batch.get_index();
+	const unsigned char *r = points.get_r();
+	const unsigned char *g = points.get_g();
+	const unsigned char *b = points.get_b();
+	const int halfHalo = RS_HALO_GROWTH / 2;
+
+	// A group at a time: the outlines of its points in the region, then their fills and halos
+	vector<int> visible;
+	for(int group=0; group < batch.get_num_groups(); group++)
+	{
+		const int begin = batch.group_begin(group);
+		const int end = batch.group_end(group);
+		const bool ownColor = group == PB_UNASSIGNED_GROUP;
+		uint32_t color = ownColor ? 0 : clusterColor[CPointBatch::group_cluster(group)];
+
+		visible.clear();
+		for(int k=begin; k < end; k++)
+		{
+			const int s = size[k];
+			const int haloX = x[k] + s/2 + RS_INSET_X - halfHalo;
+			const int haloY = y[k] + s/2 + RS_INSET_Y - halfHalo;
+
+			// The halo is the widest and tallest part of a point
+			if(haloY < clip.bottom && haloY + s + RS_HALO_GROWTH >= clip.top &&
+			   haloX < clip.right && haloX + s + RS_HALO_GROWTH >= clip.left)
+				visible.push_back(k);
+		}
+
+		for(size_t v=0; v < visible.size(); v++)
+		{
+			const int k = visible[v];
+			const int s = size[k];
+
+			if(ownColor)
+				color = pack(r[index[k]], g[index[k]], b[index[k]]);
+			fill_shape(rings[s], x[k] + s/2 + RS_INSET_X, y[k] + s/2 + RS_INSET_Y, color, 255, clip);
+		} // end FOR each visible point of the group
+
+		for(size_t v=0; v < visible.size(); v++)
+		{
+			const int k = visible[v];
+			const int s = size[k];
+			const int boxX = x[k] + s/2 + RS_INSET_X;
+			const int boxY = y[k] + s/2 + RS_INSET_Y;
+
+			if(ownColor)
+				color = pack(r[index[k]], g[index[k]], b[index[k]]);
+			fill_shape(disks[s], boxX, boxY, color, RS_POINT_ALPHA, clip);
+			fill_shape(disks[s + RS_HALO_GROWTH], boxX - halfHalo, boxY - halfHalo, color, RS_HALO_ALPHA, clip);
+		} // end FOR each visible point of the group
+	} // end FOR each group
+}
+
+// Get ready to draw a frame: bin the points into the density map if there are more than
+// the level of detail threshold, otherwise group them by color. Binning runs on pool if passed
+void CRasterizer::prepare(CPointStore &points, vector<CDataPoint> &clusters, CThreadPool *pool)
+{
+	KI_SCOPE("prepare");
+
+	if(disks.empty())
+		build_shapes();
+
+	const int numClusters = (int)clusters.size();
+
+	useDensity = lodThreshold > 0 && points.get_count() > lodThreshold;
+	if(useDensity)
+	{
+		if(!density.get_width())
+			density.resize(CDP_X_UPPER_BOUND + RS_INSET_PADDING, CDP_Y_UPPER_BOUND + RS_INSET_PADDING);
+		density.bin(points, clusters, pool);
+	}
+	else
+		batch.build(points, numClusters);
+
+	clusterColor.resize(numClusters);
+	for(int j=0; j < numClusters; j++)
+		clusterColor[j] = pack(clusters[j].get_r(), clusters[j].get_g(), clusters[j].get_b());
+}
+
+// Render the points and clusters into the frame, splitting the rows across pool if passed
+void CRasterizer::draw_scene(CPointStore &points, vector<CDataPoint> &clusters, CThreadPool *pool)
+{
+	KI_SCOPE("draw_scene");
+
+	prepare(points, clusters, pool);
+
+	KI_COUNT("render.bytes", (long long)width * height * sizeof(uint32_t));
+
+	const int numBands = (height + RS_BAND_ROWS - 1) / RS_BAND_ROWS;
+
+	auto draw_band = [this, &points, &clusters](int band)
+	{
+		CPixelRect clip = { 0, band * RS_BAND_ROWS, width, band * RS_BAND_ROWS + RS_BAND_ROWS };
+		if(clip.bottom > height)
+			clip.bottom = height;
+		draw_region(points, clusters, clip);
+	};
+
+	if(pool)
+		pool->run(numBands, draw_band);
+	else
+	{
+		for(int band=0; band < numBands; band++)
+			draw_band(band);
+	}
+}
+
+// Bring a frame drawn earlier up to date, redrawing only the cells that grid finds have
+// changed since, splitting them across pool if passed. A grid not yet tracking a frame
+// of this size is resized, which redraws everything; mark_all() the grid if the frame
+// was resized or drawn over in between
+// Returns the number of cells redrawn
+int CRasterizer::draw_changes(CPointStore &points, vector<CDataPoint> &clusters, CDirtyGrid &grid, CThreadPool *pool)
+{
+	KI_SCOPE("draw_changes");
+
+	if(grid.get_width() != width || grid.get_height() != height)
+		grid.resize(width, height);
+
+	const int dirtyCells = grid.track(points, clusters, RS_INSET_X, RS_INSET_Y);
+	if(!dirtyCells)
+		return 0;
+
+	prepare(points, clusters, pool);
+
+	vector<CPixelRect> rects;
+	grid.get_rects(rects);
+
+	KI_COUNT("render.dirty_cells", dirtyCells);
+#ifdef KMEANS_INSTRUMENT
+	long long dirtyPixels = 0;
+	for(size_t r=0; r < rects.size(); r++)
+		dirtyPixels += (long long)(rects[r].right - rects[r].left) * (rects[r].bottom - rects[r].top);
+	KI_COUNT("render.bytes", dirtyPixels * (long long)sizeof(uint32_t));
+#endif
+
+	if(pool)
+		pool->run((int)rects.size(), [this, &points, &clusters, &rects](int r){ draw_region(points, clusters, rects[r]); });
+	else
+	{
+		for(size_t r=0; r < rects.size(); r++)
+			draw_region(points, clusters, rects[r]);
+	}
+
+	grid.clear();
+
+	return dirtyCells;
+}
+
+// Write the frame as a binary PPM (P6) file
+// Returns 0 on success, -1 otherwise
+int CRasterizer::write_ppm(const char *path)
+{
+	FILE *fp = fopen(path, "wb");
+	if(!fp)
+		return -1;
+
+	vector<unsigned char> row((size_t)width * 3);
+	int result = fprintf(fp, "P6\n%d %d\n255\n", width, height) > 0 ? 0 : -1;
+
+	for(int py=0; py < height && !result; py++)
+	{
+		const uint32_t *src = &pixels[(size_t)py * width];
+		for(int px=0; px < width; px++)
+		{
+			row[px*3 + 0] = (unsigned char)(src[px]);
+			row[px*3 + 1] = (unsigned char)(src[px] >> 8);
+			row[px*3 + 2] = (unsigned char)(src[px] >> 16);
+		}
+
+		if(fwrite(&row[0], 1, row.size(), fp) != row.size())
+			result = -1;
+	}
+
+	if(fclose(fp))
+		result = -1;
+
+	return result;
+}
+
+// Bits written least significant first, as deflate wants them
+class CBitWriter
+{
+public:
+	CBitWriter(vector<unsigned char> &output) : out(output), bits(0), count(0) {};
+	void put(const uint32_t value, const int numBits)
+	{
+		bits |= (uint64_t)value << count;
+		count += numBits;
+		while(count >= 8)
+		{
+			out.push_back((unsigned char)bits);
+			bits >>= 8;
+			count -= 8;
+		}
+	};
+	// Huffman codes are defined most significant bit first
+	void put_code(const uint32_t code, const int numBits)
+	{
+		uint32_t reversed = 0;
+		for(int i=0; i < numBits; i++)
+			reversed |= ((code >> i) & 1) << (numBits - 1 - i);
+		put(reversed, numBits);
+	};
+	void flush()
+	{
+		if(count)
+			out.push_back((unsigned char)bits);
+		bits = 0;
+		count = 0;
+	};
+private:
+	CBitWriter& operator=(const CBitWriter&);
+	vector<unsigned char> &out; // Compressed bytes
+	uint64_t bits; // Bits not yet written out
+	int count; // Number of bits in bits
+};
+
+// Write a literal byte or the end of block marker with the fixed Huffman code
+static void put_literal(CBitWriter &writer, const int value)
+{
+	if(value < 144)
+		writer.put_code(0x30 + value, 8);
+	else if(value < 256)
+		writer.put_code(0x190 + value - 144, 9);
+	else if(value < 280)
+		writer.put_code(value - 256, 7);
+	else
+		writer.put_code(0xC0 + value - 280, 8);
+}
+
+// Write a match of length (3-258) at distance (1-32768) with the fixed Huffman code
+static void put_match(CBitWriter &writer, const int length, const int distance)
+{
+	static const int lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+										35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	static const int lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+										 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	static const int distBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+									  257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	static const int distExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+									   7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+	int l = 28;
+	while(lengthBase[l] > length)
+		l--;
+	put_literal(writer, 257 + l);
+	writer.put(length - lengthBase[l], lengthExtra[l]);
+
+	int d = 29;
+	while(distBase[d] > distance)
+		d--;
+	writer.put_code(d, 5);
+	writer.put(distance - distBase[d], distExtra[d]);
+}
+
+// Compress raw into a zlib stream, using fixed Huffman codes and matching only against
+// the previous pixel and the row above: cheap, and a plot is mostly runs of either
+static void zlib_compress(const vector<unsigned char> &raw, const int rowBytes, vector<unsigned char> &out)
+{
+	const int n = (int)raw.size();
+	const int distances[2] = { 3, rowBytes };
+
+	out.push_back(0x78); // Deflate, 32K window
+	out.push_back(0x01); // No preset dictionary, fastest compression
+
+	CBitWriter writer(out);
+	writer.put(1, 1); // Final block
+	writer.put(1, 2); // Fixed Huffman codes
+
+	for(int i=0; i < n; )
+	{
+		int bestLength = 0;
+		int bestDistance = 0;
+
+		for(int k=0; k < 2; k++)
+		{
+			const int dist = distances[k];
+			if(dist > i || dist > 32768)
+				continue;
+
+			const int limit = n - i < 258 ? n - i : 258;
+			int length = 0;
+			while(length < limit && raw[i + length] == raw[i + length - dist])
+				length++;
+
+			if(length > bestLength)
+			{
+				bestLength = length;
+				bestDistance = dist;
+			}
+		}
+
+		if(bestLength >= 3)
+		{
+			put_match(writer, bestLength, bestDistance);
+			i += bestLength;
+		}
+		else
+			put_literal(writer, raw[i++]);
+	} // end FOR each byte
+
+	put_literal(writer, 256);
+	writer.flush();
+
+	// Adler-32 of the uncompressed data, most significant byte first
+	uint32_t a = 1, b = 0;
+	for(int i=0; i < n; )
+	{
+		// Reduce at least every 5552 bytes so the sums can't overflow
+		const int blockEnd = n - i < 5552 ? n : i + 5552;
+		for(; i < blockEnd; i++)
+		{
+			a += raw[i];
+			b += a;
+		}
+		a %= 65521;
+		b %= 65521;
+	}
+	const uint32_t adler = (b << 16) | a;
+	for(int shift=24; shift >= 0; shift -= 8)
+		out.push_back((unsigned char)(adler >> shift));
+}
+
+// Lookup table of the PNG CRC-32, filled in once
+struct CCrcTable
+{
+	uint32_t entry[256];
+	CCrcTable()
+	{
+		for(uint32_t n=0; n < 256; n++)
+		{
+			uint32_t c = n;
+			for(int k=0; k < 8; k++)
+				c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			entry[n] = c;
+		}
+	};
+};
+
+static const CCrcTable crcTable;
+
+// CRC-32 of a PNG chunk's type and data
+static uint32_t png_crc(const unsigned char *data, const size_t bytes, uint32_t crc)
+{
+	for(size_t i=0; i < bytes; i++)
+		crc = crcTable.entry[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+
+	return crc;
+}
+
+// Write one PNG chunk
+// Returns 0 on success, -1 otherwise
+static int write_chunk(FILE *fp, const char *type, const unsigned char *data, const size_t bytes)
+{
+	unsigned char lengthAndType[8] = { (unsigned char)(bytes >> 24), (unsigned char)(bytes >> 16),
+									   (unsigned char)(bytes >> 8), (unsigned char)bytes,
+									   (unsigned char)type[0], (unsigned char)type[1],
+									   (unsigned char)type[2], (unsigned char)type[3] };
+	uint32_t crc = png_crc(lengthAndType + 4, 4, 0xFFFFFFFFu);
+	crc = png_crc(data, bytes, crc) ^ 0xFFFFFFFFu;
+	unsigned char crcBytes[4] = { (unsigned char)(crc >> 24), (unsigned char)(crc >> 16),
+								  (unsigned char)(crc >> 8), (unsigned char)crc };
+
+	if(fwrite(lengthAndType, 1, 8, fp) != 8 ||
+	   (bytes && fwrite(data, 1, bytes, fp) != bytes) ||
+	   fwrite(crcBytes, 1, 4, fp) != 4)
+		return -1;
+
+	return 0;
+}
+
+// Write the frame as an 8-bit RGB PNG file
+// Returns 0 on success, -1 otherwise
+int CRasterizer::write_png(const char *path)
+{
+	static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+	// Every row is prefixed with filter type 0 (none)
+	const int rowBytes = 1 + width * 3;
+	vector<unsigned char> raw((size_t)rowBytes * height);
+	for(int py=0; py < height; py++)
+	{
+		unsigned char *dst = &raw[(size_t)py * rowBytes];
+		const uint32_t *src = &pixels[(size_t)py * width];
+
+		*dst++ = 0;
+		for(int px=0; px < width; px++)
+		{
+			*dst++ = (unsigned char)(src[px]);
+			*dst++ = (unsigned char)(src[px] >> 8);
+			*dst++ = (unsigned char)(src[px] >> 16);
+		}
+	}
+
+	vector<unsigned char> compressed;
+	compressed.reserve(raw.size() / 4);
+	zlib_compress(raw, rowBytes, compressed);
+
+	const unsigned char header[13] = { (unsigned char)(width >> 24), (unsigned char)(width >> 16),
+									   (unsigned char)(width >> 8), (unsigned char)width,
+									   (unsigned char)(height >> 24), (unsigned char)(height >> 16),
+									   (unsigned char)(height >> 8), (unsigned char)height,
+									   8, // Bits per channel
+									   2, // Truecolor
+									   0, 0, 0 }; // Deflate, adaptive filtering, no interlace
+
+	FILE *fp = fopen(path, "wb");
+	if(!fp)
+		return -1;
+
+	int result = 0;
+	if(fwrite(signature, 1, 8, fp) != 8 ||
+	   write_chunk(fp, "IHDR", header, 13) ||
+	   write_chunk(fp, "IDAT", &compressed[0], compressed.size()) ||
+	   write_chunk(fp, "IEND", NULL, 0))
+		result = -1;
+
+	if(fclose(fp))
+		result = -1;
+
+	return result;
+}
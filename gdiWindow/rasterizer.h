@@ -0,0 +1,94 @@
+// rasterizer.h
+// Authored by Alex Shows
+// Released under the MIT License (http://opensource.org/licenses/mit-license.php)
+//
+// Header declaring the CRasterizer class
+//
+// A portable CPU rasterizer for the cluster plot, so frames can be rendered without
+// Win32 or GDI+. draw_scene() reproduces the window's scene (background, outlined
+// inset, alpha blended point circles with halos and the cluster squares, but not the
+// heading text) into an in-memory RGBA framebuffer, which can be saved as PPM or PNG
+//
+// Shapes follow GDI+'s default (aliased) conventions: an outline of a w x h box
+// covers w+1 x h+1 pixels, a fill covers w x h. The pixel spans of every circle size
+// are computed once and reused, and blending handles two color channels per
+// multiply. The points are grouped by color once per frame (see CPointBatch), so each
+// group's color is set up once and its points are streamed from contiguous columns.
+// The frame is split into bands of rows which can be drawn in parallel; each band
+// draws the groups in the same order, so the image doesn't depend on the threads.
+// draw_changes() keeps a frame up to date across iterations, redrawing only the cells
+// a CDirtyGrid finds changed. Above the level of detail threshold the points are drawn
+// as a density heatmap (see CDensityMap) instead of one by one
+
+#pragma once
+
+#include "pointStore.h"
+#include "dataPoint.h"
+#include "pointBatch.h"
+#include "dirtyGrid.h"
+#include "densityMap.h"
+#include "threadPool.h"
+#include <stdint.h>
+#include <vector>
+using namespace std;
+
+#define RS_DEFAULT_WIDTH 800 // Size of the window the scene was laid out for
+#define RS_DEFAULT_HEIGHT 620
+#define RS_INSET_X 50 // Offset of the inset holding the points, in pixels
+#define RS_INSET_Y 50
+#define RS_INSET_PADDING 6 // Added to the point bounds so the largest points fit in the inset
+#define RS_CLUSTER_SIZE 10 // Width and height of a cluster square
+#define RS_HALO_GROWTH 20 // A point's halo is this much wider than the point
+#define RS_POINT_ALPHA 50 // Opacity of a point's fill
+#define RS_HALO_ALPHA 30 // Opacity of a point's halo
+#define RS_CLUSTER_ALPHA 80 // Opacity of a cluster's fill
+#define RS_MAX_DIAMETER (255 + RS_HALO_GROWTH) // Largest circle a point can draw
+#define RS_BAND_ROWS 32 // Rows of the frame drawn by one task
+
+// Pixels covered by one row of a shape, relative to the top left of its box
+struct CSpan
+{
+	short dy; // Row
+	short x0; // First column covered
+	short x1; // One past the last column covered
+};
+
+class CRasterizer
+{
+public:
+	CRasterizer();
+	CRasterizer(const int w, const int h);
+	~CRasterizer();
+	int resize(const int w, const int h);
+	int get_width(){ return width;};
+	int get_height(){ return height;};
+	uint32_t* get_pixels(){ return pixels.empty() ? NULL : &pixels[0];};
+	void draw_scene(CPointStore &points, vector<CDataPoint> &clusters, CThreadPool *pool = NULL);
+	int draw_changes(CPointStore &points, vector<CDataPoint> &clusters, CDirtyGrid &grid, CThreadPool *pool = NULL);
+	void set_lod_threshold(const int numPoints){ lodThreshold = numPoints;};
+	int get_lod_threshold(){ return lodThreshold;};
+	int write_ppm(const char *path);
+	int write_png(const char *path);
+	static uint32_t pack(const int r, const int g, const int b){ return 0xFF000000u | (uint32_t)b << 16 | (uint32_t)g << 8 | (uint32_t)r;};
+private:
+	// Not copyable, holds the frame and its density map
+	CRasterizer(const CRasterizer&);
+	CRasterizer& operator=(const CRasterizer&);
+	void build_shapes();
+	void prepare(CPointStore &points, vector<CDataPoint> &clusters, CThreadPool *pool);
+	void draw_region(CPointStore &points, vector<CDataPoint> &clusters, const CPixelRect &clip);
+	void draw_points(CPointStore &points, const CPixelRect &clip);
+	void fill_shape(const vector<CSpan> &shape, const int x, const int y, const uint32_t color, const int alpha, const CPixelRect &clip);
+	void fill_rect(const int x, const int y, const int w, const int h, const uint32_t color, const int alpha, const CPixelRect &clip);
+	void draw_rect(const int x, const int y, const int w, const int h, const uint32_t color, const int alpha, const CPixelRect &clip);
+	int width; // Frame width in pixels
+	int height; // Frame height in pixels
+	vector<uint32_t> pixels; // Frame, row by row, each pixel R, G, B, A in memory order
+	vector<vector<CSpan> > disks; // Per diameter, spans of a filled circle
+	vector<vector<CSpan> > rings; // Per diameter, spans of a circle outline
+	CPointBatch batch; // Points of the frame being drawn, grouped by color
+	vector<uint32_t> clusterColor; // Colors of the clusters, which assigned points take on
+	CDensityMap density; // Points of the frame being drawn, binned per pixel
+	int lodThreshold; // Frames with more points than this are drawn from the density map, 0 to never
+	bool useDensity; // Whether the frame being drawn comes from the density map
+};
@@ -0,0 +1,135 @@
+// revisitQueue.cpp
+// Authored by Alex Shows
+// Released under the MIT License (http://opensource.org/licenses/mit-license.php)
+//
+// Implementation of the CRevisitQueue class
+// Points of an incrementally clustered data set, ordered by the drift that unsettles them
+
+#include "revisitQueue.h"
+#include <algorithm>
+
+// Orders the heap with the smallest key at the front
+static bool later_key(const CRevisitEntry &a, const CRevisitEntry &b)
+{
+	return a.key > b.key;
+}
+
+CRevisitQueue::CRevisitQueue()
+{
+	nextStamp = 1;
+}
+
+CRevisitQueue::~CRevisitQueue()
+{
+}
+
+// Make room for numPoints points with no keys, and empty the heap. Set the keys with
+// set_key(), then build()
+void CRevisitQueue::reset(const int numPoints)
+{
+	heap.clear();
+	pointKey.assign(numPoints > 0 ? numPoints : 0, RQ_NEVER);
+	pointStamp.assign(pointKey.size(), 0);
+	nextStamp = 1;
+}
+
+// Grow or shrink to numPoints points. Added points have no entry until they're
+// scheduled, and the entries of points past the end go stale
+void CRevisitQueue::resize(const int numPoints)
+{
+	const size_t newCount = numPoints > 0 ? numPoints : 0;
+
+	pointKey.resize(newCount, RQ_NEVER);
+	pointStamp.resize(newCount, 0);
+}
+
+// Push an entry for every point from the keys set by set_key(), in one O(n) heapify
+void CRevisitQueue::build()
+{
+	heap.clear();
+	nextStamp = 1;
+
+	for(size_t i=0; i < pointKey.size(); i++)
+	{
+		CRevisitEntry entry;
+		entry.key = pointKey[i];
+		entry.index = (int)i;
+		entry.stamp = nextStamp++;
+		pointStamp[i] = entry.stamp;
+		heap.push_back(entry);
+	}
+
+	make_heap(heap.begin(), heap.end(), later_key);
+}
+
+// Push a live entry for the point at idx with its current key
+void CRevisitQueue::push(const int idx)
+{
+	// Wrapping around would let a stale entry match again, so start the stamps over
+	if(!nextStamp)
+	{
+		build();
+		return;
+	}
+
+	CRevisitEntry entry;
+	entry.key = pointKey[idx];
+	entry.index = idx;
+	entry.stamp = nextStamp++;
+	pointStamp[idx] = entry.stamp;
+	heap.push_back(entry);
+	push_heap(heap.begin(), heap.end(), later_key);
+
+	if(heap.size() > RQ_MIN_REBUILD && heap.size() > 2 * pointKey.size())
+		build();
+}
+
+// Give the point at idx a new key, replacing its entry
+void CRevisitQueue::schedule(const int idx, const double key)
+{
+	pointKey[idx] = key;
+	push(idx);
+}
+
+// The point at from now lives at to (the store moved it into a hole), keeping its key
+void CRevisitQueue::move_point(const int from, const int to)
+{
+	if(from == to)
+		return;
+
+	pointKey[to] = pointKey[from];
+	pointStamp[from] = 0;
+	push(to);
+}
+
+// Take every point whose key the drift has passed off the queue, appending their
+// indices to due in key order. They have no entry until they're scheduled again
+// Returns the number of points taken
+int CRevisitQueue::pop_due(const double drift, vector<int> &due)
+{
+	const size_t before = due.size();
+
+	while(!heap.empty() && heap.front().key < drift)
+	{
+		const CRevisitEntry entry = heap.front();
+		pop_heap(heap.begin(), heap.end(), later_key);
+		heap.pop_back();
+
+		if(entry.index < (int)pointStamp.size() && pointStamp[entry.index] == entry.stamp)
+		{
+			pointStamp[entry.index] = 0;
+			due.push_back(entry.index);
+		}
+	} // end WHILE entries are due
+
+	return (int)(due.size() - before);
+}
+
+// Forget every point
+void CRevisitQueue::clear()
+{
+	heap.clear();
+	pointKey.clear();
+	pointStamp.clear();
+	nextStamp = 1;
+}
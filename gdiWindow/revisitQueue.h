@@ -0,0 +1,60 @@
+// revisitQueue.h
+// Authored by Alex Shows
+// Released under the MIT License (http://opensource.org/licenses/mit-license.php)
+//
+// Header declaring the CRevisitQueue class
+//
+// Keeps each point of an incrementally clustered data set until the clusters have
+// drifted far enough that its label might be wrong. When a point is labelled, the
+// gap between its distance to the nearest and to the second nearest cluster says how
+// much the clusters can move before another cluster could be nearer: half the gap,
+// as its own cluster can come no further away, and the runner-up no closer, than the
+// distance either moved. The engine sums the largest distance any cluster moved on
+// every step into a single drift, so a point labelled at drift D with gap g needs
+// another look only once the drift reaches D + g/2 (its key)
+//
+// The keys sit in a min-heap, so a step pops just the points whose keys the drift
+// has passed, however many points there are. Rescheduling or moving a point (the
+// store removes points by moving the last one into the hole) leaves its old entry
+// behind, told apart from the live one by a stamp; the heap is rebuilt from the live
+// keys once the stale entries outnumber them
+
+#pragma once
+
+#include <vector>
+using namespace std;
+
+#define RQ_NEVER 1e300 // Key of a point no drift can unsettle (a single cluster)
+#define RQ_MIN_REBUILD 4096 // The heap is never rebuilt while it holds fewer entries than this
+
+// An entry of the heap
+struct CRevisitEntry
+{
+	double key; // Drift at which the point needs another look
+	int index; // Index of the point
+	unsigned int stamp; // Stamp the point had when the entry was pushed
+};
+
+class CRevisitQueue
+{
+public:
+	CRevisitQueue();
+	~CRevisitQueue();
+	void reset(const int numPoints);
+	void resize(const int numPoints);
+	void set_key(const int idx, const double key){ pointKey[idx] = key;};
+	void build();
+	void schedule(const int idx, const double key);
+	void move_point(const int from, const int to);
+	int pop_due(const double drift, vector<int> &due);
+	void clear();
+	int get_count(){ return (int)pointKey.size();};
+	int get_heap_size(){ return (int)heap.size();};
+	double get_key(const int idx){ return pointKey[idx];};
+private:
+	void push(const int idx);
+	vector<CRevisitEntry> heap; // Entries ordered by key, the smallest at the front
+	vector<double> pointKey; // Per point, the drift at which it needs another look
+	vector<unsigned int> pointStamp; // Per point, the stamp of its live entry, 0 for none
+	unsigned int nextStamp; // Stamp of the next entry pushed
+};
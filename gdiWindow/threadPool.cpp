@@ -0,0 +1,161 @@
+// threadPool.cpp
+// Authored by Alex Shows
+// Released under the MIT License (http://opensource.org/licenses/mit-license.php)
+//
+// Implementation of the CThreadPool class
+// A fixed set of worker threads which run numbered tasks
+
+#include "threadPool.h"
+
+CThreadPool::CThreadPool()
+{
+	job = NULL;
+	jobTasks = 0;
+	nextTask = 0;
+	busyWorkers = 0;
+	generation = 0;
+	quitting = false;
+}
+
+CThreadPool::CThreadPool(const int numThreads)
+{
+	job = NULL;
+	jobTasks = 0;
+	nextTask = 0;
+	busyWorkers = 0;
+	generation = 0;
+	quitting = false;
+	set_thread_count(numThreads);
+}
+
+CThreadPool::~CThreadPool()
+{
+	stop_workers();
+}
+
+// Number of hardware threads, or 1 if that can't be determined
+int CThreadPool::hardware_thread_count()
+{
+	int count = (int)thread::hardware_concurrency();
+
+	return count > 0 ? count : 1;
+}
+
+// Number of chunks to split numItems into so no chunk is smaller than minChunkItems
+// (unless there are fewer items than that) and there are at most maxChunks
+// The count depends only on the arguments, never on the number of threads, so work split
+// this way reduces in the same order on any machine
+int CThreadPool::chunk_count(const int numItems, const int minChunkItems, const int maxChunks)
+{
+	int numChunks = (int)(((long long)numItems + minChunkItems - 1) / minChunkItems);
+	if(numChunks > maxChunks)
+		numChunks = maxChunks;
+	if(numChunks < 1)
+		numChunks = 1;
+
+	return numChunks;
+}
+
+// Resize the pool to numThreads threads including the caller of run()
+// Zero or less uses every hardware thread
+// Returns the number of threads in use
+int CThreadPool::set_thread_count(const int numThreads)
+{
+	int count = numThreads > 0 ? numThreads : hardware_thread_count();
+
+	if(count == get_thread_count())
+		return count;
+
+	stop_workers();
+
+	quitting = false;
+	for(int i=1; i < count; i++)
+		workers.push_back(thread(&CThreadPool::worker_loop, this, generation));
+
+	return get_thread_count();
+}
+
+void CThreadPool::stop_workers()
+{
+	{
+		unique_lock<mutex> guard(poolLock);
+		quitting = true;
+	}
+	workReady.notify_all();
+
+	for(vector<thread>::iterator it = workers.begin(); it != workers.end(); ++it)
+		it->join();
+
+	workers.clear();
+}
+
+// Pull task numbers until there are none left
+void CThreadPool::run_tasks()
+{
+	int task;
+	while((task = nextTask.fetch_add(1)) < jobTasks)
+		(*job)(task);
+}
+
+// Wait for each job posted after startGeneration and help run it
+void CThreadPool::worker_loop(const unsigned int startGeneration)
+{
+	unsigned int lastGeneration = startGeneration;
+
+	for(;;)
+	{
+		{
+			unique_lock<mutex> guard(poolLock);
+			while(!quitting && generation == lastGeneration)
+				workReady.wait(guard);
+
+			if(quitting)
+				return;
+
+			lastGeneration = generation;
+		}
+
+		run_tasks();
+
+		{
+			unique_lock<mutex> guard(poolLock);
+			if(--busyWorkers == 0)
+				workDone.notify_one();
+		}
+	} // end FOR ever
+}
+
+// Run task(0) through task(numTasks-1) across the pool and wait for all of them
+// Tasks may run in any order and on any thread
+void CThreadPool::run(const int numTasks, const function<void (int)> &task)
+{
+	if(numTasks <= 0)
+		return;
+
+	// Not worth waking anyone up for
+	if(workers.empty() || numTasks == 1)
+	{
+		for(int i=0; i < numTasks; i++)
+			task(i);
+		return;
+	}
+
+	{
+		unique_lock<mutex> guard(poolLock);
+		job = &task;
+		jobTasks = numTasks;
+		nextTask = 0;
+		busyWorkers = (int)workers.size();
+		generation++;
+	}
+	workReady.notify_all();
+
+	run_tasks();
+
+	{
+		unique_lock<mutex> guard(poolLock);
+		while(busyWorkers > 0)
+			workDone.wait(guard);
+		job = NULL;
+	}
+}
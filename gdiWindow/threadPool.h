@@ -0,0 +1,56 @@
+// threadPool.h
+// Authored by Alex Shows
+// Released under the MIT License (http://opensource.org/licenses/mit-license.php)
+//
+// Header declaring the CThreadPool class
+//
+// A fixed set of worker threads which run numbered tasks. run() hands out the
+// task numbers 0..numTasks-1 to the workers (the calling thread pitches in as
+// well) and returns once every task has finished, so callers can treat it as
+// a blocking parallel for loop
+//
+// A lambda passed to run() is wrapped by reference rather than copied into the
+// function, which would allocate whenever its captures outgrow the function's
+// small buffer. run() then never allocates, however often it's called
+
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+using namespace std;
+
+class CThreadPool
+{
+public:
+	CThreadPool();
+	CThreadPool(const int numThreads);
+	~CThreadPool();
+	int set_thread_count(const int numThreads = 0);
+	int get_thread_count(){ return (int)workers.size() + 1;};
+	void run(const int numTasks, const function<void (int)> &task);
+	template <class Task> void run(const int numTasks, const Task &task){ run(numTasks, function<void (int)>(cref(task)));};
+	static int hardware_thread_count();
+	static int chunk_count(const int numItems, const int minChunkItems, const int maxChunks);
+	static int chunk_begin(const int numItems, const int chunk, const int numChunks){ return (int)((long long)numItems * chunk / numChunks);};
+private:
+	// Not copyable, the threads are owned
+	CThreadPool(const CThreadPool&);
+	CThreadPool& operator=(const CThreadPool&);
+	void worker_loop(const unsigned int startGeneration);
+	void run_tasks();
+	void stop_workers();
+	vector<thread> workers; // Background threads, the caller of run() is the last worker
+	mutex poolLock; // Guards everything below except nextTask
+	condition_variable workReady; // Signaled when a new job is posted or the pool shuts down
+	condition_variable workDone; // Signaled when the last worker finishes a job
+	const function<void (int)> *job; // Task function of the job in progress
+	int jobTasks; // Number of tasks in the job in progress
+	atomic<int> nextTask; // Next task number to hand out
+	int busyWorkers; // Background workers still running the current job
+	unsigned int generation; // Incremented for every job so workers can tell a new one was posted
+	bool quitting; // Set to shut the workers down
+};
@@ -0,0 +1,53 @@
+// tripleBuffer.h
+// Authored by Alex Shows
+// Released under the MIT License (http://opensource.org/licenses/mit-license.php)
+//
+// Header declaring and implementing the CTripleBuffer class
+//
+// Hands values from one writer thread to one reader thread without locks or waiting.
+// There are three slots: the writer fills the back slot and publish() swaps it with
+// the middle one; the reader's acquire() swaps the middle slot with its front slot
+// if something new was published since. Either side only ever touches its own slot,
+// so the reader can take as long as it likes over the front slot while the writer
+// keeps publishing, and always gets the latest value, skipping any it was too slow
+// to see. The swaps are a single atomic exchange of the middle slot's index
+
+#pragma once
+
+#include <atomic>
+using namespace std;
+
+#define TB_INDEX_MASK 0x3 // Bits of the middle word holding the slot index
+#define TB_FRESH 0x4 // Bit of the middle word set when the middle slot is newly published
+
+template <class T>
+class CTripleBuffer
+{
+public:
+	CTripleBuffer() : middle(1), back(0), front(2) {};
+	// Writer side: the slot to fill, then publish() it
+	T& get_back(){ return slots[back];};
+	void publish()
+	{
+		back = middle.exchange(back | TB_FRESH, memory_order_acq_rel) & TB_INDEX_MASK;
+	};
+	// Reader side: take the latest published slot, if there's a new one
+	// Returns whether the front slot changed
+	bool acquire()
+	{
+		if(!(middle.load(memory_order_acquire) & TB_FRESH))
+			return false;
+
+		front = middle.exchange(front, memory_order_acq_rel) & TB_INDEX_MASK;
+		return true;
+	};
+	T& get_front(){ return slots[front];};
+private:
+	// Not copyable, one writer and one reader share it
+	CTripleBuffer(const CTripleBuffer&);
+	CTripleBuffer& operator=(const CTripleBuffer&);
+	T slots[3]; // The back, middle and front values, in some order
+	atomic<unsigned int> middle; // Index of the middle slot, plus TB_FRESH
+	unsigned int back; // Index of the writer's slot, only touched by the writer
+	unsigned int front; // Index of the reader's slot, only touched by the reader
+};
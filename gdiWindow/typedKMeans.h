@@ -0,0 +1,293 @@
+// typedKMeans.h
+// Authored by Alex Shows
+// Released under the MIT License (http://opensource.org/licenses/mit-license.php)
+//
+// Header declaring and implementing the CTypedKMeans class template
+//
+// K-Means Clustering (Lloyd's Algorithm) of 2D points with the coordinate type a
+// template parameter: CTypedKMeans<int16_t> for compact screen-space data (half the
+// bytes of int per point), <int32_t>, <float> or <double> for full precision
+// analytics. The x and y columns are kept in T, each instantiation runs its own
+// typed_assign<T>() kernel, and the per-cluster sums are kept in the wide Accum type of
+// CCoordTraits<T>. The centroids are means in double and are never rounded, so unlike
+// CKMeans (which moves its clusters to whole pixels) a centroid doesn't jitter between
+// neighbouring pixels as points trade clusters
+//
+// Like CFeatureKMeans each iteration is one chunked, threaded pass with the partial
+// sums reduced in chunk order, so results don't depend on the number of threads. The
+// points and starting clusters are usually taken from a CKMeans (load()), whose
+// generators, readers and seeding they then share; get_clusters() and the labels go
+// back the other way for drawing and saving
+
+#pragma once
+
+#include "kMeans.h"
+#include "typedKernel.h"
+#include "instrument.h"
+#include <math.h>
+#include <chrono>
+#include <vector>
+using namespace std;
+
+template <typename T>
+class CTypedKMeans
+{
+public:
+	typedef typename CCoordTraits<T>::Calc Calc;
+	typedef typename CCoordTraits<T>::Accum Accum;
+	CTypedKMeans(){ numClusters = 0;};
+	~CTypedKMeans(){};
+	int resize(const int numPoints);
+	int load(CPointStore &points, vector<CDataPoint> &clusters);
+	int set_clusters(vector<CDataPoint> &clusters);
+	int iterate(CIterationStats *stats = NULL);
+	int run_until_converged(const int maxIterations = KM_DEFAULT_MAX_ITERATIONS,
+							const double tolerance = KM_DEFAULT_TOLERANCE,
+							vector<CIterationStats> *stats = NULL);
+	int get_clusters(vector<CDataPoint> &clusters);
+	int set_thread_count(const int numThreads = 0){ return threadPool.set_thread_count(numThreads);};
+	int get_thread_count(){ return threadPool.get_thread_count();};
+	int get_count(){ return (int)x.size();};
+	int get_num_clusters(){ return numClusters;};
+	double get_centroid_x(const int idx){ return centroidX[idx];};
+	double get_centroid_y(const int idx){ return centroidY[idx];};
+	T* get_x(){ return x.empty() ? NULL : &x[0];};
+	T* get_y(){ return y.empty() ? NULL : &y[0];};
+	int* get_labels(){ return labels.empty() ? NULL : &labels[0];};
+	static const char* type_name(){ return CCoordTraits<T>::name();};
+private:
+	// Not copyable, the thread pool is owned
+	CTypedKMeans(const CTypedKMeans&);
+	CTypedKMeans& operator=(const CTypedKMeans&);
+	void prepare_partials(const int numChunks);
+	void assign_chunk(const int chunk, const int numChunks);
+	vector<T> x; // Per point, its position
+	vector<T> y;
+	vector<int> labels; // Per point, the cluster it is assigned to
+	int numClusters; // Number of clusters
+	vector<double> centroidX; // Per cluster, its position (the mean of its points)
+	vector<double> centroidY;
+	vector<Calc> calcX; // The cluster positions in the kernel's type, for the current pass
+	vector<Calc> calcY;
+	CThreadPool threadPool; // Workers for iterate(), single threaded by default
+	vector<Accum> partialX; // Per chunk, per cluster sum of x
+	vector<Accum> partialY; // Per chunk, per cluster sum of y
+	vector<long long> partialCount; // Per chunk, per cluster number of points
+	vector<int> partialChanged; // Per chunk number of labels changed
+	vector<double> partialDist; // Per chunk sum of squared distances to the assigned clusters
+};
+
+// Size the columns for numPoints points, to be filled through get_x() and get_y(), and
+// unassign every point
+// Returns the number of points
+template <typename T>
+int CTypedKMeans<T>::resize(const int numPoints)
+{
+	const int count = numPoints > 0 ? numPoints : 0;
+
+	x.resize(count);
+	y.resize(count);
+	labels.assign(count, CPS_UNASSIGNED);
+
+	return count;
+}
+
+// Take the positions of points, converted to T (clamped to its range), and the
+// positions of clusters as the starting centroids
+// Returns the number of points
+template <typename T>
+int CTypedKMeans<T>::load(CPointStore &points, vector<CDataPoint> &clusters)
+{
+	const int count = resize(points.get_count());
+	const int *px = points.get_x();
+	const int *py = points.get_y();
+
+	for(int i=0; i < count; i++)
+	{
+		x[i] = CCoordTraits<T>::from_int(px[i]);
+		y[i] = CCoordTraits<T>::from_int(py[i]);
+	}
+
+	set_clusters(clusters);
+
+	return count;
+}
+
+// Place the centroids at the positions of clusters, one centroid each
+// Returns the number of clusters
+template <typename T>
+int CTypedKMeans<T>::set_clusters(vector<CDataPoint> &clusters)
+{
+	numClusters = (int)clusters.size();
+	centroidX.resize(numClusters);
+	centroidY.resize(numClusters);
+
+	for(int j=0; j < numClusters; j++)
+	{
+		centroidX[j] = clusters[j].get_x();
+		centroidY[j] = clusters[j].get_y();
+	}
+
+	return numClusters;
+}
+
+// Size and clear the per chunk partial sums for numChunks chunks
+template <typename T>
+void CTypedKMeans<T>::prepare_partials(const int numChunks)
+{
+	partialX.assign((size_t)numChunks * numClusters, 0);
+	partialY.assign((size_t)numChunks * numClusters, 0);
+	partialCount.assign((size_t)numChunks * numClusters, 0);
+	partialChanged.assign(numChunks, 0);
+	partialDist.assign(numChunks, 0.0);
+}
+
+// Label the points of one chunk and accumulate them into the chunk's partial sums
+template <typename T>
+void CTypedKMeans<T>::assign_chunk(const int chunk, const int numChunks)
+{
+	const int count = get_count();
+	const int begin = CThreadPool::chunk_begin(count, chunk, numChunks);
+	const int end = CThreadPool::chunk_begin(count, chunk + 1, numChunks);
+	const size_t first = (size_t)chunk * numClusters;
+
+	KI_SCOPE("typed_assign_chunk");
+
+	partialChanged[chunk] = typed_assign<T>(&x[begin], &y[begin], end - begin, &calcX[0], &calcY[0], numClusters,
+											&labels[begin], &partialX[first], &partialY[first], &partialCount[first],
+											&partialDist[chunk]);
+}
+
+// Run one Lloyd iteration across the thread pool: assign every point to its nearest
+// centroid, then move every cluster to the mean of its points. A cluster left without
+// points stays where it is
+// Fills in stats, if passed, and returns the number of points whose label changed
+template <typename T>
+int CTypedKMeans<T>::iterate(CIterationStats *stats)
+{
+	const int count = get_count();
+	if(!numClusters || !count)
+		return 0;
+
+	KI_SCOPE("typed_iterate");
+
+	chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+
+	calcX.resize(numClusters);
+	calcY.resize(numClusters);
+	for(int j=0; j < numClusters; j++)
+	{
+		calcX[j] = (Calc)centroidX[j];
+		calcY[j] = (Calc)centroidY[j];
+	}
+
+	const int numChunks = CThreadPool::chunk_count(count, KM_MIN_CHUNK_POINTS, KM_MAX_CHUNKS);
+	prepare_partials(numChunks);
+	threadPool.run(numChunks, [this, numChunks](int chunk){ assign_chunk(chunk, numChunks); });
+
+	chrono::high_resolution_clock::time_point assigned = chrono::high_resolution_clock::now();
+
+	// Reduce the partials in chunk order and move the clusters
+	double maxShift = 0.0;
+	int emptyClusters = 0;
+	for(int j=0; j < numClusters; j++)
+	{
+		Accum sumX = 0, sumY = 0;
+		long long pointCount = 0;
+		for(int c=0; c < numChunks; c++)
+		{
+			const size_t idx = (size_t)c * numClusters + j;
+			sumX += partialX[idx];
+			sumY += partialY[idx];
+			pointCount += partialCount[idx];
+		}
+
+		if(!pointCount)
+		{
+			emptyClusters++;
+			continue;
+		}
+
+		const double meanX = (double)sumX / (double)pointCount;
+		const double meanY = (double)sumY / (double)pointCount;
+		const double shift = sqrt((meanX - centroidX[j]) * (meanX - centroidX[j]) + (meanY - centroidY[j]) * (meanY - centroidY[j]));
+		if(shift > maxShift)
+			maxShift = shift;
+
+		centroidX[j] = meanX;
+		centroidY[j] = meanY;
+	} // end FOR each cluster
+
+	int changed = 0;
+	double inertia = 0.0;
+	for(int c=0; c < numChunks; c++)
+	{
+		changed += partialChanged[c];
+		inertia += partialDist[c];
+	}
+
+	// Every point reads its coordinates and reads and writes its label
+	KI_COUNT("typed_iterate.distances", (long long)count * numClusters);
+	KI_COUNT("typed_iterate.reassigned", changed);
+	KI_COUNT("typed_iterate.empty_clusters", emptyClusters);
+	KI_COUNT("typed_iterate.bytes", (long long)count * (2 * sizeof(T) + sizeof(int)));
+
+	if(stats)
+	{
+		chrono::high_resolution_clock::time_point updated = chrono::high_resolution_clock::now();
+
+		stats->labelChanges = changed;
+		stats->inertia = inertia;
+		stats->centroidShift = maxShift;
+		stats->distanceEvals = (long long)count * numClusters;
+		stats->pruneRate = 0.0;
+		stats->assignMs = chrono::duration<double, milli>(assigned - start).count();
+		stats->updateMs = chrono::duration<double, milli>(updated - assigned).count();
+	}
+
+	return changed;
+}
+
+// Iterate until no label changes, no cluster moves further than tolerance, or maxIterations
+// have run, whichever comes first
+// Appends one entry per iteration to stats, if passed, and returns the number of iterations run
+template <typename T>
+int CTypedKMeans<T>::run_until_converged(const int maxIterations, const double tolerance, vector<CIterationStats> *stats)
+{
+	int iter = 0;
+
+	while(iter < maxIterations)
+	{
+		CIterationStats iterStats;
+		iterStats.iteration = iter;
+
+		int changed = iterate(&iterStats);
+		iter++;
+
+		if(stats)
+			stats->push_back(iterStats);
+
+		if(!changed || iterStats.centroidShift <= tolerance)
+			break;
+	} // end WHILE not converged
+
+	return iter;
+}
+
+// Move clusters, one per centroid, to the centroids rounded to the nearest pixel,
+// keeping their colors, for drawing
+// Returns the number of clusters on success, -1 if clusters doesn't hold one per centroid
+template <typename T>
+int CTypedKMeans<T>::get_clusters(vector<CDataPoint> &clusters)
+{
+	if((int)clusters.size() != numClusters)
+		return -1;
+
+	for(int j=0; j < numClusters; j++)
+	{
+		clusters[j].set_x((int)floor(centroidX[j] + 0.5));
+		clusters[j].set_y((int)floor(centroidY[j] + 0.5));
+	}
+
+	return numClusters;
+}
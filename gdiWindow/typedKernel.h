@@ -0,0 +1,151 @@
+// typedKernel.h
+// Authored by Alex Shows
+// Released under the MIT License (http://opensource.org/licenses/mit-license.php)
+//
+// Header declaring and implementing the CCoordTraits traits and the typed 2D
+// nearest-centroid kernel
+//
+// CCoordTraits<T> names the types that go with a coordinate type T: the Calc type the
+// distances are computed in and the Accum type the per-cluster sums are kept in, wide
+// enough that summing every point can't overflow or lose the low bits. 16 bit
+// integers compute in float (which holds them exactly) and sum in 64 bit integers,
+// 32 bit integers compute in double, as float loses their low bits past 2^24, and sum
+// in 64 bit integers, float computes in float and sums in double, double does both in
+// double. Lane is an integer as wide as
+// Calc, so a label and a distance share a lane of the vectorized loop
+//
+// typed_assign<T>() labels points held in T columns and accumulates them into
+// per-cluster sums, like CAssignKernel does for int points. The points are taken
+// TK_BLOCK at a time, converted to Calc side by side, and every cluster is tested
+// against the whole block, so the loop over the points of the block vectorizes with one
+// point per lane, at the width of Calc. Narrow T means fewer bytes read per point:
+// int16 reads half what int32 and float do
+
+#pragma once
+
+#include <stdint.h>
+#include <float.h>
+
+#define TK_BLOCK 64 // Points labeled side by side
+
+template <typename T> struct CCoordTraits;
+
+template <> struct CCoordTraits<int16_t>
+{
+	typedef float Calc; // Type the distances are computed in
+	typedef long long Accum; // Type of the per-cluster sums
+	typedef int32_t Lane; // Integer as wide as Calc, for the labels inside the vectorized loop
+	static const char* name(){ return "int16";};
+	static Calc far_away(){ return FLT_MAX;};
+	static int16_t from_int(const int val){ return (int16_t)(val < INT16_MIN ? INT16_MIN : (val > INT16_MAX ? INT16_MAX : val));};
+};
+
+template <> struct CCoordTraits<int32_t>
+{
+	typedef double Calc;
+	typedef long long Accum;
+	typedef int64_t Lane;
+	static const char* name(){ return "int32";};
+	static Calc far_away(){ return DBL_MAX;};
+	static int32_t from_int(const int val){ return val;};
+};
+
+template <> struct CCoordTraits<float>
+{
+	typedef float Calc;
+	typedef double Accum;
+	typedef int32_t Lane;
+	static const char* name(){ return "float32";};
+	static Calc far_away(){ return FLT_MAX;};
+	static float from_int(const int val){ return (float)val;};
+};
+
+template <> struct CCoordTraits<double>
+{
+	typedef double Calc;
+	typedef double Accum;
+	typedef int64_t Lane;
+	static const char* name(){ return "float64";};
+	static Calc far_away(){ return DBL_MAX;};
+	static double from_int(const int val){ return (double)val;};
+};
+
+// Labels count points (x, y) against numClusters centroids (centroidX, centroidY), and
+// adds each point into sumX, sumY, pointCount and sumDist. The first cluster at the
+// smallest distance wins ties
+// Returns the number of labels that changed
+template <typename T>
+int typed_assign(const T *x, const T *y, const int count,
+				 const typename CCoordTraits<T>::Calc *centroidX, const typename CCoordTraits<T>::Calc *centroidY,
+				 const int numClusters, int *label, typename CCoordTraits<T>::Accum *sumX,
+				 typename CCoordTraits<T>::Accum *sumY, long long *pointCount, double *sumDist)
+{
+	typedef typename CCoordTraits<T>::Calc Calc;
+	typedef typename CCoordTraits<T>::Accum Accum;
+	typedef typename CCoordTraits<T>::Lane Lane;
+
+	Calc blockX[TK_BLOCK], blockY[TK_BLOCK], best[TK_BLOCK];
+	Lane nearest[TK_BLOCK];
+	int changed = 0;
+	double dist = 0.0;
+
+	for(int start=0; start < count; start += TK_BLOCK)
+	{
+		const int n = count - start < TK_BLOCK ? count - start : TK_BLOCK;
+
+		// A short last block is padded with copies of its first point, which are ignored
+		for(int j=0; j < n; j++)
+		{
+			blockX[j] = (Calc)x[start + j];
+			blockY[j] = (Calc)y[start + j];
+		}
+		for(int j=n; j < TK_BLOCK; j++)
+		{
+			blockX[j] = blockX[0];
+			blockY[j] = blockY[0];
+		}
+		for(int j=0; j < TK_BLOCK; j++)
+		{
+			best[j] = CCoordTraits<T>::far_away();
+			nearest[j] = 0;
+		}
+
+		for(int k=0; k < numClusters; k++)
+		{
+			const Calc cx = centroidX[k];
+			const Calc cy = centroidY[k];
+			for(int j=0; j < TK_BLOCK; j++)
+			{
+				const Calc dx = blockX[j] - cx;
+				const Calc dy = blockY[j] - cy;
+				const Calc d = dx * dx + dy * dy;
+
+				// The label is picked with a mask rather than a second select, which GCC
+				// turns back into a branch and then won't vectorize
+				const Lane closer = -(Lane)(d < best[j]);
+				nearest[j] = ((Lane)k & closer) | (nearest[j] & ~closer);
+				best[j] = d < best[j] ? d : best[j];
+			}
+		} // end FOR each cluster
+
+		for(int j=0; j < n; j++)
+		{
+			const int i = start + j;
+			const int k = (int)nearest[j];
+			if(label[i] != k)
+			{
+				label[i] = k;
+				changed++;
+			}
+
+			sumX[k] += (Accum)x[i];
+			sumY[k] += (Accum)y[i];
+			pointCount[k]++;
+			dist += best[j];
+		}
+	} // end FOR each block of points
+
+	*sumDist += dist;
+
+	return changed;
+}